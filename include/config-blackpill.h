@@ -19,6 +19,27 @@ extern "C" {
 
 #include "stm32f4xx.h"
 
+/******************************************************************************
+ * Clock tree, set up by SystemClock_Config.  25 MHz HSE / M * N / P gives    *
+ * SYSCLK; the PLL input must be 1-2 MHz and the VCO 100-432 MHz.  APB1 (the  *
+ * I2C and TIM2-5 bus) may not exceed 50 MHz.                                 *
+ ******************************************************************************/
+#define CLOCK_HSE_HZ        25000000
+#define CLOCK_PLLM          25
+#define CLOCK_PLLN          192
+#define CLOCK_PLLP          2
+#define CLOCK_PLLQ          4
+#define CLOCK_APB1_DIV      2
+#define CLOCK_APB2_DIV      1
+
+#define CLOCK_SYSCLK_HZ     (CLOCK_HSE_HZ / CLOCK_PLLM * CLOCK_PLLN / CLOCK_PLLP)
+#define CLOCK_PCLK1_HZ      (CLOCK_SYSCLK_HZ / CLOCK_APB1_DIV)
+#define CLOCK_PCLK2_HZ      (CLOCK_SYSCLK_HZ / CLOCK_APB2_DIV)
+
+/* timer kernel clocks run at twice a divided APB clock */
+#define CLOCK_TIM1_HZ       (CLOCK_APB2_DIV == 1 ? CLOCK_PCLK2_HZ : 2 * CLOCK_PCLK2_HZ)
+#define CLOCK_TIM3_HZ       (CLOCK_APB1_DIV == 1 ? CLOCK_PCLK1_HZ : 2 * CLOCK_PCLK1_HZ)
+
 /******************************************************************************
  * hardware configuration for for stm32f blackpill robot. non stm32f hardware *
  * constants are defined in the appropriate config-robot file                 *
@@ -29,11 +50,16 @@ const uint8_t ENCODER_RIGHT_CLK = 3;
 const uint8_t ENCODER_LEFT_B = 4;
 const uint8_t ENCODER_RIGHT_B = 5;
 
-// Motor Control
-const uint8_t MOTOR_LEFT_DIR = 7;
-const uint8_t MOTOR_RIGHT_DIR = 8;
-const uint8_t MOTOR_LEFT_PWM = 9;
-const uint8_t MOTOR_RIGHT_PWM = 10;
+// Motor Control, DRV8833 IN1/IN2 per motor on TIM3 (AF2)
+#define MOTOR_LEFT_IN1 GPIO_PIN_6       // PA6  TIM3_CH1
+#define MOTOR_LEFT_IN2 GPIO_PIN_7       // PA7  TIM3_CH2
+#define MOTOR_RIGHT_IN1 GPIO_PIN_0      // PB0  TIM3_CH3
+#define MOTOR_RIGHT_IN2 GPIO_PIN_1      // PB1  TIM3_CH4
+
+// Battery, through the divider in config-robot, on PA0 ADC1_IN0
+#define BATTERY_PIN GPIO_PIN_0
+#define BATTERY_ADC_CHANNEL 0
+#define ADC_VREF_MV 3300
 
 // Sensor Control
 #define IR_SIDE_RIGHT GPIO_PIN_14
@@ -55,6 +81,7 @@ const uint8_t MOTOR_RIGHT_PWM = 10;
 #define SDA_PIN GPIO_PIN_9
 #define I2C_MODULE_1                  ((uint16_t)0x0001)
 #define I2C_MODULE_2                  ((uint16_t)0x0002)
+#define I2C_SPEED_HZ 400000     // 100 kHz or 400 kHz, checked against PCLK1 in i2ctiming.h
 
 // Encoder Channels
 #define LEFT_CHA GPIO_PIN_15
@@ -63,6 +90,10 @@ const uint8_t MOTOR_RIGHT_PWM = 10;
 #define RIGHT_CHA GPIO_PIN_7
 #define RIGHT_CHB GPIO_PIN_6
 
+// Control tick: TIM1 latches both encoders (TIM2/TIM4 ITR0) and runs the
+// control stages (Scheduler) at this rate, 1-2 kHz
+#define CONTROL_TICK_HZ 1000
+
 
 // SPI Gyro and Accelerometer
 
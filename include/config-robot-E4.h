@@ -17,11 +17,59 @@
 extern "C" {
 #endif
 
-/* Code goes here */
+/******************************************************************************
+ * Drive train                                                                *
+ * -------------------------------------------------------------------------- *
+ * Measure the wheels and the track on the robot and tune them with a long    *
+ * straight run (diameter) and ten spins on the spot (track width).           *
+ ******************************************************************************/
+#define ROBOT_WHEEL_DIAMETER_MM     24.0
+#define ROBOT_TRACK_WIDTH_MM        72.0    // wheel contact patch centres
+
+// motor shaft encoder, counted x4 by the timer, and the gearbox between
+#define ROBOT_ENCODER_CPR           48
+#define ROBOT_GEAR_RATIO            30.0
+#define ROBOT_COUNTS_PER_WHEEL_REV  (ROBOT_ENCODER_CPR * ROBOT_GEAR_RATIO)
+
+// motor PWM, above hearing; slow decay (brake in the off time) gives a
+// speed more nearly proportional to duty
+#define ROBOT_MOTOR_PWM_HZ          20000
+#define ROBOT_MOTOR_SLOW_DECAY      1
+#define ROBOT_MOTOR_LEFT_REVERSED   0
+#define ROBOT_MOTOR_RIGHT_REVERSED  1   // mirrored on the chassis
 
 /******************************************************************************
+ * Supply                                                                     *
  * -------------------------------------------------------------------------- *
+ * 2S LiPo through a 20k / 10k divider (3:1, 9.9 V full scale) to the ADC.    *
+ * Measure the ratio with a meter and correct it here.                        *
  ******************************************************************************/
+#define ROBOT_BATTERY_DIVIDER       3.0
+#define ROBOT_BATTERY_LOW_MV        7000    // time to charge
+#define ROBOT_BATTERY_CRITICAL_MV   6600    // stop now, 3.3 V a cell
+
+/******************************************************************************
+ * Turns                                                                      *
+ * -------------------------------------------------------------------------- *
+ * Smooth search turns, entered from a cell edge at the search speed.  Angle  *
+ * is anticlockwise (left) positive, as the odometry heading.  Tune run_in    *
+ * and run_out until the robot leaves the turn centred in the new cell.       *
+ * trigger is the front sensor reading at the turn point with a wall ahead;   *
+ * 0 turns on distance alone.                                                 *
+ ******************************************************************************/
+#define ROBOT_TURN_SS90L            0
+#define ROBOT_TURN_SS90R            1
+#define ROBOT_TURN_COUNT            2
+
+#ifdef __cplusplus
+extern "C++" {
+constexpr TurnParameters robotTurns[ROBOT_TURN_COUNT] = {
+    // speed  run_in  run_out  angle  omega  alpha  trigger
+    {    300,     20,      20,    90,   280,  4000,       0 },     // SS90L
+    {    300,     20,      20,   -90,   280,  4000,       0 },     // SS90R
+};
+}
+#endif
 
 #ifdef __cplusplus
 }
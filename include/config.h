@@ -63,6 +63,21 @@ extern "C" {
 #define GOAL Location(7, 7)
 #endif
 
+/******************************************************************************
+ * Structure definitions used in the software.
+ * Robot specific instances and values are in the robot config file, so
+ * these come before it.
+ ******************************************************************************/
+typedef struct TurnParameters {
+  int speed;    // mm/s    - constant forward speed during turn
+  int run_in;   // mm      - distance from cell edge to turn start
+  int run_out;  // mm      - distance from turn end to cell start
+  int angle;    // deg     - total turn angle
+  int omega;    // deg/s   - maximum angular velocity
+  int alpha;    // deg/s/s - angular acceleration
+  int trigger;  //         - front sensor value at start of turn
+} TurnParameters;
+
 /******************************************************************************
  * Even with the same basic hardware, you may build robots with different     *
  * characteristics such as the motor gear ratio or the wheel size or sensor   *
@@ -101,24 +116,10 @@ extern "C" {
 #define MICROMETERS_PER_METER 1000000
 #define MICROSECONDS_PER_SECOND 1000000
 
-/** System clock frequency is set in `setup_clock` */
-#define SYSCLK_FREQUENCY_HZ 72000000
+/** System clock frequency is set in `SystemClock_Config` from the hardware config */
+#define SYSCLK_FREQUENCY_HZ CLOCK_SYSCLK_HZ
 #define SYSTICK_FREQUENCY_HZ 1000
-#define DRIVER_PWM_PERIOD 1024
-
-/******************************************************************************
- * Structure definitions used in the software.
- * Robot specific instances and values are in the robot config file.
- ******************************************************************************/
-typedef struct TurnParameters {
-  int speed;    // mm/s    - constant forward speed during turn
-  int run_in;   // mm      - distance from cell edge to turn start
-  int run_out;  // mm      - distance from turn end to cell start
-  int angle;    // deg     - total turn angle
-  int omega;    // deg/s   - maximum angular velocity
-  int alpha;    // deg/s/s - angular acceleration
-  int trigger;  //         - front sensor value at start of turn
-} TurnParameters;
+#define DRIVER_PWM_PERIOD 1024      // full scale duty for Motor::Set
 
 #ifdef __cplusplus
 }
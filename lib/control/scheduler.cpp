@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ *****************************************************************************/
+#include "scheduler.h"
+
+Scheduler::Scheduler(uint32_t rateHz){
+    _rateHz = rateHz;
+    _period = 0;
+    _deadline = 0;
+    _clock = CycleClock;
+    _stageCount = 0;
+    ClearStats();
+}
+
+// period from SystemCoreClock, which is only right after SystemClock_Config
+void Scheduler::Init(){
+    _period = SystemCoreClock / _rateHz;
+    _deadline = (uint32_t)((uint64_t)_period * SCHED_DEADLINE_PERCENT / 100);
+    ClearStats();
+}
+
+/******************************************************************************
+ * Registers a stage, before the ticks start.                                 *
+ * -------------------------------------------------------------------------- *
+ * @param phase         // SCHED_PHASE_x                                      *
+ * @param stage         // called every tick, in the tick's interrupt         *
+ * @param context       // handed to stage                                    *
+ * @param name          // for the statistics, not copied                     *
+ * @return false if the table is full or the phase is unknown                 *
+ *****************************************************************************/
+bool Scheduler::Add(uint8_t phase, Scheduler_Stage stage, void* context, const char* name){
+    if (phase >= SCHED_PHASES || !stage || _stageCount >= SCHED_MAX_STAGES){
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // after everything of the same or an earlier phase
+    uint8_t at = _stageCount;
+    while (at > 0 && _stages[at - 1].Stats.Phase > phase){
+        _stages[at] = _stages[at - 1];
+        at--;
+    }
+    _stages[at].Function = stage;
+    _stages[at].Context = context;
+    _stages[at].Stats.Name = name;
+    _stages[at].Stats.Phase = phase;
+    _stages[at].Stats.Cycles = 0;
+    _stages[at].Stats.CyclesWorst = 0;
+    _stageCount++;
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
+// host builds step a simulated clock, 0 puts CYCLES_Now back
+void Scheduler::SetClock(Scheduler_Clock clock){
+    _clock = clock ? clock : CycleClock;
+}
+
+/******************************************************************************
+ * Runs every stage once.  Not reentrant: on the target it only runs in the   *
+ * TIM1 interrupt, which can not preempt itself.                              *
+ * -------------------------------------------------------------------------- *
+ * @param due           // cycle time of the tick, e.g. SYNCSAMPLE_t Time     *
+ * @param data          // passed to the stages as SCHEDULER_TICK_t Data      *
+ *****************************************************************************/
+void Scheduler::Tick(uint32_t due, const void* data){
+    SCHEDULER_TICK_t tick;
+    tick.Count = _stats.Ticks;
+    tick.Due = due;
+    tick.Start = _clock();
+    tick.Data = data;
+
+    // a gap of more than one period: the ticks between were lost
+    if (_stats.Ticks > 0 && _period > 0){
+        uint32_t periods = (due - _lastDue + _period / 2) / _period;
+        if (periods > 1){
+            _stats.Missed += periods - 1;
+        }
+    }
+    _lastDue = due;
+
+    uint32_t latency = tick.Start - due;
+    _stats.Latency = latency;
+    if (latency < _stats.LatencyBest) _stats.LatencyBest = latency;
+    if (latency > _stats.LatencyWorst) _stats.LatencyWorst = latency;
+
+    uint32_t mark = tick.Start;
+    for (uint8_t i = 0; i < _stageCount; i++){
+        STAGE_t* stage = &_stages[i];
+        stage->Function(&tick, stage->Context);
+
+        uint32_t now = _clock();
+        stage->Stats.Cycles = now - mark;
+        if (stage->Stats.Cycles > stage->Stats.CyclesWorst){
+            stage->Stats.CyclesWorst = stage->Stats.Cycles;
+        }
+        mark = now;
+    }
+
+    _stats.Cycles = mark - tick.Start;
+    if (_stats.Cycles > _stats.CyclesWorst) _stats.CyclesWorst = _stats.Cycles;
+    if (mark - due > _deadline) _stats.Overruns++;
+    _stats.Ticks++;
+}
+
+// the counters, in one piece
+SCHEDULER_STATS_t Scheduler::Stats(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    SCHEDULER_STATS_t stats = _stats;
+    __set_PRIMASK(primask);
+    return stats;
+}
+
+uint32_t Scheduler::Jitter(){
+    SCHEDULER_STATS_t stats = Stats();
+    return (stats.Ticks > 0) ? stats.LatencyWorst - stats.LatencyBest : 0;
+}
+
+uint8_t Scheduler::StageCount(){
+    return _stageCount;
+}
+
+bool Scheduler::StageStats(uint8_t index, SCHEDULER_STAGE_STATS_t* stats){
+    if (index >= _stageCount){
+        return false;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = _stages[index].Stats;
+    __set_PRIMASK(primask);
+    return true;
+}
+
+void Scheduler::ClearStats(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _stats.Ticks = 0;
+    _stats.Overruns = 0;
+    _stats.Missed = 0;
+    _stats.Latency = 0;
+    _stats.LatencyBest = 0xFFFFFFFF;
+    _stats.LatencyWorst = 0;
+    _stats.Cycles = 0;
+    _stats.CyclesWorst = 0;
+    _lastDue = 0;
+    for (uint8_t i = 0; i < _stageCount; i++){
+        _stages[i].Stats.Cycles = 0;
+        _stages[i].Stats.CyclesWorst = 0;
+    }
+    __set_PRIMASK(primask);
+}
+
+uint32_t Scheduler::CycleClock(){
+    return CYCLES_Now();
+}
+
+void Scheduler::OnSample(const SYNCSAMPLE_t* sample, void* context){
+    ((Scheduler*)context)->Tick(sample->Time, sample);
+}
@@ -0,0 +1,137 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Fixed rate control pipeline.  Every tick runs the registered stages in     *
+ * phase order (sample, state, control, output), in the order they were       *
+ * added within a phase, and times them:                                      *
+ *                                                                            *
+ *   latency    due (the hardware tick) to the first stage; jitter is its     *
+ *              spread, worst - best                                          *
+ *   cycles     per stage and for the whole tick                              *
+ *   overruns   ticks that finished later than the deadline after due         *
+ *   missed     ticks that never ran because the one before was still busy    *
+ *                                                                            *
+ * On the target Tick comes from the TIM1 interrupt (OnSample on the          *
+ * SyncSampler callback), so the control timing no longer depends on the      *
+ * display or the menu, which stay in the background loop.  A host build      *
+ * calls Tick itself with a made up due time and clock.                       *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+#include "cycles.h"
+#include "syncsampler.h"
+
+/* phases, run in this order */
+#define SCHED_PHASE_SAMPLE      0   // sensors not latched by the hardware
+#define SCHED_PHASE_STATE       1   // odometry, estimators
+#define SCHED_PHASE_CONTROL     2   // profiles and controllers
+#define SCHED_PHASE_OUTPUT      3   // motor PWM, emitters
+#define SCHED_PHASES            4
+
+#ifndef SCHED_MAX_STAGES
+#define SCHED_MAX_STAGES        8
+#endif
+
+/* a tick must be done this far (percent of the period) after it was due,
+   the rest of the period belongs to the background loop */
+#ifndef SCHED_DEADLINE_PERCENT
+#define SCHED_DEADLINE_PERCENT  50
+#endif
+
+/* what every stage is told about the tick it runs in */
+typedef struct {
+    uint32_t Count;             // ticks since Init
+    uint32_t Due;               // cycle time the tick was due (the TIM1 latch)
+    uint32_t Start;             // cycle time the first stage started
+    const void* Data;           // from Tick, the SYNCSAMPLE_t when driven by OnSample
+} SCHEDULER_TICK_t;
+
+typedef void (*Scheduler_Stage)(const SCHEDULER_TICK_t* tick, void* context);
+
+/* cycle counter, CYCLES_Now on the target */
+typedef uint32_t (*Scheduler_Clock)(void);
+
+/* cycle counts are core clock cycles */
+typedef struct {
+    const char* Name;
+    uint8_t Phase;
+    uint32_t Cycles;            // last tick
+    uint32_t CyclesWorst;
+} SCHEDULER_STAGE_STATS_t;
+
+typedef struct {
+    uint32_t Ticks;
+    uint32_t Overruns;
+    uint32_t Missed;
+    uint32_t Latency;           // last tick
+    uint32_t LatencyBest;
+    uint32_t LatencyWorst;
+    uint32_t Cycles;            // last tick, all stages
+    uint32_t CyclesWorst;
+} SCHEDULER_STATS_t;
+
+/*!
+* @brief Runs the control stages once per tick and keeps their timing
+*/
+class Scheduler {
+
+private:
+    typedef struct {
+        Scheduler_Stage Function;
+        void* Context;
+        SCHEDULER_STAGE_STATS_t Stats;
+    } STAGE_t;
+
+    uint32_t _rateHz;
+    uint32_t _period;           // cycles per tick
+    uint32_t _deadline;         // cycles after due
+    Scheduler_Clock _clock;
+
+    STAGE_t _stages[SCHED_MAX_STAGES];
+    uint8_t _stageCount;
+
+    SCHEDULER_STATS_t _stats;
+    uint32_t _lastDue;
+
+    static uint32_t CycleClock();
+
+public:
+    Scheduler(uint32_t rateHz);
+
+    void Init();                // after the clock tree is set up
+    bool Add(uint8_t phase, Scheduler_Stage stage, void* context, const char* name);
+    void SetClock(Scheduler_Clock clock);
+
+    // one tick: due is the cycle time the tick was meant to start
+    void Tick(uint32_t due, const void* data = 0);
+
+    SCHEDULER_STATS_t Stats();
+    uint32_t Jitter();          // latency worst - best, cycles
+    uint8_t StageCount();
+    bool StageStats(uint8_t index, SCHEDULER_STAGE_STATS_t* stats);
+    void ClearStats();
+
+    uint32_t GetPeriod() { return _period; }
+
+    // SyncSampler callback, context is the Scheduler
+    static void OnSample(const SYNCSAMPLE_t* sample, void* context);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCHEDULER_H
@@ -22,18 +22,53 @@
  *****************************************************************************/
 #include "display.h"
 
+/* The bus of a Display built from pins.  The panel has one address, so there
+   is one of it: the first Display built from pins makes it, any later one
+   gets the same bus.  Only linked in by that constructor */
+static I2C* OwnedBus(uint16_t sdapin, uint16_t sclpin, uint16_t module, I2C_TIMING_t timing) {
+    static I2C bus(sdapin, sclpin, module, timing);
+    return &bus;
+}
+
 /******************************************************************************
  * Constructors for class.                                                    *
  * -------------------------------------------------------------------------- *
  * @param sdapin        // pin assignment for I2C SDA                         *
  * @param sclpin        // pin assignment for I2C SCL                         *
  * @param module        // I2C module in STM32F411 (1 or 2)                   *
+ * @param timing        // I2C_TimingFor<pclk1, speed>::Value for the clocks  *
+ *****************************************************************************/
+Display::Display(uint16_t sdapin, uint16_t sclpin, uint16_t module, I2C_TIMING_t timing) :
+    _i2c(OwnedBus(sdapin, sclpin, module, timing)), _sdapin(sdapin), _sclpin(sclpin), _module(module) {
+    InitState();
+}
+
+/******************************************************************************
+ * Constructor for a display on a bus shared with other devices.              *
+ * -------------------------------------------------------------------------- *
+ * @param bus           // I2C object the other devices use as well           *
  *****************************************************************************/
-Display::Display(uint16_t sdapin, uint16_t sclpin, uint16_t module){
-    _sdapin = sdapin;
-    _sclpin = sclpin;
-    _module = module;
-    _i2c = I2C(sdapin, sclpin, module);
+Display::Display(I2C* bus) : _i2c(bus), _sdapin(0), _sclpin(0), _module(0) {
+    InitState();
+}
+
+/* State both constructors start from, the bus is not touched until Init */
+void Display::InitState(void) {
+    /* Cursor home, colours as drawn, Init not run yet */
+    SSD1306.CurrentX = 0;
+    SSD1306.CurrentY = 0;
+    SSD1306.Inverted = 0;
+    SSD1306.Initialized = 0;
+
+    /* Panel content is unknown until the first full update */
+    Invalidate();
+
+    /* No background update in flight */
+    _asyncPage = DISPLAY_PAGES;
+    _asyncRequest.Status = I2C_REQ_DONE;
+    _busyWrites = 0;
+
+    ResetStats();
 }
 
 /******************************************************************************
@@ -41,7 +76,7 @@ Display::Display(uint16_t sdapin, uint16_t sclpin, uint16_t module){
  *****************************************************************************/
 uint8_t Display::Init(void) {
     /* Init I2C */
-    _i2c.i2c_init();
+    _i2c->i2c_init();
     I2C_Init();
         
     /* A little delay */
@@ -49,36 +84,42 @@ uint8_t Display::Init(void) {
     while(p>0)
         p--;
     
-    /* Init LCD */
-    WRITECOMMAND(0xAE); //display off
-    WRITECOMMAND(0x20); //Set Memory Addressing Mode   
-    WRITECOMMAND(0x10); //00,Horizontal Addressing Mode;01,Vertical Addressing Mode;10,Page Addressing Mode (RESET);11,Invalid
-    WRITECOMMAND(0xB0); //Set Page Start Address for Page Addressing Mode,0-7
-    WRITECOMMAND(0xC8); //Set COM Output Scan Direction
-    WRITECOMMAND(0x00); //---set low column address
-    WRITECOMMAND(0x10); //---set high column address
-    WRITECOMMAND(0x40); //--set start line address
-    WRITECOMMAND(0x81); //--set contrast control register
-    WRITECOMMAND(0xFF);
-    WRITECOMMAND(0xA1); //--set segment re-map 0 to 127
-    WRITECOMMAND(0xA6); //--set normal display
-    WRITECOMMAND(0xA8); //--set multiplex ratio(1 to 64)
-    WRITECOMMAND(0x3F); //
-    WRITECOMMAND(0xA4); //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
-    WRITECOMMAND(0xD3); //-set display offset
-    WRITECOMMAND(0x00); //-not offset
-    WRITECOMMAND(0xD5); //--set display clock divide ratio/oscillator frequency
-    WRITECOMMAND(0xF0); //--set divide ratio
-    WRITECOMMAND(0xD9); //--set pre-charge period
-    WRITECOMMAND(0x22); //
-    WRITECOMMAND(0xDA); //--set com pins hardware configuration
-    WRITECOMMAND(0x12);
-    WRITECOMMAND(0xDB); //--set vcomh
-    WRITECOMMAND(0x20); //0x20,0.77xVcc
-    WRITECOMMAND(0x8D); //--set DC-DC enable
-    WRITECOMMAND(0x14); //
-    WRITECOMMAND(0xAF); //--turn on SSD1306 panel
-    WRITECOMMAND(DISPLAY_DEACTIVATE_SCROLL);
+    /* Init LCD, one command stream */
+    static const uint8_t init[] = {
+        0xAE,       //display off
+        0x20,       //Set Memory Addressing Mode   
+        0x00,       //00,Horizontal Addressing Mode;01,Vertical Addressing Mode;10,Page Addressing Mode (RESET);11,Invalid
+        0x21,       //Set Column Address window
+        0x00,       //---start column
+        0x7F,       //---end column
+        0x22,       //Set Page Address window
+        0x00,       //---start page
+        0x07,       //---end page
+        0xC8,       //Set COM Output Scan Direction
+        0x40,       //--set start line address
+        0x81,       //--set contrast control register
+        0xFF,
+        0xA1,       //--set segment re-map 0 to 127
+        0xA6,       //--set normal display
+        0xA8,       //--set multiplex ratio(1 to 64)
+        0x3F,       //
+        0xA4,       //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
+        0xD3,       //-set display offset
+        0x00,       //-not offset
+        0xD5,       //--set display clock divide ratio/oscillator frequency
+        0xF0,       //--set divide ratio
+        0xD9,       //--set pre-charge period
+        0x22,       //
+        0xDA,       //--set com pins hardware configuration
+        0x12,
+        0xDB,       //--set vcomh
+        0x20,       //0x20,0.77xVcc
+        0x8D,       //--set DC-DC enable
+        0x14,       //
+        0xAF,       //--turn on SSD1306 panel
+        DISPLAY_DEACTIVATE_SCROLL
+    };
+    WRITECOMMANDS(init, sizeof(init));
 
     /* Clear screen */
     Fill(COLOR_BLACK);
@@ -99,10 +140,8 @@ uint8_t Display::Init(void) {
 
 void Display::InvertDisplay (int i)
 {
-    if (i) 
-        WRITECOMMAND (DISPLAY_INVERTDISPLAY);
-    else 
-        WRITECOMMAND (DISPLAY_NORMALDISPLAY);
+    const uint8_t cmd[] = {(uint8_t)(i ? DISPLAY_INVERTDISPLAY : DISPLAY_NORMALDISPLAY)};
+    WRITECOMMANDS(cmd, sizeof(cmd));
 }
 
 void Display::GotoXY(uint16_t x, uint16_t y) {
@@ -118,51 +157,75 @@ void Display::DrawPixel(uint16_t x, uint16_t y, DISPLAY_COLOR_t color) {
     }
     
     /* Check if pixels are inverted */
-    if (SSD1306.Inverted) {
-        if (color == COLOR_BLACK)
-            color = COLOR_WHITE;
-        else
-            color = COLOR_BLACK;
-    }
+    color = ResolveColor(color);
     
     /* Set color */
     if (color == COLOR_WHITE) {
         DISPLAY_Buffer[x + (y / 8) * DISPLAY_WIDTH] |= 1 << (y % 8);
+    } else if (color == COLOR_INVERSE) {
+        DISPLAY_Buffer[x + (y / 8) * DISPLAY_WIDTH] ^= 1 << (y % 8);
     } else {
         DISPLAY_Buffer[x + (y / 8) * DISPLAY_WIDTH] &= ~(1 << (y % 8));
     }
+
+    /* Page needs resending */
+    MarkDirty(y / 8, x, x);
 }
 
+/******************************************************************************
+ * Copies a packed glyph (see fonts.h) straight into the page bytes.  Each    *
+ * glyph byte lands in one page, or is split over two with AND/OR masks when  *
+ * the text is not page aligned.  The glyph box is painted in full,           *
+ * background included, exactly as the old per-pixel renderer did.  With      *
+ * COLOR_INVERSE only the glyph's own pixels are toggled.                     *
+ *****************************************************************************/
 char Display::Putc(char ch, FontDef_t Font, DISPLAY_COLOR_t color) {
-    uint32_t i, b, j;
-    
-    DISPLAY_COLOR_t notcolor;
-
-    if (color == COLOR_BLACK)
-        notcolor = COLOR_WHITE;
-    else
-        notcolor = COLOR_BLACK;
+    uint8_t p, j, bits, mask, rows;
+    uint8_t pages = (Font.FontHeight + 7) / 8;
+    uint8_t shift = SSD1306.CurrentY % 8;
+    const uint8_t* glyph;
+    char* dst;
+    bool ink;
 
-    /* Check available space in LCD */
+    /* Check available space in LCD, and that the font holds the character */
     if (
-        DISPLAY_WIDTH <= (SSD1306.CurrentX + Font.FontWidth) ||
-        DISPLAY_HEIGHT <= (SSD1306.CurrentY + Font.FontHeight)
+        DISPLAY_WIDTH < (SSD1306.CurrentX + Font.FontWidth) ||
+        DISPLAY_HEIGHT < (SSD1306.CurrentY + Font.FontHeight) ||
+        ch < Font.FirstChar || ch > Font.LastChar
     ) {
         /* Error */
         return 0;
     }
-    
-    /* Go through font */
-    for (i = 0; i < Font.FontHeight; i++) {
-        b = Font.data[(ch - 32) * Font.FontHeight + i];
-        for (j = 0; j < Font.FontWidth; j++) {
-            if ((b << j) & 0x8000) {
-                DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), color);
-            } else {
-                DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), notcolor);
+
+    /* Set glyph bits light up unless exactly one of color / inverted says otherwise */
+    ink = (color == COLOR_WHITE) == !SSD1306.Inverted;
+    glyph = &Font.data[(ch - Font.FirstChar) * Font.FontWidth * pages];
+
+    /* Go through font, a page of rows at a time */
+    for (p = 0; p < pages; p++) {
+        rows = Font.FontHeight - p * 8;
+        mask = (rows >= 8) ? 0xFF : (1 << rows) - 1;
+        dst = &DISPLAY_Buffer[SSD1306.CurrentX + (SSD1306.CurrentY / 8 + p) * DISPLAY_WIDTH];
+
+        for (j = 0; j < Font.FontWidth; j++, dst++) {
+            if (color == COLOR_INVERSE) {
+                /* toggle the glyph's own pixels */
+                uint16_t b = *glyph++ << shift;
+                dst[0] ^= b;
+                if (b > 0xFF) {
+                    dst[DISPLAY_WIDTH] ^= b >> 8;
+                }
+                continue;
             }
+            bits = ink ? *glyph++ : ~*glyph++ & mask;
+            WriteShifted(dst, bits, mask, shift);
         }
     }
+
+    /* Pages touched */
+    for (p = SSD1306.CurrentY / 8; p <= (SSD1306.CurrentY + Font.FontHeight - 1) / 8; p++) {
+        MarkDirty(p, SSD1306.CurrentX, SSD1306.CurrentX + Font.FontWidth - 1);
+    }
     
     /* Increase pointer */
     SSD1306.CurrentX += Font.FontWidth;
@@ -187,15 +250,232 @@ char Display::Print(const char str[], FontDef_t Font, DISPLAY_COLOR_t color) {
     return *str;
 }
 
+/******************************************************************************
+ * Numbers are formatted on the stack (see format.h) and drawn glyph by       *
+ * glyph, padded out to 'width' characters.  isRight pads on the left so the  *
+ * value is right aligned.  Like Print, zero means everything was drawn.      *
+ *****************************************************************************/
+char Display::PrintUint(uint32_t value, uint8_t width, char pad, bool isRight, FontDef_t Font, DISPLAY_COLOR_t color) {
+    char str[FORMAT_MAX_CHARS];
+    return PrintField(str, FORMAT_Uint32(str, value), width, pad, isRight, Font, color);
+}
+
+char Display::PrintInt(int32_t value, uint8_t width, char pad, bool isRight, FontDef_t Font, DISPLAY_COLOR_t color) {
+    char str[FORMAT_MAX_CHARS];
+    return PrintField(str, FORMAT_Int32(str, value), width, pad, isRight, Font, color);
+}
+
+char Display::PrintFixed(int32_t value, uint8_t fracBits, uint8_t places, uint8_t width, char pad, bool isRight, FontDef_t Font, DISPLAY_COLOR_t color) {
+    char str[FORMAT_MAX_CHARS];
+    return PrintField(str, FORMAT_Fixed(str, value, fracBits, places), width, pad, isRight, Font, color);
+}
+
+char Display::PrintFloat(float value, uint8_t places, uint8_t width, char pad, bool isRight, FontDef_t Font, DISPLAY_COLOR_t color) {
+    char str[FORMAT_MAX_CHARS];
+    return PrintField(str, FORMAT_Float(str, value, places), width, pad, isRight, Font, color);
+}
+
+char Display::PrintField(const char* str, uint8_t len, uint8_t width, char pad, bool isRight, FontDef_t Font, DISPLAY_COLOR_t color) {
+    uint8_t fill = (width > len) ? width - len : 0;
+    uint8_t i;
+
+    if (isRight) {
+        /* Zero padding goes after the sign, as printf("%08d") */
+        if (pad == '0' && len > 0 && str[0] == '-') {
+            if (Putc('-', Font, color) != '-') {
+                return '-';
+            }
+            str++;
+            len--;
+        }
+        for (i = 0; i < fill; i++) {
+            if (Putc(pad, Font, color) != pad) {
+                return pad;
+            }
+        }
+    }
+
+    for (i = 0; i < len; i++) {
+        if (Putc(str[i], Font, color) != str[i]) {
+            return str[i];
+        }
+    }
+
+    if (!isRight) {
+        for (i = 0; i < fill; i++) {
+            if (Putc(pad, Font, color) != pad) {
+                return pad;
+            }
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * Sends only what changed.  Dirty pages are grouped into column/page windows *
+ * (see PlanRects) and each window goes out as one horizontal addressing      *
+ * burst.  A clean screen costs nothing, a full frame is one 1024 byte burst. *
+ *****************************************************************************/
 void Display::UpdateScreen(void) {
-    uint8_t m;
-    
-    for (m = 0; m < 8; m++) {
-        WRITECOMMAND(0xB0 + m);
-        WRITECOMMAND(0x00);
-        WRITECOMMAND(0x10);
-        /* Write multi data */
-        I2C_WriteMultiBytes(DISPLAY_I2C_ADDR, 0x40, &DISPLAY_Buffer[DISPLAY_WIDTH * m], DISPLAY_WIDTH);
+    DISPLAY_RECT_t rects[DISPLAY_PAGES];
+    uint32_t start = CYCLES_Now();
+    uint8_t count, sent;
+
+    /* Let a background update finish first */
+    while (IsUpdateBusy()) {}
+
+    count = PlanRects(rects);
+    for (sent = 0; sent < count; sent++) {
+        if (!FlushWindow(&rects[sent])) {
+            /* bus failed: this window and the rest go out with the next update */
+            for (uint8_t i = sent; i < count; i++) {
+                for (uint8_t m = rects[i].Page0; m <= rects[i].Page1; m++) {
+                    MarkDirty(m, rects[i].X0, rects[i].X1);
+                }
+            }
+            break;
+        }
+    }
+
+    /* a clean screen is not an update, its time stays out of the average */
+    if (count) {
+        _stats.FlushCycles += CYCLES_Now() - start;
+    }
+    CountFrame(count, sent, start);
+}
+
+/******************************************************************************
+ * Sends a rectangle of the buffer whether or not it is dirty.  Pages whose   *
+ * dirty window lies inside the rectangle are clean afterwards.               *
+ * -------------------------------------------------------------------------- *
+ * @param x, y      // top left corner in pixels                              *
+ * @param w, h      // size in pixels, rows are rounded out to whole pages    *
+ *****************************************************************************/
+void Display::FlushRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    DISPLAY_RECT_t rect;
+
+    if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT || w == 0 || h == 0) {
+        return;
+    }
+    if ((x + w) > DISPLAY_WIDTH) {
+        w = DISPLAY_WIDTH - x;
+    }
+    if ((y + h) > DISPLAY_HEIGHT) {
+        h = DISPLAY_HEIGHT - y;
+    }
+
+    rect.X0 = x;
+    rect.X1 = x + w - 1;
+    rect.Page0 = y / 8;
+    rect.Page1 = (y + h - 1) / 8;
+
+    uint32_t start = CYCLES_Now();
+    while (IsUpdateBusy()) {}
+    if (!FlushWindow(&rect)) {
+        _stats.FlushCycles += CYCLES_Now() - start;
+        return;
+    }
+    _stats.FlushCycles += CYCLES_Now() - start;
+    CountFrame(1, 1, start);
+
+    for (uint8_t m = rect.Page0; m <= rect.Page1; m++) {
+        if (DISPLAY_Dirty[m].Min >= rect.X0 && DISPLAY_Dirty[m].Max <= rect.X1) {
+            MarkClean(m);
+        }
+    }
+}
+
+/******************************************************************************
+ * Background version of UpdateScreen.  The dirty windows are captured and    *
+ * handed to the I2C TX DMA one transaction at a time, so the call returns    *
+ * straight away.  Drawing may carry on while the update runs: anything drawn *
+ * lands in the next update, and draws over a window still being sent are     *
+ * counted (GetBusyWriteCount) as they may show briefly torn on the panel.    *
+ * Each window is two queued transactions, its window commands then all of   *
+ * its rows, so other devices on the bus can get in between windows.          *
+ * -------------------------------------------------------------------------- *
+ * @param done      // optional callback, runs in interrupt context           *
+ * @param context   // passed to the callback                                 *
+ * @return false if an update is already in flight                            *
+ *****************************************************************************/
+bool Display::UpdateScreenAsync(I2C_Callback done, void* context) {
+    uint32_t start = CYCLES_Now();
+
+    if (IsUpdateBusy()) {
+        return false;
+    }
+
+    /* Take the dirty windows, new draws start a fresh set */
+    _asyncCount = PlanRects(_asyncRect);
+    for (uint8_t m = 0; m < DISPLAY_PAGES; m++) {
+        _asyncWindow[m].Min = 0xFF;
+        _asyncWindow[m].Max = 0x00;
+    }
+    for (uint8_t i = 0; i < _asyncCount; i++) {
+        for (uint8_t m = _asyncRect[i].Page0; m <= _asyncRect[i].Page1; m++) {
+            _asyncWindow[m].Min = _asyncRect[i].X0;
+            _asyncWindow[m].Max = _asyncRect[i].X1;
+        }
+    }
+
+    _asyncDone = done;
+    _asyncContext = context;
+    _asyncIndex = 0;
+    _asyncPhase = 0;
+    _asyncStart = start;
+    _asyncBytes = 0;
+    _asyncPage = 0;
+    _asyncRequest.Status = I2C_REQ_DONE;
+    AsyncNext();
+
+    /* AsyncStep adds to the same counter from the interrupt */
+    if (_asyncCount) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        _stats.FlushCycles += CYCLES_Now() - start;
+        __set_PRIMASK(primask);
+    }
+    return true;
+}
+
+bool Display::IsUpdateBusy(void) {
+    if (_asyncPage < DISPLAY_PAGES) {
+        /* times out a stuck transfer, which ends the update */
+        _i2c->i2c_Service();
+    }
+    return _asyncPage < DISPLAY_PAGES;
+}
+
+uint32_t Display::GetBusyWriteCount(void) {
+    return _busyWrites;
+}
+
+/* A consistent snapshot: a background update counts from the I2C interrupt */
+DISPLAY_STATS_t Display::GetStats(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    DISPLAY_STATS_t stats = _stats;
+    __set_PRIMASK(primask);
+    return stats;
+}
+
+I2C_STATS_t Display::GetBusStats(void) {
+    return _i2c->i2c_GetStats();
+}
+
+void Display::ResetStats(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&_stats, 0, sizeof(_stats));
+    __set_PRIMASK(primask);
+    _i2c->i2c_ResetStats();
+}
+
+/* Forces the next UpdateScreen to resend the whole frame */
+void Display::Invalidate(void) {
+    for (uint8_t m = 0; m < DISPLAY_PAGES; m++) {
+        DISPLAY_Dirty[m].Min = 0;
+        DISPLAY_Dirty[m].Max = DISPLAY_WIDTH - 1;
     }
 }
 
@@ -209,11 +489,13 @@ void Display::ToggleInvert(void) {
     for (i = 0; i < sizeof(DISPLAY_Buffer); i++) {
         DISPLAY_Buffer[i] = ~DISPLAY_Buffer[i];
     }
+    Invalidate();
 }
 
 void Display::Fill(DISPLAY_COLOR_t color) {
     /* Set memory */
     memset(DISPLAY_Buffer, (color == COLOR_BLACK) ? 0x00 : 0xFF, sizeof(DISPLAY_Buffer));
+    Invalidate();
 }
 
 void Display::Clear (void)
@@ -223,15 +505,13 @@ void Display::Clear (void)
 }
 
 void Display::On(void) {
-    WRITECOMMAND(0x8D);  
-    WRITECOMMAND(0x14);  
-    WRITECOMMAND(0xAF);  
+    static const uint8_t cmd[] = {0x8D, 0x14, 0xAF};  /* charge pump on, panel on */
+    WRITECOMMANDS(cmd, sizeof(cmd));
 }
 
 void Display::Off(void) {
-    WRITECOMMAND(0x8D);  
-    WRITECOMMAND(0x10);
-    WRITECOMMAND(0xAE);  
+    static const uint8_t cmd[] = {0x8D, 0x10, 0xAE};  /* charge pump off, panel off */
+    WRITECOMMANDS(cmd, sizeof(cmd));
 }
 
 void Display::I2C_Init() {
@@ -245,15 +525,15 @@ void Display::I2C_WriteMultiBytes(uint8_t address, uint8_t reg, char* data, uint
     //iint8_t i;
     //for(i = 0; i < count; i++)
     //dt[i] = data[i];
-    _i2c.i2c_WriteMulti(address,reg,data,count);
+    _i2c->i2c_WriteMulti(address,reg,data,count);
 }
 
 void Display::I2C_Write(uint8_t address, uint8_t reg, uint8_t data) {
-    _i2c.i2c_writeByte(address,reg,data);
+    _i2c->i2c_writeByte(address,reg,data);
 }
 
 void Display::DrawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, DISPLAY_COLOR_t c) {
-    int16_t dx, dy, sx, sy, err, e2, i, tmp; 
+    int16_t dx, dy, sx, sy, err, e2, tmp; 
     
     /* Check for overflow */
     if (x0 >= DISPLAY_WIDTH) {
@@ -289,9 +569,7 @@ void Display::DrawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, DISPL
         }
         
         /* Vertical line */
-        for (i = y0; i <= y1; i++) {
-            DrawPixel(x0, i, c);
-        }
+        DrawVLine(x0, y0, y1 - y0 + 1, c);
         
         /* Return from function */
         return;
@@ -311,9 +589,7 @@ void Display::DrawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, DISPL
         }
         
         /* Horizontal line */
-        for (i = x0; i <= x1; i++) {
-            DrawPixel(i, y0, c);
-        }
+        DrawHLine(x0, y0, x1 - x0 + 1, c);
         
         /* Return from function */
         return;
@@ -351,11 +627,102 @@ void Display::DrawRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, DISP
         h = DISPLAY_HEIGHT - y;
     }
     
+    /* Far edges stay on screen, as the line clipping always did */
+    uint16_t x1 = (x + w < DISPLAY_WIDTH) ? x + w : DISPLAY_WIDTH - 1;
+    uint16_t y1 = (y + h < DISPLAY_HEIGHT) ? y + h : DISPLAY_HEIGHT - 1;
+
     /* Draw 4 lines */
-    DrawLine(x, y, x + w, y, c);         /* Top line */
-    DrawLine(x, y + h, x + w, y + h, c); /* Bottom line */
-    DrawLine(x, y, x, y + h, c);         /* Left line */
-    DrawLine(x + w, y, x + w, y + h, c); /* Right line */
+    DrawHLine(x, y, x1 - x + 1, c);      /* Top line */
+    DrawHLine(x, y1, x1 - x + 1, c);     /* Bottom line */
+    DrawVLine(x, y, y1 - y + 1, c);      /* Left line */
+    DrawVLine(x1, y, y1 - y + 1, c);     /* Right line */
+}
+
+void Display::DrawHLine(uint16_t x, uint16_t y, uint16_t w, DISPLAY_COLOR_t c) {
+    FillRectangle(x, y, w, 1, c);
+}
+
+void Display::DrawVLine(uint16_t x, uint16_t y, uint16_t h, DISPLAY_COLOR_t c) {
+    FillRectangle(x, y, 1, h, c);
+}
+
+/******************************************************************************
+ * Fills a rectangle a page at a time.  Each page is one byte mask (the rows  *
+ * of the rectangle in that page) applied across the columns, so a full page  *
+ * costs one store per column whatever the height.                            *
+ *****************************************************************************/
+void Display::FillRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, DISPLAY_COLOR_t c) {
+    /* Check input parameters */
+    if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT || w == 0 || h == 0) {
+        return;
+    }
+
+    /* Clip to the screen */
+    if ((x + w) > DISPLAY_WIDTH) {
+        w = DISPLAY_WIDTH - x;
+    }
+    if ((y + h) > DISPLAY_HEIGHT) {
+        h = DISPLAY_HEIGHT - y;
+    }
+
+    c = ResolveColor(c);
+
+    uint16_t y1 = y + h - 1;
+    for (uint8_t page = y / 8; page <= y1 / 8; page++) {
+        uint8_t mask = 0xFF;
+        if (page == y / 8) {
+            mask &= 0xFF << (y % 8);            /* rows above y */
+        }
+        if (page == y1 / 8) {
+            mask &= 0xFF >> (7 - (y1 % 8));     /* rows below y1 */
+        }
+        FillSpan(page, x, x + w - 1, mask, c);
+    }
+}
+
+/******************************************************************************
+ * Draws a bitmap in the panel's own page-major layout (as the packed fonts): *
+ * for each 8 row band, w column bytes, bit n = row n of the band.  Set bits  *
+ * are painted in c, clear bits leave the screen alone.                       *
+ *****************************************************************************/
+void Display::DrawBitmap(uint16_t x, uint16_t y, const uint8_t* bitmap, uint16_t w, uint16_t h, DISPLAY_COLOR_t c) {
+    for (uint16_t band = 0; band < h; band += 8) {
+        uint8_t rows = (h - band < 8) ? h - band : 8;
+        PaintColumns(x, y + band, bitmap, w, rows, c);
+        bitmap += w;
+    }
+}
+
+/******************************************************************************
+ * Draws an XBM image: row-major, LSB is the leftmost pixel, each row padded  *
+ * to a whole byte.  Set bits are painted in c, clear bits are transparent.   *
+ * Rows are transposed eight at a time into column bytes and painted as a     *
+ * page-major bitmap.                                                         *
+ *****************************************************************************/
+void Display::DrawXBM(uint16_t x, uint16_t y, const uint8_t* xbm, uint16_t w, uint16_t h, DISPLAY_COLOR_t c) {
+    uint16_t stride = (w + 7) / 8;
+    uint8_t columns[DISPLAY_WIDTH];
+
+    /* Nothing past the right edge can show */
+    if (x >= DISPLAY_WIDTH) {
+        return;
+    }
+    uint16_t visible = (x + w > DISPLAY_WIDTH) ? DISPLAY_WIDTH - x : w;
+
+    for (uint16_t band = 0; band < h; band += 8) {
+        uint8_t rows = (h - band < 8) ? h - band : 8;
+
+        memset(columns, 0, visible);
+        for (uint8_t r = 0; r < rows; r++) {
+            const uint8_t* src = &xbm[(band + r) * stride];
+            for (uint16_t j = 0; j < visible; j++) {
+                if (src[j / 8] & (1 << (j % 8))) {
+                    columns[j] |= 1 << r;
+                }
+            }
+        }
+        PaintColumns(x, y + band, columns, visible, rows, c);
+    }
 }
 
 /******************************************************************************
@@ -369,12 +736,302 @@ char* Display::FONTS_GetStringSize(char* str, FONTS_SIZE_t* SizeStruct, FontDef_
     return str;
 }
 
+/******************************************************************************
+ * Writes a byte of 8 pixel rows, moved down by shift rows, into dst and the  *
+ * byte below it.  Only rows set in mask change.  No bounds or dirty          *
+ * handling, the caller has done both.                                        *
+ *****************************************************************************/
+void Display::WriteShifted(char* dst, uint8_t bits, uint8_t mask, uint8_t shift) {
+    uint16_t b = bits << shift;
+    uint16_t m = mask << shift;
+
+    dst[0] = (dst[0] & ~m) | b;
+    if (m > 0xFF) {
+        /* spills into the next page */
+        dst[DISPLAY_WIDTH] = (dst[DISPLAY_WIDTH] & ~(m >> 8)) | (b >> 8);
+    }
+}
+
+/* Applies the Inverted state, which swaps black and white but not XOR */
+DISPLAY_COLOR_t Display::ResolveColor(DISPLAY_COLOR_t c) {
+    if (SSD1306.Inverted && c != COLOR_INVERSE) {
+        return (c == COLOR_BLACK) ? COLOR_WHITE : COLOR_BLACK;
+    }
+    return c;
+}
+
+/* Sets, clears or toggles the given bits of one page byte (colour already resolved) */
+void Display::PaintByte(uint8_t page, uint8_t x, uint8_t bits, DISPLAY_COLOR_t c) {
+    char* dst = &DISPLAY_Buffer[x + page * DISPLAY_WIDTH];
+
+    switch (c) {
+        case COLOR_WHITE: *dst |= bits; break;
+        case COLOR_INVERSE: *dst ^= bits; break;
+        default: *dst &= ~bits; break;
+    }
+}
+
+/* Applies one row mask to columns x0..x1 of a page (colour already resolved) */
+void Display::FillSpan(uint8_t page, uint8_t x0, uint8_t x1, uint8_t mask, DISPLAY_COLOR_t c) {
+    char* dst = &DISPLAY_Buffer[x0 + page * DISPLAY_WIDTH];
+    char* end = dst + (x1 - x0) + 1;
+
+    switch (c) {
+        case COLOR_WHITE: while (dst < end) { *dst++ |= mask; } break;
+        case COLOR_INVERSE: while (dst < end) { *dst++ ^= mask; } break;
+        default: while (dst < end) { *dst++ &= ~mask; } break;
+    }
+
+    MarkDirty(page, x0, x1);
+}
+
+/******************************************************************************
+ * Paints one band of up to 8 rows of column bytes at (x, y), splitting each  *
+ * byte over two pages when y is not page aligned.  Clips to the screen.      *
+ *****************************************************************************/
+void Display::PaintColumns(uint16_t x, uint16_t y, const uint8_t* columns, uint16_t w, uint8_t rows, DISPLAY_COLOR_t c) {
+    if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT || w == 0) {
+        return;
+    }
+    if ((x + w) > DISPLAY_WIDTH) {
+        w = DISPLAY_WIDTH - x;
+    }
+
+    uint8_t page = y / 8;
+    uint8_t shift = y % 8;
+    uint8_t mask = 0xFF >> (8 - rows);
+    bool spill = shift && (page + 1) < DISPLAY_PAGES && (mask << shift) > 0xFF;
+
+    /* rows past the bottom edge are dropped by the page check */
+    c = ResolveColor(c);
+    for (uint16_t j = 0; j < w; j++) {
+        uint16_t bits = (columns[j] & mask) << shift;
+        PaintByte(page, x + j, bits, c);
+        if (spill) {
+            PaintByte(page + 1, x + j, bits >> 8, c);
+        }
+    }
+
+    MarkDirty(page, x, x + w - 1);
+    if (spill) {
+        MarkDirty(page + 1, x, x + w - 1);
+    }
+}
+
+void Display::MarkDirty(uint8_t page, uint8_t x0, uint8_t x1) {
+    /* Detect drawing over a window the DMA has not finished with */
+    if (page >= _asyncPage && _asyncPage < DISPLAY_PAGES &&
+        x0 <= _asyncWindow[page].Max && x1 >= _asyncWindow[page].Min) {
+        _busyWrites++;
+    }
+
+    if (x0 < DISPLAY_Dirty[page].Min) {
+        DISPLAY_Dirty[page].Min = x0;
+    }
+    if (x1 > DISPLAY_Dirty[page].Max) {
+        DISPLAY_Dirty[page].Max = x1;
+    }
+}
+
+void Display::MarkClean(uint8_t page) {
+    DISPLAY_Dirty[page].Min = 0xFF;
+    DISPLAY_Dirty[page].Max = 0x00;
+}
+
+void Display::AsyncStep(void* context) {
+    Display* display = (Display*)context;
+    uint32_t start = CYCLES_Now();
+
+    display->AsyncNext();
+    display->_stats.FlushCycles += CYCLES_Now() - start;
+}
+
+/* Fills the background request, rows of width bytes a page apart.  Pixel data
+   may be cut into chunks for a sensor read: the GDDRAM pointer carries on */
+void Display::AsyncRequest(uint8_t control, char* data, uint8_t width, uint8_t rows) {
+    _asyncRequest.Saddr = DISPLAY_I2C_ADDR;
+    _asyncRequest.Reg = control;
+    _asyncRequest.RegLen = 1;
+    _asyncRequest.Dir = I2C_DIR_WRITE;
+    _asyncRequest.Buffer = data;
+    _asyncRequest.Length = width;
+    _asyncRequest.Rows = rows;
+    _asyncRequest.Stride = DISPLAY_WIDTH;
+    _asyncRequest.Priority = I2C_PRIO_LOW;
+    _asyncRequest.Splittable = (control == 0x40);
+    _asyncRequest.Callback = AsyncStep;
+    _asyncRequest.Context = this;
+}
+
+/* Starts the next transaction of a background update, called again on completion */
+void Display::AsyncNext(void) {
+    /* bytes count once their transaction has gone out in full */
+    if (_asyncRequest.Status == I2C_REQ_DONE) {
+        _stats.Bytes += _asyncBytes;
+    }
+    _asyncBytes = 0;
+
+    while (_asyncIndex < _asyncCount) {
+        DISPLAY_RECT_t* rect = &_asyncRect[_asyncIndex];
+        uint8_t width = rect->X1 - rect->X0 + 1;
+
+        if (_asyncRequest.Status != I2C_REQ_DONE) {
+            /* last transaction failed or timed out, nothing past it is sent */
+            break;
+        }
+
+        if (_asyncPhase == 2) {
+            /* rows just sent */
+            _asyncPage += _asyncRows;
+            _asyncPhase = 1;
+        }
+
+        if (_asyncPhase == 0) {
+            /* open the window */
+            _asyncPage = rect->Page0;
+            _asyncPhase = 1;
+            WindowCommands(_asyncCmd, rect);
+            AsyncRequest(0x00, (char*)_asyncCmd, sizeof(_asyncCmd), 1);
+            if (_i2c->i2c_Submit(&_asyncRequest)) {
+                _asyncBytes = sizeof(_asyncCmd);
+                return;
+            }
+            break;
+        }
+
+        if (_asyncPage <= rect->Page1) {
+            /* the rest of the window as one transaction, the bus steps through the rows */
+            _asyncRows = rect->Page1 - _asyncPage + 1;
+            _asyncPhase = 2;
+            AsyncRequest(0x40, &DISPLAY_Buffer[DISPLAY_WIDTH * _asyncPage + rect->X0], width, _asyncRows);
+            if (_i2c->i2c_Submit(&_asyncRequest)) {
+                _asyncBytes = width * _asyncRows;
+                return;
+            }
+            break;
+        }
+
+        /* window done, move on */
+        _asyncPhase = 0;
+        _asyncIndex++;
+    }
+
+    /* Bus refused or failed a transfer: hand the unsent windows back to the next update */
+    bool unsent = _asyncIndex < _asyncCount;
+    for (; _asyncPage < DISPLAY_PAGES; _asyncPage++) {
+        DISPLAY_DIRTY_t* window = &_asyncWindow[_asyncPage];
+        if (unsent && window->Min < DISPLAY_Dirty[_asyncPage].Min) {
+            DISPLAY_Dirty[_asyncPage].Min = window->Min;
+        }
+        if (unsent && window->Max > DISPLAY_Dirty[_asyncPage].Max) {
+            DISPLAY_Dirty[_asyncPage].Max = window->Max;
+        }
+    }
+
+    CountFrame(_asyncCount, _asyncIndex, _asyncStart);
+
+    if (_asyncDone) {
+        _asyncDone(_asyncContext);
+    }
+}
+
+/******************************************************************************
+ * Turns the dirty pages into windows and marks them clean.  Neighbouring     *
+ * dirty pages share a window when the extra columns cost fewer bytes than    *
+ * opening another window (DISPLAY_RECT_OVERHEAD).                            *
+ * -------------------------------------------------------------------------- *
+ * @return number of windows written to rects (at most DISPLAY_PAGES)         *
+ *****************************************************************************/
+uint8_t Display::PlanRects(DISPLAY_RECT_t* rects) {
+    uint8_t count = 0;
+    DISPLAY_RECT_t* run = 0;
+
+    for (uint8_t m = 0; m < DISPLAY_PAGES; m++) {
+        DISPLAY_DIRTY_t* dirty = &DISPLAY_Dirty[m];
+
+        if (dirty->Min > dirty->Max) {
+            /* clean page ends the run */
+            run = 0;
+            continue;
+        }
+
+        if (run) {
+            uint8_t x0 = (dirty->Min < run->X0) ? dirty->Min : run->X0;
+            uint8_t x1 = (dirty->Max > run->X1) ? dirty->Max : run->X1;
+            uint16_t pages = run->Page1 - run->Page0 + 1;
+            uint16_t merged = (x1 - x0 + 1) * (pages + 1);
+            uint16_t separate = (run->X1 - run->X0 + 1) * pages + (dirty->Max - dirty->Min + 1) + DISPLAY_RECT_OVERHEAD;
+
+            if (merged <= separate) {
+                run->X0 = x0;
+                run->X1 = x1;
+                run->Page1 = m;
+                MarkClean(m);
+                continue;
+            }
+        }
+
+        run = &rects[count++];
+        run->X0 = dirty->Min;
+        run->X1 = dirty->Max;
+        run->Page0 = m;
+        run->Page1 = m;
+        MarkClean(m);
+    }
+
+    return count;
+}
+
+/* Sends one window: its commands, then all its rows in one splittable transaction, false if the bus failed */
+bool Display::FlushWindow(const DISPLAY_RECT_t* rect) {
+    uint8_t cmd[6];
+
+    WindowCommands(cmd, rect);
+    if (WRITECOMMANDS(cmd, sizeof(cmd)) != I2C_REQ_DONE) {
+        return false;
+    }
+    if (_i2c->i2c_WriteMultiStrided(DISPLAY_I2C_ADDR, 0x40, &DISPLAY_Buffer[DISPLAY_WIDTH * rect->Page0 + rect->X0],
+                                    rect->X1 - rect->X0 + 1, rect->Page1 - rect->Page0 + 1, DISPLAY_WIDTH, true) != I2C_REQ_DONE) {
+        return false;
+    }
+    _stats.Bytes += sizeof(cmd) + (rect->X1 - rect->X0 + 1) * (rect->Page1 - rect->Page0 + 1);
+    return true;
+}
+
+/* Counts an update that began at 'start' and got 'sent' of its 'windows' windows
+   out; only an update sent in full counts as a frame and has a latency */
+void Display::CountFrame(uint8_t windows, uint8_t sent, uint32_t start) {
+    _stats.Windows += sent;
+    if (windows == 0 || sent < windows) {
+        return;
+    }
+    _stats.Frames++;
+    _stats.LastLatency = CYCLES_Now() - start;
+    if (_stats.LastLatency > _stats.WorstLatency) {
+        _stats.WorstLatency = _stats.LastLatency;
+    }
+}
+
+void Display::WindowCommands(uint8_t* cmd, const DISPLAY_RECT_t* rect) {
+    cmd[0] = 0x21;              /* column window */
+    cmd[1] = rect->X0;
+    cmd[2] = rect->X1;
+    cmd[3] = 0x22;              /* page window */
+    cmd[4] = rect->Page0;
+    cmd[5] = rect->Page1;
+}
+
 void Display::WRITECOMMAND(int command) {
-    _i2c.i2c_writeByte(DISPLAY_I2C_ADDR, 0x00, (command));
+    _i2c->i2c_writeByte(DISPLAY_I2C_ADDR, 0x00, (command));
+}
+
+/* Sends a run of commands in one transaction (control byte 0x00, Co = 0) */
+char Display::WRITECOMMANDS(const uint8_t* commands, uint8_t count) {
+    return _i2c->i2c_WriteMulti(DISPLAY_I2C_ADDR, 0x00, (const char*)commands, count);
 }
 
 void Display::WRITEDATA(int data) {
-    _i2c.i2c_writeByte(DISPLAY_I2C_ADDR, 0x40, (data));
+    _i2c->i2c_writeByte(DISPLAY_I2C_ADDR, 0x40, (data));
 }
 
 
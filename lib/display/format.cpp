@@ -0,0 +1,147 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include "format.h"
+#include <math.h>
+
+static const uint32_t FORMAT_Pow10[FORMAT_MAX_PLACES + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* Writes exactly 'digits' digits of value, zero filled on the left */
+static uint8_t FORMAT_Digits(char* out, uint32_t value, uint8_t digits) {
+    for (uint8_t i = digits; i > 0; i--) {
+        out[i - 1] = '0' + (value % 10);
+        value /= 10;
+    }
+    return digits;
+}
+
+/* num / 2^bits rounded to nearest, ties to even as printf does */
+static uint64_t FORMAT_Round(uint64_t num, uint8_t bits) {
+    if (bits == 0) {
+        return num;
+    }
+    uint64_t half = 1ull << (bits - 1);
+    uint64_t result = (num + half) >> bits;
+    if ((num & ((half << 1) - 1)) == half && (result & 1)) {
+        result--;
+    }
+    return result;
+}
+
+/******************************************************************************
+ * Writes whole + frac / 2^fracBits rounded to 'places' decimals.  The        *
+ * parity for a tie is that of the last printed digit, which is the integer   *
+ * part itself when there are no decimals.                                    *
+ *****************************************************************************/
+static uint8_t FORMAT_Decimal(char* out, bool negative, uint32_t whole, uint32_t frac, uint8_t fracBits, uint8_t places) {
+    uint64_t scaled = 0;
+    uint8_t len = 0;
+
+    if (places == 0) {
+        whole = (uint32_t)FORMAT_Round(((uint64_t)whole << fracBits) | frac, fracBits);
+    } else {
+        scaled = FORMAT_Round((uint64_t)frac * FORMAT_Pow10[places], fracBits);
+
+        /* Rounding can carry into the integer part (0.9996 -> 1.000) */
+        if (scaled >= FORMAT_Pow10[places]) {
+            scaled -= FORMAT_Pow10[places];
+            whole++;
+        }
+    }
+
+    if (negative) {
+        out[len++] = '-';
+    }
+    len += FORMAT_Uint32(&out[len], whole);
+    if (places > 0) {
+        out[len++] = '.';
+        len += FORMAT_Digits(&out[len], (uint32_t)scaled, places);
+    }
+    return len;
+}
+
+uint8_t FORMAT_Uint32(char* out, uint32_t value) {
+    uint8_t digits = 1;
+
+    /* Count first so the digits can be written left to right in place */
+    while (digits < 10 && value >= FORMAT_Pow10[digits]) {
+        digits++;
+    }
+    return FORMAT_Digits(out, value, digits);
+}
+
+uint8_t FORMAT_Int32(char* out, int32_t value) {
+    if (value < 0) {
+        out[0] = '-';
+        /* Negate as unsigned so INT32_MIN works */
+        return 1 + FORMAT_Uint32(&out[1], 0u - (uint32_t)value);
+    }
+    return FORMAT_Uint32(out, (uint32_t)value);
+}
+
+/******************************************************************************
+ * Signed fixed point with fracBits fraction bits (Q(31-fracBits).fracBits),  *
+ * rounded to 'places' decimals.  Exact: the fraction is scaled and rounded   *
+ * (ties to even) in 64 bit integer arithmetic, so the output matches         *
+ * printf("%.*f") of the same value.                                          *
+ *****************************************************************************/
+uint8_t FORMAT_Fixed(char* out, int32_t value, uint8_t fracBits, uint8_t places) {
+    bool negative = value < 0;
+    uint32_t mag = negative ? 0u - (uint32_t)value : (uint32_t)value;
+
+    if (fracBits > 31) {
+        fracBits = 31;
+    }
+    if (places > FORMAT_MAX_PLACES) {
+        places = FORMAT_MAX_PLACES;
+    }
+
+    return FORMAT_Decimal(out, negative, mag >> fracBits, mag & ((1ull << fracBits) - 1), fracBits, places);
+}
+
+/******************************************************************************
+ * Float, rounded to 'places' decimals.  Only single precision float          *
+ * operations are used, so none of newlib's double printf code is linked.     *
+ * The integer part and the fraction are split exactly and the fraction is    *
+ * rounded in integer arithmetic, so the output matches printf except for     *
+ * fraction bits below 2^-32.  The sign comes from the sign bit, so -0.0f    *
+ * and negatives that round to zero print "-0.000" as printf does.            *
+ * NaN prints "nan", values beyond 32 bits print "inf" with a sign.           *
+ *****************************************************************************/
+uint8_t FORMAT_Float(char* out, float value, uint8_t places) {
+    bool negative = signbit(value);
+    float mag = negative ? -value : value;
+
+    if (places > FORMAT_MAX_PLACES) {
+        places = FORMAT_MAX_PLACES;
+    }
+
+    if (mag != mag) {
+        out[0] = 'n'; out[1] = 'a'; out[2] = 'n';
+        return 3;
+    }
+    if (mag >= 4294967296.0f) {
+        uint8_t len = 0;
+        if (negative) {
+            out[len++] = '-';
+        }
+        out[len++] = 'i'; out[len++] = 'n'; out[len++] = 'f';
+        return len;
+    }
+
+    uint32_t whole = (uint32_t)mag;
+    float frac = mag - (float)whole;          /* exact for float */
+
+    /* Fraction as Q0.32, a power of two scale so exact down to 2^-32 */
+    return FORMAT_Decimal(out, negative, whole, (uint32_t)(frac * 4294967296.0f), 32, places);
+}
@@ -0,0 +1,40 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Number formatting without printf.                                          *
+ * Each function writes the digits of one value into a caller supplied        *
+ * buffer of at least FORMAT_MAX_CHARS bytes and returns the length.  The     *
+ * output is not terminated.  No heap, no stdio, and every loop is bounded    *
+ * by the digit count of a 32 bit value.                                      *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Most decimal places printed, more are clamped (float has ~7 digits anyway) */
+#define FORMAT_MAX_PLACES        9
+/* Sign, 10 integer digits, point and FORMAT_MAX_PLACES digits */
+#define FORMAT_MAX_CHARS         (1 + 10 + 1 + FORMAT_MAX_PLACES)
+
+uint8_t FORMAT_Uint32(char* out, uint32_t value);
+uint8_t FORMAT_Int32(char* out, int32_t value);
+uint8_t FORMAT_Fixed(char* out, int32_t value, uint8_t fracBits, uint8_t places);
+uint8_t FORMAT_Float(char* out, float value, uint8_t places);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FORMAT_H
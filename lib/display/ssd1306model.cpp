@@ -0,0 +1,258 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include "ssd1306model.h"
+#include <string.h>
+
+/* control byte bits */
+#define SSD1306MODEL_CO         0x80    // one byte follows, then another control byte
+#define SSD1306MODEL_DC         0x40    // data rather than commands
+
+SSD1306Model::SSD1306Model(){
+    Reset();
+}
+
+/* Power on state, see the SSD1306 datasheet command table */
+void SSD1306Model::Reset(){
+    memset(_ram, 0, sizeof(_ram));
+    memset(&_stats, 0, sizeof(_stats));
+
+    _mode = SSD1306MODEL_PAGE;
+    _colStart = 0;
+    _colEnd = SSD1306MODEL_WIDTH - 1;
+    _pageStart = 0;
+    _pageEnd = SSD1306MODEL_PAGES - 1;
+    _col = 0;
+    _page = 0;
+    _pageColumn = 0;
+    _contrast = 0x7F;
+    _startLine = 0;
+    _offset = 0;
+    _mux = SSD1306MODEL_HEIGHT - 1;
+    _segRemap = false;
+    _comRemap = false;
+    _inverse = false;
+    _entireOn = false;
+    _displayOn = false;
+
+    _expectControl = true;
+    _isData = false;
+    _continuation = false;
+    _commandLen = 0;
+    _commandNeed = 0;
+}
+
+/******************************************************************************
+ * One transaction as the bus would carry it.                                 *
+ * -------------------------------------------------------------------------- *
+ * @param control       // control byte (I2C_REQUEST_t Reg for the display)   *
+ * @param data          // first byte of the first row                        *
+ * @param length        // bytes per row                                      *
+ * @param rows, stride  // rows gathered stride bytes apart, as the I2C class *
+ *****************************************************************************/
+void SSD1306Model::Write(uint8_t control, const uint8_t* data, uint16_t length, uint8_t rows, uint16_t stride){
+    Begin();
+    Byte(control);
+    for (uint8_t r = 0; r < (rows ? rows : 1); r++){
+        for (uint16_t i = 0; i < length; i++){
+            Byte(data[r * stride + i]);
+        }
+    }
+}
+
+void SSD1306Model::Begin(){
+    _stats.Transactions++;
+    _expectControl = true;
+}
+
+void SSD1306Model::Byte(uint8_t value){
+    _stats.Bytes++;
+
+    if (_expectControl){
+        // Co = 0 keeps this mode to the end of the transaction
+        _isData = value & SSD1306MODEL_DC;
+        _expectControl = false;
+        _continuation = !(value & SSD1306MODEL_CO);
+        return;
+    }
+
+    if (_isData){
+        Data(value);
+    } else {
+        Command(value);
+    }
+    if (!_continuation){
+        _expectControl = true;
+    }
+}
+
+/* Collects an opcode and its arguments, which may span transactions */
+void SSD1306Model::Command(uint8_t value){
+    if (_commandLen == 0){
+        _stats.Commands++;
+        _commandNeed = 1 + ArgumentCount(value);
+    }
+    _command[_commandLen++] = value;
+    if (_commandLen == _commandNeed){
+        Execute();
+        _commandLen = 0;
+    }
+}
+
+uint8_t SSD1306Model::ArgumentCount(uint8_t opcode){
+    switch (opcode){
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+        case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        case 0x21: case 0x22: case 0xA3:
+            return 2;
+        case 0x29: case 0x2A:
+            return 5;
+        case 0x26: case 0x27:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+void SSD1306Model::Execute(){
+    uint8_t op = _command[0];
+
+    if (op <= 0x0F){
+        _pageColumn = (_pageColumn & 0x70) | op;        /* lower nibble */
+        _col = _pageColumn;
+        return;
+    }
+    if (op <= 0x1F){
+        _pageColumn = (_pageColumn & 0x0F) | ((op & 0x07) << 4);
+        _col = _pageColumn;
+        return;
+    }
+    if (op >= 0x40 && op <= 0x7F){
+        _startLine = op & 0x3F;
+        return;
+    }
+    if (op >= 0xB0 && op <= 0xB7){
+        _page = op & 0x07;
+        return;
+    }
+
+    switch (op){
+        case 0x20:
+            if ((_command[1] & 0x03) != 0x03){
+                _mode = _command[1] & 0x03;
+            }
+            break;
+        case 0x21:
+            _colStart = _command[1] & 0x7F;
+            _colEnd = _command[2] & 0x7F;
+            _col = _colStart;
+            break;
+        case 0x22:
+            _pageStart = _command[1] & 0x07;
+            _pageEnd = _command[2] & 0x07;
+            _page = _pageStart;
+            break;
+        case 0x81: _contrast = _command[1]; break;
+        case 0xA0: case 0xA1: _segRemap = op & 0x01; break;
+        case 0xA4: case 0xA5: _entireOn = op & 0x01; break;
+        case 0xA6: case 0xA7: _inverse = op & 0x01; break;
+        case 0xA8:
+            if ((_command[1] & 0x3F) >= 15){
+                _mux = _command[1] & 0x3F;
+            }
+            break;
+        case 0xAE: case 0xAF: _displayOn = op & 0x01; break;
+        case 0xC0: case 0xC8: _comRemap = op & 0x08; break;
+        case 0xD3: _offset = _command[1] & 0x3F; break;
+
+        // timing, power and scrolling: accepted, no effect on the image
+        case 0x26: case 0x27: case 0x29: case 0x2A: case 0x2E: case 0x2F:
+        case 0x8D: case 0xA3: case 0xD5: case 0xD9: case 0xDA: case 0xDB: case 0xE3:
+            break;
+
+        default:
+            _stats.Unknown++;
+            break;
+    }
+}
+
+/* GDDRAM write, then the pointer moves as the addressing mode says */
+void SSD1306Model::Data(uint8_t value){
+    _stats.DataBytes++;
+    _ram[_page][_col] = value;
+
+    switch (_mode){
+        case SSD1306MODEL_HORIZONTAL:
+            if (_col == _colEnd){
+                _col = _colStart;
+                _page = (_page == _pageEnd) ? _pageStart : (_page + 1) & 0x07;
+            } else {
+                _col = (_col + 1) & 0x7F;
+            }
+            break;
+
+        case SSD1306MODEL_VERTICAL:
+            if (_page == _pageEnd){
+                _page = _pageStart;
+                _col = (_col == _colEnd) ? _colStart : (_col + 1) & 0x7F;
+            } else {
+                _page = (_page + 1) & 0x07;
+            }
+            break;
+
+        default:
+            // page mode stays on its page
+            _col = (_col == SSD1306MODEL_WIDTH - 1) ? _pageColumn : _col + 1;
+            break;
+    }
+}
+
+uint8_t SSD1306Model::Ram(uint8_t page, uint8_t column){
+    return _ram[page & 0x07][column & 0x7F];
+}
+
+bool SSD1306Model::Pixel(uint8_t x, uint8_t y){
+    if (!_displayOn || x >= SSD1306MODEL_WIDTH || y > _mux){
+        return false;
+    }
+    if (_entireOn){
+        return true;
+    }
+
+    // the module wires SEG127..0 and COM63..0 left to right / top to bottom
+    uint8_t column = _segRemap ? x : SSD1306MODEL_WIDTH - 1 - x;
+    uint8_t com = _comRemap ? y : _mux - y;
+    uint8_t row = (com + _startLine + _offset) & 0x3F;
+
+    bool lit = (_ram[row / 8][column] >> (row % 8)) & 1;
+    return lit != _inverse;
+}
+
+/******************************************************************************
+ * Writes the panel as a plain PBM.  PBM 1 is black, so unlit pixels are 1    *
+ * and the picture looks like the panel.  64 pixels per text line.            *
+ *****************************************************************************/
+void SSD1306Model::WritePBM(SSD1306Model_Putc put, void* context){
+    const char* header = "P1\n128 64\n";
+
+    while (*header){
+        put(*header++, context);
+    }
+    for (uint8_t y = 0; y < SSD1306MODEL_HEIGHT; y++){
+        for (uint8_t x = 0; x < SSD1306MODEL_WIDTH; x++){
+            put(Pixel(x, y) ? '0' : '1', context);
+            if (x % 64 == 63){
+                put('\n', context);
+            }
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Headless SSD1306: takes the bytes the firmware sends the panel (control    *
+ * byte first, as on the bus) and keeps the controller state and 128x64       *
+ * GDDRAM the way the chip would, so a host build can check what Display and  *
+ * Menu really put on the wire and render it (WritePBM).                      *
+ *                                                                            *
+ * Fed from the I2C trace hook (I2C_TRACE) with a request for the display:    *
+ *     model.Write(request->Reg, (uint8_t*)request->Buffer, request->Length,  *
+ *                 request->Rows, request->Stride);                           *
+ * No HAL, plain C++.                                                         *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef SSD1306MODEL_H
+#define SSD1306MODEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define SSD1306MODEL_WIDTH      128
+#define SSD1306MODEL_HEIGHT     64
+#define SSD1306MODEL_PAGES      (SSD1306MODEL_HEIGHT / 8)
+
+/* GDDRAM addressing modes, command 0x20 */
+#define SSD1306MODEL_HORIZONTAL 0
+#define SSD1306MODEL_VERTICAL   1
+#define SSD1306MODEL_PAGE       2
+
+/* what the model has been sent */
+typedef struct {
+    uint32_t Transactions;
+    uint32_t Bytes;             // control bytes included
+    uint32_t Commands;          // command opcodes, not their arguments
+    uint32_t DataBytes;         // GDDRAM writes
+    uint32_t Unknown;           // opcodes the model does not know
+} SSD1306MODEL_STATS_t;
+
+typedef void (*SSD1306Model_Putc)(char c, void* context);
+
+/*!
+* @brief Host side model of the SSD1306 command/data interface
+*/
+class SSD1306Model
+{
+public:
+    SSD1306Model();
+
+    void Reset();               // power on state
+
+    // one bus transaction: control byte then bytes, rows of length stride apart
+    void Write(uint8_t control, const uint8_t* data, uint16_t length, uint8_t rows = 1, uint16_t stride = 0);
+
+    // byte level: Begin at START, then every byte after the address
+    void Begin();
+    void Byte(uint8_t value);
+
+    // panel as seen on the usual module (upright with A1 + C8): remap, scan
+    // direction, start line, offset, multiplex, invert and on/off applied
+    bool Pixel(uint8_t x, uint8_t y);
+    uint8_t Ram(uint8_t page, uint8_t column);
+
+    // P1 (plain) PBM of the panel, lit pixels white
+    void WritePBM(SSD1306Model_Putc put, void* context);
+
+    bool IsOn() { return _displayOn; }
+    bool IsInverted() { return _inverse; }
+    uint8_t GetContrast() { return _contrast; }
+    uint8_t GetAddressingMode() { return _mode; }
+    SSD1306MODEL_STATS_t GetStats() { return _stats; }
+
+private:
+    uint8_t _ram[SSD1306MODEL_PAGES][SSD1306MODEL_WIDTH];
+
+    // controller state
+    uint8_t _mode;
+    uint8_t _colStart, _colEnd, _pageStart, _pageEnd;
+    uint8_t _col, _page;
+    uint8_t _pageColumn;        // page mode column start, commands 0x00-0x1F
+    uint8_t _contrast;
+    uint8_t _startLine;
+    uint8_t _offset;
+    uint8_t _mux;
+    bool _segRemap;
+    bool _comRemap;
+    bool _inverse;
+    bool _entireOn;
+    bool _displayOn;
+
+    // stream decoding
+    bool _expectControl;        // next byte is a control byte
+    bool _continuation;         // Co = 0: the rest of the transaction is _isData
+    bool _isData;               // D/C# of the current control byte
+    uint8_t _command[7];        // opcode and arguments being collected
+    uint8_t _commandLen;
+    uint8_t _commandNeed;
+
+    SSD1306MODEL_STATS_t _stats;
+
+    void Command(uint8_t value);
+    void Execute();
+    void Data(uint8_t value);
+    static uint8_t ArgumentCount(uint8_t opcode);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SSD1306MODEL_H
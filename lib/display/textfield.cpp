@@ -0,0 +1,182 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include "textfield.h"
+
+/******************************************************************************
+ * Constructors for class.                                                    *
+ * -------------------------------------------------------------------------- *
+ * @param display       // display the field draws into                       *
+ * @param x, y          // top left of the label in pixels                    *
+ * @param label         // static text before the value, may be empty         *
+ * @param width         // value cells, wider values show as '#'             *
+ * @param font          // font for label and value                           *
+ *****************************************************************************/
+TextField::TextField(Display* display, uint16_t x, uint16_t y, const char* label, uint8_t width, FontDef_t font){
+    _display = display;
+    _x = x;
+    _y = y;
+    _label = label;
+    _labelLen = strlen(label);
+    _width = (width > TEXTFIELD_MAX_CHARS) ? TEXTFIELD_MAX_CHARS : width;
+    _font = font;
+    _color = COLOR_WHITE;
+    _pad = ' ';
+    _isRight = false;
+
+    _type = TEXTFIELD_NONE;
+    _value = 0;
+    _fracBits = 0;
+    _places = 0;
+
+    Invalidate();
+}
+
+/******************************************************************************
+ * Public Methods / Function Declarations                                     *
+ *****************************************************************************/
+void TextField::BindUint(const uint32_t* value) {
+    Bind(TEXTFIELD_UINT32, value);
+}
+
+void TextField::BindInt(const int32_t* value) {
+    Bind(TEXTFIELD_INT32, value);
+}
+
+void TextField::BindFixed(const int32_t* value, uint8_t fracBits, uint8_t places) {
+    _fracBits = fracBits;
+    _places = places;
+    Bind(TEXTFIELD_FIXED, value);
+}
+
+void TextField::BindFloat(const float* value, uint8_t places) {
+    _places = places;
+    Bind(TEXTFIELD_FLOAT, value);
+}
+
+void TextField::SetFormat(char pad, bool isRight) {
+    _pad = pad;
+    _isRight = isRight;
+    Invalidate();
+}
+
+void TextField::SetColor(DISPLAY_COLOR_t color) {
+    _color = color;
+    Invalidate();
+}
+
+void TextField::Invalidate(void) {
+    _valid = false;
+}
+
+TEXTFIELD_BOX_t TextField::GetBox(void) {
+    TEXTFIELD_BOX_t box;
+    box.X = _x;
+    box.Y = _y;
+    box.W = (_labelLen + _width) * _font.FontWidth;
+    box.H = _font.FontHeight;
+    return box;
+}
+
+/******************************************************************************
+ * An unchanged value costs one load and compare.  Otherwise the value is    *
+ * formatted into the field's cells and only the cells whose character       *
+ * differs from what is on screen are drawn, so a counter ticking from 1233  *
+ * to 1234 redraws one glyph and marks one glyph's columns dirty.            *
+ *****************************************************************************/
+bool TextField::Update(void) {
+    uint32_t raw = ReadRaw();
+    char text[TEXTFIELD_MAX_CHARS];
+    char str[FORMAT_MAX_CHARS];
+    bool drawn = false;
+    uint8_t i;
+
+    if (_valid && raw == _lastRaw) {
+        return false;
+    }
+
+    /* Lay the value out in the cells as the Display::Print* helpers do */
+    uint8_t len = Format(str, raw);
+    if (len > _width) {
+        memset(text, '#', _width);
+    } else {
+        uint8_t fill = _width - len;
+        uint8_t lead = _isRight ? fill : 0;
+        memset(text, _pad, _width);
+        if (_isRight && _pad == '0' && len > 0 && str[0] == '-') {
+            /* Zero padding goes after the sign */
+            text[0] = '-';
+            memcpy(&text[fill + 1], &str[1], len - 1);
+        } else {
+            memcpy(&text[lead], str, len);
+        }
+    }
+
+    if (!_valid) {
+        _display->GotoXY(_x, _y);
+        _display->Print(_label, _font, _color);
+    }
+
+    for (i = 0; i < _width; i++) {
+        if (!_valid || text[i] != _text[i]) {
+            _display->GotoXY(_x + (_labelLen + i) * _font.FontWidth, _y);
+            _display->Putc(text[i], _font, _color);
+            _text[i] = text[i];
+            drawn = true;
+        }
+    }
+
+    _lastRaw = raw;
+    drawn |= !_valid;
+    _valid = true;
+    return drawn;
+}
+
+/******************************************************************************
+ * Private Methods                                                            *
+ *****************************************************************************/
+void TextField::Bind(TEXTFIELD_TYPE_t type, const void* value) {
+    _type = type;
+    _value = value;
+    Invalidate();
+}
+
+/* Bits of the bound value, so change detection needs no formatting */
+uint32_t TextField::ReadRaw(void) {
+    uint32_t raw = 0;
+
+    if (_type != TEXTFIELD_NONE) {
+        /* every bound type is 32 bits wide */
+        memcpy(&raw, _value, sizeof(raw));
+    }
+    return raw;
+}
+
+uint8_t TextField::Format(char* out, uint32_t raw) {
+    int32_t i;
+    float f;
+
+    switch (_type) {
+        case TEXTFIELD_UINT32:
+            return FORMAT_Uint32(out, raw);
+        case TEXTFIELD_INT32:
+            memcpy(&i, &raw, sizeof(i));
+            return FORMAT_Int32(out, i);
+        case TEXTFIELD_FIXED:
+            memcpy(&i, &raw, sizeof(i));
+            return FORMAT_Fixed(out, i, _fracBits, _places);
+        case TEXTFIELD_FLOAT:
+            memcpy(&f, &raw, sizeof(f));
+            return FORMAT_Float(out, f, _places);
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Retained text field: a static label followed by a number bound to a       *
+ * variable.  Update() looks at the variable and redraws only the character   *
+ * cells whose text changed, so a field that is not changing costs one        *
+ * compare and puts nothing in the display's dirty windows.                   *
+ *                                                                            *
+ *   Label = 12345      <- label drawn once, value cells as they change       *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef TEXTFIELD_H
+#define TEXTFIELD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+#include "display.h"
+#include "format.h"
+
+/* Widest value part of a field in characters */
+#define TEXTFIELD_MAX_CHARS      FORMAT_MAX_CHARS
+
+typedef enum {
+    TEXTFIELD_NONE,             /*!< Label only */
+    TEXTFIELD_UINT32,
+    TEXTFIELD_INT32,
+    TEXTFIELD_FIXED,            /*!< int32_t with fraction bits */
+    TEXTFIELD_FLOAT
+} TEXTFIELD_TYPE_t;
+
+/* Screen area a field can draw into */
+typedef struct {
+    uint16_t X;
+    uint16_t Y;
+    uint16_t W;
+    uint16_t H;
+} TEXTFIELD_BOX_t;
+
+/*!
+* @brief Label plus bound numeric value, redrawn only where it changed
+*/
+class TextField
+{
+public:
+    TextField(Display* display, uint16_t x, uint16_t y, const char* label, uint8_t width, FontDef_t font);
+
+    void BindUint(const uint32_t* value);
+    void BindInt(const int32_t* value);
+    void BindFixed(const int32_t* value, uint8_t fracBits, uint8_t places);
+    void BindFloat(const float* value, uint8_t places);
+    void SetFormat(char pad, bool isRight);
+    void SetColor(DISPLAY_COLOR_t color);
+
+    bool Update(void);          // redraws changed cells, true if anything was drawn
+    void Invalidate(void);      // next Update redraws everything (e.g. after Clear)
+    TEXTFIELD_BOX_t GetBox(void);
+
+private:
+    Display* _display;
+    uint16_t _x, _y;
+    const char* _label;
+    uint8_t _labelLen;
+    uint8_t _width;             // value cells
+    FontDef_t _font;
+    DISPLAY_COLOR_t _color;
+    char _pad;
+    bool _isRight;
+
+    TEXTFIELD_TYPE_t _type;
+    const void* _value;
+    uint8_t _fracBits;
+    uint8_t _places;
+
+    bool _valid;                // label and _text are on screen
+    uint32_t _lastRaw;          // bits of the value last drawn
+    char _text[TEXTFIELD_MAX_CHARS]; // value cells last drawn
+
+    void Bind(TEXTFIELD_TYPE_t type, const void* value);
+    uint32_t ReadRaw(void);
+    uint8_t Format(char* out, uint32_t raw);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEXTFIELD_H
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ *****************************************************************************/
+#include "battery.h"
+
+/******************************************************************************
+ * Constructor, nothing touches the hardware until Init.                      *
+ * -------------------------------------------------------------------------- *
+ * @param pin, port     // the divider tap, an ADC1 input                     *
+ * @param channel       // its ADC1 channel, 0-15                             *
+ * @param millivoltsPerCount // Q16, from Battery_MillivoltsPerCount          *
+ * @param lowMv, criticalMv  // Level thresholds                              *
+ *****************************************************************************/
+Battery::Battery(uint32_t pin, GPIO_TypeDef* port, uint8_t channel, int32_t millivoltsPerCount, int32_t lowMv, int32_t criticalMv){
+    _pin = pin;
+    _port = port;
+    _channel = channel;
+    _millivoltsPerCount = millivoltsPerCount;
+    _lowMv = lowMv;
+    _criticalMv = criticalMv;
+
+    _filtered = 0;
+    _seeded = false;
+    _millivolts = 0;
+    _dutyPerMillivolt = ((uint32_t)MOTOR_DUTY_FULL << 16) / BATT_MIN_MV;
+    _level = BATT_LEVEL_OK;
+    _samples = 0;
+}
+
+void Battery::Init(){
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+
+    GPIO_InitStruct.Pin = _pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(_port, &GPIO_InitStruct);
+
+    // ADCCLK = PCLK2 / 4 (24 MHz, 36 MHz max), 12 bit, one channel
+    ADC->CCR = (ADC->CCR & ~ADC_CCR_ADCPRE) | ADC_CCR_ADCPRE_0;
+    ADC1->CR1 = 0;
+    ADC1->CR2 = 0;
+    ADC1->SQR1 = 0;                         /* L = 0, one conversion */
+    ADC1->SQR3 = _channel;
+
+    // longest sample time (480 cycles): the divider is a high impedance source
+    if (_channel < 10){
+        ADC1->SMPR2 |= 7UL << (3 * _channel);
+    } else {
+        ADC1->SMPR1 |= 7UL << (3 * (_channel - 10));
+    }
+
+    // converting back to back from here on, DR always holds the latest
+    ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_CONT;
+    ADC1->CR2 |= ADC_CR2_SWSTART;
+}
+
+void Battery::Update(){
+    if (ADC1->SR & ADC_SR_EOC){
+        Sample((uint16_t)ADC1->DR);         /* reading DR clears EOC */
+    }
+}
+
+/******************************************************************************
+ * Filters one reading and works out the voltage, the motor scale and the     *
+ * level from it.  The first reading seeds the filter, so the voltage is      *
+ * right from the first tick rather than climbing up from zero.               *
+ * -------------------------------------------------------------------------- *
+ * @param counts        // 12 bit ADC result                                  *
+ *****************************************************************************/
+void Battery::Sample(uint16_t counts){
+    int32_t reading = (int32_t)counts << 16;
+    if (!_seeded){
+        _filtered = reading;
+        _seeded = true;
+    }
+    _filtered += (reading - _filtered) >> BATT_FILTER_SHIFT;
+
+    int32_t mv = (int32_t)(((int64_t)_filtered * _millivoltsPerCount) >> 32);
+    int32_t supply = (mv < BATT_MIN_MV) ? BATT_MIN_MV : mv;
+
+    uint8_t level = _level;
+    if (mv < _criticalMv){
+        level = BATT_LEVEL_CRITICAL;
+    } else if (mv < _lowMv){
+        if (level == BATT_LEVEL_OK || mv >= _criticalMv + BATT_HYSTERESIS_MV){
+            level = BATT_LEVEL_LOW;
+        }
+    } else if (mv >= _lowMv + BATT_HYSTERESIS_MV){
+        level = BATT_LEVEL_OK;
+    } else if (level == BATT_LEVEL_CRITICAL){
+        level = BATT_LEVEL_LOW;
+    }
+
+    _millivolts = mv;
+    _dutyPerMillivolt = ((uint32_t)MOTOR_DUTY_FULL << 16) / (uint32_t)supply;
+    _level = level;
+    _samples++;
+}
+
+int32_t Battery::Millivolts(){
+    return _millivolts;
+}
+
+uint32_t Battery::DutyPerMillivolt(){
+    return _dutyPerMillivolt;
+}
+
+uint8_t Battery::Level(){
+    return _level;
+}
+
+uint32_t Battery::Samples(){
+    return _samples;
+}
+
+void Battery::OnTick(const SCHEDULER_TICK_t* tick, void* context){
+    ((Battery*)context)->Update();
+}
@@ -0,0 +1,108 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Supply monitor: the pack through a resistor divider into one ADC1 input.   *
+ * The ADC converts continuously on its own; Update (a SCHED_PHASE_SAMPLE     *
+ * stage) just takes the latest result, so it never waits.  The reading is    *
+ * low pass filtered in fixed point and gives                                 *
+ *                                                                            *
+ *   Millivolts          the pack voltage                                     *
+ *   DutyPerMillivolt    Motor::SetVoltage scale, so a command in volts       *
+ *                       drives the motor the same on a full or a tired pack  *
+ *   Level               ok / low / critical, with hysteresis, for the UI     *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+#include "motor.h"
+#include "scheduler.h"
+
+#define BATT_ADC_COUNTS         4096
+
+/* IIR: each Update moves 1/2^n of the way to the new reading, about
+   2^n ticks to settle; long enough to ride over PWM ripple and stall sag */
+#ifndef BATT_FILTER_SHIFT
+#define BATT_FILTER_SHIFT       6
+#endif
+
+/* a level is only left once the voltage is this far back above it */
+#ifndef BATT_HYSTERESIS_MV
+#define BATT_HYSTERESIS_MV      100
+#endif
+
+/* below this there is no pack (USB power): compensate as if there were,
+   rather than asking for a huge duty */
+#ifndef BATT_MIN_MV
+#define BATT_MIN_MV             3000
+#endif
+
+#define BATT_LEVEL_OK           0
+#define BATT_LEVEL_LOW          1
+#define BATT_LEVEL_CRITICAL     2
+
+// C++ even when included from inside another header's extern "C" block
+extern "C++" {
+
+/* ADC count to pack millivolts, Q16: reference in mV times the divide ratio */
+constexpr int32_t Battery_MillivoltsPerCount(double vrefMv, double divider) {
+    return (int32_t)(vrefMv * divider / BATT_ADC_COUNTS * 65536.0 + 0.5);
+}
+
+}
+
+/*!
+* @brief Filtered pack voltage from ADC1
+*/
+class Battery {
+
+private:
+    uint32_t _pin;
+    GPIO_TypeDef* _port;
+    uint8_t _channel;
+    int32_t _millivoltsPerCount;    // Q16
+    int32_t _lowMv;
+    int32_t _criticalMv;
+
+    int32_t _filtered;              // ADC counts Q16
+    bool _seeded;
+
+    volatile int32_t _millivolts;
+    volatile uint32_t _dutyPerMillivolt;
+    volatile uint8_t _level;
+    volatile uint32_t _samples;
+
+public:
+    Battery(uint32_t pin, GPIO_TypeDef* port, uint8_t channel, int32_t millivoltsPerCount, int32_t lowMv, int32_t criticalMv);
+
+    void Init();                    // ADC1 converting the channel continuously
+
+    // tick side, one context only
+    void Update();                  // the latest conversion
+    void Sample(uint16_t counts);   // a reading from elsewhere, or simulated
+
+    int32_t Millivolts();
+    uint32_t DutyPerMillivolt();    // MOTOR_DUTY_FULL per mV, Q16
+    uint8_t Level();
+    uint32_t Samples();
+
+    // SCHED_PHASE_SAMPLE stage, context is the Battery
+    static void OnTick(const SCHEDULER_TICK_t* tick, void* context);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BATTERY_H
@@ -0,0 +1,25 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -----                                                                      *
+ * Copyright 2024 - James Clarke                                              *
+ * -----                                                                      *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include "cycles.h"
+
+/******************************************************************************
+ * Starts the DWT cycle counter.  Until this runs CYCLES_Now reads zero, so   *
+ * anything timed with it just reports no time.                               *
+ ******************************************************************************/
+void CYCLES_Init(void){
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;   // enable the trace block
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t CYCLES_ToMicros(uint32_t cycles){
+    return cycles / (SystemCoreClock / 1000000);
+}
@@ -0,0 +1,36 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -----                                                                      *
+ * Copyright 2024 - James Clarke                                              *
+ * Core clock cycle counter (DWT CYCCNT) for timing code on the target.       *
+ * The counter wraps every 2^32 cycles (~44 s at 96 MHz); differences of    *
+ * two readings are correct across one wrap.                                  *
+ * -----                                                                      *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+
+void CYCLES_Init(void);
+uint32_t CYCLES_ToMicros(uint32_t cycles);
+
+/* inline, it is read around every timed wait */
+static inline uint32_t CYCLES_Now(void) {
+    return DWT->CYCCNT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CYCLES_H
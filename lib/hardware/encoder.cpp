@@ -11,6 +11,9 @@
  *****************************************************************************/
 #include "encoder.h"
 
+// objects serving the capture interrupts (TIM2, TIM4), registered by Init
+static Encoder* encoder_instances[2];
+
 /******************************************************************************
  * PUBLIC INTERFACE                                                           *
  *****************************************************************************/
@@ -18,11 +21,39 @@
 Encoder::Encoder(TIM_HandleTypeDef timer, uint32_t channela_pin, uint32_t channelb_pin, GPIO_TypeDef* channela_port, GPIO_TypeDef* channelb_port, uint32_t alternate) {
     // push constructor values to internal variables
     htimer = timer;
+    _position = 0;
+    _delta = 0;
+    _updates = 0;
+    _lastCount = ENC_ZERO;
+    _lastTick = 0;
+    _edges = 0;
+    _prevEdges = 0;
+    _edgeValid = false;
+    _edgeTiming = false;
+    _filterShift = ENC_VELOCITY_FILTER;
+    _stopCycles = 0;
+    _countsPerRev = ENC_COUNTS_PER_REV;
+    _rawVelocity = 0;
+    _velocity = 0;
     InitTimer(alternate, channela_pin, channelb_pin, channela_port, channelb_port);
 }
 
 void Encoder::Init(){ 
     HAL_TIM_Encoder_Start(&htimer, TIM_CHANNEL_ALL);
+
+    // standing still to begin with: edge timing on
+    _stopCycles = SystemCoreClock / 1000 * ENC_STOP_MS;
+    _lastTick = CYCLES_Now();
+    if (htimer.Instance == TIM2){
+        encoder_instances[0] = this;
+        NVIC_SetPriority(TIM2_IRQn, ENC_IRQ_PRIORITY);
+        NVIC_EnableIRQ(TIM2_IRQn);
+    } else if (htimer.Instance == TIM4){
+        encoder_instances[1] = this;
+        NVIC_SetPriority(TIM4_IRQn, ENC_IRQ_PRIORITY);
+        NVIC_EnableIRQ(TIM4_IRQn);
+    }
+    SetEdgeTiming(true);
 }
 
 uint16_t Encoder::Read(){
@@ -31,19 +62,244 @@ uint16_t Encoder::Read(){
     return l_return;
 }
 
+// the counter and the accumulated position start again from zero together
 void Encoder::ResetCount(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
     htimer.Instance->CNT = ENC_ZERO;
+    _lastCount = ENC_ZERO;
+    _position = 0;
+    _delta = 0;
+    _updates = 0;
+    _edgeValid = false;
+    __set_PRIMASK(primask);
 }
 
 float Encoder::GetAngle(){
     float l_return = 0.0;
-    l_return = (2 * 3.141 * (float)((int32_t)htimer.Instance->CNT - (int32_t)ENC_ZERO) / (float)ENC_RESOLUTION);
+    l_return = (ENC_TWO_PI * (float)Position() / _countsPerRev);
     return l_return;
 }
 
+void Encoder::SetCountsPerRev(float counts){
+    if (counts > 0){
+        _countsPerRev = counts;
+    }
+}
+
+/******************************************************************************
+ * Accumulates the counter and estimates the velocity.  Call at a fixed rate, *
+ * from one context only.                                                     *
+ *****************************************************************************/
+void Encoder::Update(){
+    Update((uint16_t)htimer.Instance->CNT, CYCLES_Now());
+}
+
+/******************************************************************************
+ * Update with a counter value and time read by the caller (or made up, to    *
+ * exercise the wrap and the estimator on a host build).  Same work every     *
+ * call: no loops, two 32 bit divisions (see Rate).                           *
+ *                                                                            *
+ *   M range: counts this tick / tick time                                    *
+ *   T range: an edge since the last tick - counts between the edges the two  *
+ *            estimates ended on / time between them                          *
+ *            no edge - no faster than one edge spacing over the time since   *
+ *            the last edge, zero after ENC_STOP_MS                           *
+ * -------------------------------------------------------------------------- *
+ * @param count         // low 16 bits of the timer counter                  *
+ * @param now           // CYCLES_Now() when it was read                     *
+ *****************************************************************************/
+void Encoder::Update(uint16_t count, uint32_t now){
+    int16_t delta = CountDelta(count, _lastCount);
+    uint32_t tickCycles = now - _lastTick;
+    _lastCount = count;
+    _lastTick = now;
+
+    // the edge interrupt may move these
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t edges = _edges;
+    uint16_t edgeCount = _edgeCount;
+    uint32_t edgeTime = _edgeTime;
+    __set_PRIMASK(primask);
+
+    int32_t raw;
+    bool newEdge = edges != _prevEdges;
+
+    if (!_edgeTiming || !_edgeValid){
+        raw = Rate(delta, tickCycles);
+    } else if (newEdge){
+        raw = Rate(CountDelta(edgeCount, _prevEdgeCount), edgeTime - _prevEdgeTime);
+    } else {
+        uint32_t since = now - _prevEdgeTime;
+        int32_t bound = (since > _stopCycles) ? 0 : Rate(ENC_COUNTS_PER_EDGE, since);
+        raw = _rawVelocity;
+        if (raw > bound){
+            raw = bound;
+        } else if (raw < -bound){
+            raw = -bound;
+        }
+    }
+
+    if (newEdge){
+        _prevEdges = edges;
+        _prevEdgeCount = edgeCount;
+        _prevEdgeTime = edgeTime;
+        _edgeValid = _edgeTiming;
+    }
+
+    // switch range with some hysteresis
+    int16_t speed = (delta < 0) ? -delta : delta;
+    if (_edgeTiming && speed > ENC_MT_HIGH_COUNTS){
+        SetEdgeTiming(false);
+    } else if (!_edgeTiming && speed < ENC_MT_LOW_COUNTS){
+        SetEdgeTiming(true);
+    }
+
+    // readers may be interrupted by this, Snapshot keeps them together
+    primask = __get_PRIMASK();
+    __disable_irq();
+    _position += delta;
+    _delta = delta;
+    _updates++;
+    _rawVelocity = raw;
+    _velocity += Filter(raw - _velocity, _filterShift);
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ * Latches CNT into CCR3 on the TIM1 trigger (ITR0 on both TIM2 and TIM4),    *
+ * so the two wheels are read at the same timer clock edge however late the   *
+ * interrupt that picks them up runs.  The slave mode stays encoder: TS only  *
+ * routes the trigger to TRC, which IC3 captures on.                          *
+ *****************************************************************************/
+void Encoder::EnableSyncLatch(){
+    TIM_TypeDef* tim = htimer.Instance;
+
+    tim->CCER &= ~TIM_CCER_CC3E;
+    tim->SMCR = (tim->SMCR & ~TIM_SMCR_TS_Msk) | (0 << TIM_SMCR_TS_Pos);      /* ITR0 = TIM1 TRGO */
+    tim->CCMR2 = (tim->CCMR2 & ~TIM_CCMR2_CC3S) | (3 << TIM_CCMR2_CC3S_Pos);  /* IC3 on TRC */
+    tim->CCER |= TIM_CCER_CC3E;
+}
+
+uint16_t Encoder::Latched(){
+    return (uint16_t)htimer.Instance->CCR3;
+}
+
+// Update with the count latched at 'time' (CYCLES_Now() of the trigger)
+void Encoder::UpdateLatched(uint32_t time){
+    Update(Latched(), time);
+}
+
+/******************************************************************************
+ * One captured TI1 edge.                                                     *
+ * -------------------------------------------------------------------------- *
+ * @param count         // counter at the edge (CCR1)                        *
+ * @param time          // CYCLES_Now() at the edge                          *
+ *****************************************************************************/
+void Encoder::Capture(uint16_t count, uint32_t time){
+    _edgeCount = count;
+    _edgeTime = time;
+    _edges++;
+}
+
+// reading CCR1 clears CC1IF, an overcapture only means an edge went untimed
+void Encoder::CaptureIRQHandler(){
+    uint32_t sr = htimer.Instance->SR;
+
+    if (sr & TIM_SR_CC1IF){
+        Capture((uint16_t)htimer.Instance->CCR1, CYCLES_Now());
+    }
+    if (sr & TIM_SR_CC1OF){
+        htimer.Instance->SR = ~TIM_SR_CC1OF;
+    }
+}
+
+int32_t Encoder::Position(){
+    return _position;
+}
+
+int16_t Encoder::Delta(){
+    return _delta;
+}
+
+ENCODER_SNAPSHOT_t Encoder::Snapshot(){
+    ENCODER_SNAPSHOT_t snapshot;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    snapshot.Position = _position;
+    snapshot.Delta = _delta;
+    snapshot.Updates = _updates;
+    snapshot.Velocity = _velocity;
+    __set_PRIMASK(primask);
+    return snapshot;
+}
+
+int32_t Encoder::Velocity(){
+    return _velocity;
+}
+
+int32_t Encoder::RawVelocity(){
+    return _rawVelocity;
+}
+
+void Encoder::SetVelocityFilter(uint8_t shift){
+    _filterShift = (shift > 15) ? 15 : shift;
+}
+
+bool Encoder::IsEdgeTiming(){
+    return _edgeTiming;
+}
+
+// signed step between two 16 bit counts, right across the wrap either way
+int16_t Encoder::CountDelta(uint16_t count, uint16_t last){
+    return (int16_t)(uint16_t)(count - last);
+}
+
 /******************************************************************************
  * PRIVATE METHODS                                                            *
  *****************************************************************************/
+// the edge interrupt is only wanted in the T range
+void Encoder::SetEdgeTiming(bool on){
+    _edgeTiming = on;
+    _edgeValid = false;
+    if (on){
+        htimer.Instance->SR = ~(TIM_SR_CC1IF | TIM_SR_CC1OF);
+        htimer.Instance->DIER |= TIM_DIER_CC1IE;
+    } else {
+        htimer.Instance->DIER &= ~TIM_DIER_CC1IE;
+    }
+}
+
+// step / 2^shift rounded to nearest, halves away from zero: a plain >> would
+// floor, and pull the estimate down by up to a count/s Q8 each tick
+int32_t Encoder::Filter(int32_t step, uint8_t shift){
+    int32_t half = shift ? 1 << (shift - 1) : 0;
+    return (step >= 0) ? (step + half) >> shift : -((half - step) >> shift);
+}
+
+/******************************************************************************
+ * Counts over cycles as counts/s Q8, in 32 bit divides only: counts times    *
+ * one count's rate, clock * 256 / cycles rounded, which is split into the    *
+ * whole and the remainder part so neither overflows.  Past 2^24 cycles       *
+ * (175 ms at 96 MHz) the remainder * 256 would, so clock and cycles both     *
+ * lose 8 bits first; the rate is a few counts/s by then.                     *
+ *****************************************************************************/
+int32_t Encoder::Rate(int32_t counts, uint32_t cycles){
+    uint32_t clock = SystemCoreClock;
+
+    if (cycles == 0){
+        return 0;
+    }
+    if (cycles >= (1UL << 24)){
+        clock >>= 8;
+        cycles >>= 8;
+    }
+    uint32_t unit = clock / cycles * 256 + (clock % cycles * 256 + cycles / 2) / cycles;
+    return counts * (int32_t)unit;
+}
+
 void Encoder::InitTimer(uint32_t alternate, uint32_t channela_pin, uint32_t channelb_pin, GPIO_TypeDef* channela_port, GPIO_TypeDef* channelb_port){
 
     TIM_Encoder_InitTypeDef sConfig = {0};
@@ -84,7 +340,7 @@ void Encoder::InitTimer(uint32_t alternate, uint32_t channela_pin, uint32_t chan
     sConfig.EncoderMode = TIM_ENCODERMODE_TI12;
     sConfig.IC1Polarity = TIM_ICPOLARITY_RISING;        //TIM_ICPOLARITY_RISING
     sConfig.IC1Selection = TIM_ICSELECTION_DIRECTTI;
-    sConfig.IC1Prescaler = TIM_ICPSC_DIV4;              //TIM_ICPSC_DIV1
+    sConfig.IC1Prescaler = TIM_ICPSC_DIV1;              // every TI1 edge captured, for the velocity
     sConfig.IC1Filter = 0;
     sConfig.IC2Polarity = TIM_ICPOLARITY_RISING;          // TIM_ICPOLARITY_BOTHEDGE
     sConfig.IC2Selection = TIM_ICSELECTION_DIRECTTI;
@@ -109,3 +365,13 @@ void Encoder::Error_Handler(){
   }
 }
 
+/******************************************************************************
+ * Interrupt vectors                                                          *
+ *****************************************************************************/
+extern "C" void TIM2_IRQHandler(void){
+    if (encoder_instances[0]) encoder_instances[0]->CaptureIRQHandler();
+}
+
+extern "C" void TIM4_IRQHandler(void){
+    if (encoder_instances[1]) encoder_instances[1]->CaptureIRQHandler();
+}
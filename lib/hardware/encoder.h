@@ -18,9 +18,63 @@ extern "C" {
 #endif
 
 #include "stm32f4xx.h"  // Device header
+#include "cycles.h"
+
+/* x4 counting: TI1 rises once every 4 counts, that edge is captured */
+#ifndef ENC_COUNTS_PER_EDGE
+#define ENC_COUNTS_PER_EDGE     4
+#endif
+
+/* counts per Update above which edge timing is switched off (plain count
+   differences are accurate by then) and below which it is switched back on */
+#ifndef ENC_MT_HIGH_COUNTS
+#define ENC_MT_HIGH_COUNTS      24
+#endif
+#ifndef ENC_MT_LOW_COUNTS
+#define ENC_MT_LOW_COUNTS       12
+#endif
+
+/* NVIC preemption priority of the edge capture, highest: the DWT stamp is
+   only as good as its latency */
+#ifndef ENC_IRQ_PRIORITY
+#define ENC_IRQ_PRIORITY        0
+#endif
+
+/* no edge for this long reads as standing still */
+#ifndef ENC_STOP_MS
+#define ENC_STOP_MS             100
+#endif
+
+/* counts per wheel turn for GetAngle, SetCountsPerRev sets the robot's own */
+#ifndef ENC_COUNTS_PER_REV
+#define ENC_COUNTS_PER_REV      1440
+#endif
+
+/* velocity IIR: each Update moves 1/2^n of the way to the new estimate, 0 = raw */
+#ifndef ENC_VELOCITY_FILTER
+#define ENC_VELOCITY_FILTER     2
+#endif
+
+/* position and motion of one wheel, taken together by Snapshot */
+typedef struct {
+    int32_t Position;           // counts since the last ResetCount
+    int16_t Delta;              // counts moved in the last Update
+    uint32_t Updates;           // Update calls since the last ResetCount
+    int32_t Velocity;           // filtered, counts/s Q8
+} ENCODER_SNAPSHOT_t;
 
 /*!
 * @brief Encoders Object - two wheels to drive
+*
+* The timer counts are only looked at as 16 bit: Update, called at a fixed
+* tick, adds the signed 16 bit step since the previous call to a 32 bit
+* position, so TIM2 (32 bit) and TIM4 (16 bit) wrap the same way and the
+* position never jumps.  Needs an Update before the wheel moves 32767 counts.
+*
+* Velocity (counts/s, Q8) is the M/T estimate: at speed the count difference
+* over the tick (M), slowly the counts between the last captured TI1 edges
+* over the time between them (T, DWT stamped in the CC1 interrupt).  The edge
+* interrupt only runs in the slow range, so its load stays bounded.
 */
 
 class Encoder{
@@ -28,9 +82,39 @@ class Encoder{
 private:
 
     #define ENC_ZERO (0)
-    #define ENC_RESOLUTION (1024 - 1)
+    #define ENC_TWO_PI (6.28318531f)
 
     TIM_HandleTypeDef htimer;
+
+    // accumulated by Update, read from anywhere
+    volatile int32_t _position;
+    volatile int16_t _delta;
+    volatile uint32_t _updates;
+    uint16_t _lastCount;        // counter at the previous Update
+    uint32_t _lastTick;         // CYCLES_Now() at the previous Update
+
+    // last captured TI1 edge, written by the CC1 interrupt
+    volatile uint16_t _edgeCount;
+    volatile uint32_t _edgeTime;
+    volatile uint32_t _edges;
+
+    // the edge the previous estimate ended on
+    uint16_t _prevEdgeCount;
+    uint32_t _prevEdgeTime;
+    uint32_t _prevEdges;
+    bool _edgeValid;
+
+    bool _edgeTiming;           // T range, CC1 interrupt on
+    uint8_t _filterShift;
+    uint32_t _stopCycles;
+    float _countsPerRev;
+    volatile int32_t _rawVelocity;
+    volatile int32_t _velocity;
+
+    void SetEdgeTiming(bool on);
+    static int32_t Rate(int32_t counts, uint32_t cycles);
+    static int32_t Filter(int32_t step, uint8_t shift);
+
     void InitTimer(uint32_t alternate, uint32_t channela_pin, uint32_t channelb_pin, GPIO_TypeDef* channela_port, GPIO_TypeDef* channelb_port);
     void Error_Handler(void);
 
@@ -38,9 +122,36 @@ public:
     
     Encoder(TIM_HandleTypeDef timer, uint32_t channela_pin, uint32_t channelb_pin, GPIO_TypeDef* channela_port, GPIO_TypeDef* channelb_port, uint32_t alternate); // constructor
     void Init();
-    uint16_t Read();
+    uint16_t Read();            // raw counter, wraps
     void ResetCount();
-    float GetAngle();
+    float GetAngle();           // wheel angle in radians, from Position
+    void SetCountsPerRev(float counts);     // encoder CPR x gear ratio
+
+    // tick side, one context only (the control tick, see SyncSampler)
+    void Update();
+    void Update(uint16_t count, uint32_t now);  // with the counter and time read elsewhere, or simulated
+
+    // counter latched into CCR3 by TIM1 TRGO, see SyncSampler
+    void EnableSyncLatch();
+    uint16_t Latched();
+    void UpdateLatched(uint32_t time);
+
+    // edge side, the CC1 interrupt (or a simulated edge stream)
+    void Capture(uint16_t count, uint32_t time);
+    void CaptureIRQHandler();
+
+    // accumulated position
+    int32_t Position();
+    int16_t Delta();
+    ENCODER_SNAPSHOT_t Snapshot();
+
+    // velocity, counts/s Q8
+    int32_t Velocity();         // filtered
+    int32_t RawVelocity();      // last estimate before the filter
+    void SetVelocityFilter(uint8_t shift);
+    bool IsEdgeTiming();
+
+    static int16_t CountDelta(uint16_t count, uint16_t last);
 
 };
 
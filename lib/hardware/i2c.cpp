@@ -10,24 +10,78 @@
  ******************************************************************************/
 #include "i2c.h"
 
+// objects serving the interrupt vectors, registered by i2c_init
+static I2C* i2c_instances[2];
+
+// DMA stream flag bits, relative to the stream's offset in HISR/HIFCR
+#define DMA_FLAG_TEIF   (1 << 3)
+#define DMA_FLAG_TCIF   (1 << 5)
+#define DMA_FLAG_ALL    0x3D
+
+// i2ctiming.h against the worked values in RM0383 18.6.8 - 18.6.9
+static_assert(I2C_TimingFor<48000000, 400000>::Value.Ccr == (0x8000 | 40) &&
+              I2C_TimingFor<48000000, 400000>::Value.Trise == 15, "I2C timing: 48 MHz fast");
+static_assert(I2C_TimingFor<48000000, 100000>::Value.Ccr == 240 &&
+              I2C_TimingFor<48000000, 100000>::Value.Trise == 49, "I2C timing: 48 MHz standard");
+static_assert(I2C_TimingFor<50000000, 400000>::Value.Ccr == (0xC000 | 5) &&
+              I2C_TimingFor<50000000, 400000>::Value.Trise == 16, "I2C timing: 50 MHz fast, DUTY 16:9");
+static_assert(I2C_TimingFor<8000000, 100000>::Value.Ccr == 40 &&
+              I2C_TimingFor<8000000, 100000>::Value.Trise == 9, "I2C timing: 8 MHz standard");
+static_assert(I2C_TimingFor<8000000, 400000>::Value.SpeedHz == 380952, "I2C timing: 8 MHz fast rounds down");
+
 /******************************************************************************
  * Constructors for class.  Including default (empty)                         *
  * -------------------------------------------------------------------------- *
  * @param sdapin        // pin assignment for I2C SDA                         *
  * @param sclpin        // pin assignment for I2C SCL                         *
  * @param i2cmodule     // I2C module in STM32F411 (1 or 2)                   *
+ * @param timing        // I2C_TimingFor<pclk1, speed>::Value for the clocks  *
  ******************************************************************************/
-I2C::I2C(uint16_t sdapin, uint16_t sclpin, uint16_t i2cmodule)
+I2C::I2C(uint16_t sdapin, uint16_t sclpin, uint16_t i2cmodule, I2C_TIMING_t timing)
 {
+    _timing = timing;
     _sclPin = sclpin;
     _sdaPin = sdapin;
     _i2cmodule = i2cmodule;
+    for (uint8_t p = 0; p < I2C_PRIORITIES; p++){
+        _queueHead[p] = 0;
+        _queueTail[p] = 0;
+    }
+    _current = 0;
+    _suspended = 0;
+    _dmaRequest.Status = I2C_REQ_DONE;
+    _dmaReadRequest.Status = I2C_REQ_DONE;
+    i2c_ResetStats();
+#ifdef I2C_TRACE
+    _traceHook = 0;
+    i2c_TraceClear();
+#endif
 
-    if (i2cmodule == 1)
+    // port B pins, see i2c_init for the combinations
+    _sclIndex = (sclpin == GPIO_PIN_6) ? 6 : 8;
+    _sdaIndex = (sdapin == GPIO_PIN_7) ? 7 : 9;
+
+    if (i2cmodule == 1){
         _i2c = I2C1;
+        _dmaTx = DMA1_Stream6;
+        _dmaTxChannel = 1;
+        _dmaTxFlagShift = 16;
+        _dmaRx = DMA1_Stream0;
+        _dmaRxChannel = 1;
+        _dmaRxFlagShift = 0;
+    }
     
-    if (i2cmodule == 2)
+    if (i2cmodule == 2){
         _i2c = I2C2;
+        _sclIndex = 10;
+        _sdaIndex = 11;
+        _dmaTx = DMA1_Stream7;
+        _dmaTxChannel = 7;
+        _dmaTxFlagShift = 22;
+        _dmaRx = DMA1_Stream2;
+        _dmaRxChannel = 7;
+        _dmaRxFlagShift = 16;
+    }
 
 }
 
@@ -35,6 +89,11 @@ I2C::I2C(){}
 
 void I2C::i2c_init()
 {
+    // the bus may be shared by several devices, only the first one sets it up
+    if (_initialised){
+        return;
+    }
+    _initialised = true;
 
     RCC->AHB1ENR|=RCC_AHB1ENR_GPIOBEN; //enable gpiob clock
     if (_i2cmodule == 1)
@@ -79,75 +138,839 @@ void I2C::i2c_init()
         GPIOB->OTYPER|=GPIO_OTYPER_OT10|GPIO_OTYPER_OT11; //set pb8 and pb9 as open drain
     }
 
+    // phase deadlines, see i2c_arm
+    _byteCycles = SystemCoreClock / _timing.SpeedHz * 9;
+    _slackCycles = SystemCoreClock / 1000000 * I2C_TIMEOUT_SLACK_US;
+
+    // a high request may find one chunk of a low write, plus its overhead, ahead of it
+    _highWaitCycles = SystemCoreClock / 1000000 * I2C_HIGH_WAIT_US;
+    uint32_t budget = _highWaitCycles / _byteCycles;
+    _chunkBytes = (budget > I2C_CHUNK_OVERHEAD) ? budget - I2C_CHUNK_OVERHEAD : 1;
+
+    i2c_configure();
+
+    // a device left mid-byte by a reset can hold SDA low
+    if (_i2c->SR2 & I2C_SR2_BUSY){
+        i2c_recover();
+    }
+
+    // queued transfers: register for the vectors, clock the DMA streams
+    i2c_instances[_i2cmodule - 1] = this;
+    RCC->AHB1ENR|=RCC_AHB1ENR_DMA1EN;
+    if (_i2cmodule == 1){
+        NVIC_SetPriority(I2C1_EV_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_SetPriority(I2C1_ER_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_SetPriority(DMA1_Stream6_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_SetPriority(DMA1_Stream0_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_EnableIRQ(I2C1_EV_IRQn);
+        NVIC_EnableIRQ(I2C1_ER_IRQn);
+        NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+        NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+    } else {
+        NVIC_SetPriority(I2C2_EV_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_SetPriority(I2C2_ER_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_SetPriority(DMA1_Stream7_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_SetPriority(DMA1_Stream2_IRQn, I2C_IRQ_PRIORITY);
+        NVIC_EnableIRQ(I2C2_EV_IRQn);
+        NVIC_EnableIRQ(I2C2_ER_IRQn);
+        NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+        NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+    }
+}
+
+// resets the peripheral and sets the bus timing, see i2ctiming.h
+void I2C::i2c_configure()
+{
     _i2c->CR1=I2C_CR1_SWRST;
     _i2c->CR1&=~I2C_CR1_SWRST;	
-    _i2c->CR2|=50;
-    _i2c->CCR|=0x2|(1<<15)|(1<<14); 
-    _i2c->TRISE=20; //output max rise 
+    _i2c->CR2|=_timing.Freq;
+    _i2c->CCR|=_timing.Ccr;
+    _i2c->TRISE=_timing.Trise; //output max rise 
     _i2c->CR1|=I2C_CR1_PE;
 }
 
+/******************************************************************************
+ * Queues a request.  Starts it straight away if the bus is idle, otherwise   *
+ * it runs when the requests ahead of it are done: high priority ones in      *
+ * order ahead of all low ones.  Safe from interrupt context, so a completion *
+ * callback can queue the next transfer.                                      *
+ * -------------------------------------------------------------------------- *
+ * @return false if the queue is full (the request is not touched)           *
+ ******************************************************************************/
+bool I2C::i2c_Submit(I2C_REQUEST_t* request){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t p = (request->Priority == I2C_PRIO_HIGH) ? I2C_PRIO_HIGH : I2C_PRIO_LOW;
+    uint8_t next = (_queueTail[p] + 1) % I2C_QUEUE_SIZE;
+    if (next == _queueHead[p]){
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    request->Status = I2C_REQ_PENDING;
+    request->Queued = CYCLES_Now();
+    _queue[p][_queueTail[p]] = request;
+    _queueTail[p] = next;
+
+    if (_state == I2C_STATE_IDLE){
+        i2c_startNext();
+    }
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
+bool I2C::i2c_IsBusy(){
+    i2c_Service();
+    return _state != I2C_STATE_IDLE || _suspended != 0 ||
+           _queueHead[I2C_PRIO_HIGH] != _queueTail[I2C_PRIO_HIGH] ||
+           _queueHead[I2C_PRIO_LOW] != _queueTail[I2C_PRIO_LOW];
+}
+
+/******************************************************************************
+ * A transfer stuck waiting for a flag that never comes (device holding SDA, *
+ * lost interrupt) gets no interrupt to end it, so whoever waits on the bus  *
+ * calls this: past the phase deadline the transfer is dropped with          *
+ * I2C_REQ_TIMEOUT, the bus is recovered and the queue moves on.             *
+ ******************************************************************************/
+void I2C::i2c_Service(){
+    if (_state == I2C_STATE_IDLE || !i2c_expired()){
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (_state != I2C_STATE_IDLE && i2c_expired()){
+        _stats.Timeouts++;
+        i2c_abort(I2C_REQ_TIMEOUT);
+    }
+    __set_PRIMASK(primask);
+}
+
+/* Submits a request and spins until it is done, the spin counts as bus wait */
+uint8_t I2C::i2c_transfer(I2C_REQUEST_t* request){
+    uint32_t start = CYCLES_Now();
+
+    while (!i2c_Submit(request)){       /* queue full, wait for a slot */
+        i2c_Service();
+    }
+    while (request->Status == I2C_REQ_PENDING){
+        i2c_Service();
+    }
+
+    /* the interrupts update the counters too */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _stats.WaitCycles += CYCLES_Now() - start;
+    __set_PRIMASK(primask);
+    return request->Status;
+}
+
 char I2C::i2c_readByte(char saddr,char maddr, char *data)
 {
+    return i2c_readMulti(saddr, maddr, data, 1);
+}
+
+/******************************************************************************
+ * Reads length bytes from consecutive registers in one transaction, e.g. a   *
+ * sensor's whole data block.  Long reads go through the RX DMA.  High         *
+ * priority: it waits for at most one chunk of a display flush.               *
+ ******************************************************************************/
+char I2C::i2c_readMulti(char saddr,char maddr,char *buffer, uint16_t length)
+{
+    I2C_REQUEST_t request = {0};
+    request.Priority = I2C_PRIO_HIGH;
+    request.Saddr = saddr;
+    request.Reg = (uint8_t)maddr;
+    request.RegLen = 1;
+    request.Dir = I2C_DIR_READ;
+    request.Buffer = buffer;
+    request.Length = length;
+    return i2c_transfer(&request);      /* 0 when the bytes were read */
+}
+
+char I2C::i2c_writeByte(char saddr,char maddr,char data){
+    return i2c_WriteMultiStrided(saddr, maddr, &data, 1, 1, 0);
+}
+
+char I2C::i2c_WriteMulti(char saddr,char maddr,const char *buffer, uint16_t length){
+    return i2c_WriteMultiStrided(saddr, maddr, buffer, length, 1, 0);
+}
+
+/******************************************************************************
+ * Writes rows of length bytes, stride bytes apart in memory, as one          *
+ * transaction.  Lets a window of a larger buffer go out in a single burst.   *
+ * splittable lets high priority requests cut in between chunks, see         *
+ * I2C_REQUEST_t for the devices that allows.                                 *
+ ******************************************************************************/
+char I2C::i2c_WriteMultiStrided(char saddr,char maddr,const char *buffer, uint16_t length, uint8_t rows, uint16_t stride, bool splittable){
+    I2C_REQUEST_t request = {0};
+    request.Saddr = saddr;
+    request.Reg = (uint8_t)maddr;
+    request.RegLen = 1;
+    request.Dir = I2C_DIR_WRITE;
+    request.Buffer = (char*)buffer;     /* only read from */
+    request.Length = length;
+    request.Rows = rows;
+    request.Stride = stride;
+    request.Splittable = splittable;
+    return i2c_transfer(&request);
+}
+
+/******************************************************************************
+ * Background write through the object's own request.  Returns straight away, *
+ * the callback runs in interrupt context once the STOP has been issued.      *
+ * -------------------------------------------------------------------------- *
+ * @return false if the previous one is still queued (nothing is started)    *
+ ******************************************************************************/
+bool I2C::i2c_WriteMultiDMA(char saddr, char maddr, char *buffer, uint16_t length, I2C_Callback callback, void* context){
+    if (_dmaRequest.Status == I2C_REQ_PENDING || length == 0){
+        return false;
+    }
+
+    _dmaRequest.Saddr = saddr;
+    _dmaRequest.Reg = (uint8_t)maddr;
+    _dmaRequest.RegLen = 1;
+    _dmaRequest.Dir = I2C_DIR_WRITE;
+    _dmaRequest.Buffer = buffer;
+    _dmaRequest.Length = length;
+    _dmaRequest.Rows = 1;
+    _dmaRequest.Stride = 0;
+    _dmaRequest.Priority = I2C_PRIO_LOW;
+    _dmaRequest.Splittable = false;
+    _dmaRequest.Callback = callback;
+    _dmaRequest.Context = context;
+    return i2c_Submit(&_dmaRequest);
+}
+
+/******************************************************************************
+ * Background burst read through the object's own request.  Returns straight  *
+ * away, the callback runs in interrupt context once buffer is filled.        *
+ * -------------------------------------------------------------------------- *
+ * @return false if the previous one is still queued (nothing is started)    *
+ ******************************************************************************/
+bool I2C::i2c_ReadMultiDMA(char saddr, char maddr, char *buffer, uint16_t length, I2C_Callback callback, void* context){
+    if (_dmaReadRequest.Status == I2C_REQ_PENDING || length == 0){
+        return false;
+    }
+
+    _dmaReadRequest.Saddr = saddr;
+    _dmaReadRequest.Reg = (uint8_t)maddr;
+    _dmaReadRequest.RegLen = 1;
+    _dmaReadRequest.Dir = I2C_DIR_READ;
+    _dmaReadRequest.Buffer = buffer;
+    _dmaReadRequest.Length = length;
+    _dmaReadRequest.Rows = 1;
+    _dmaReadRequest.Stride = 0;
+    _dmaReadRequest.Priority = I2C_PRIO_HIGH;
+    _dmaReadRequest.Splittable = false;
+    _dmaReadRequest.Callback = callback;
+    _dmaReadRequest.Context = context;
+    return i2c_Submit(&_dmaReadRequest);
+}
+
+uint16_t I2C::i2c_GetChunkBytes(){
+    return _chunkBytes;
+}
+
+I2C_STATS_t I2C::i2c_GetStats(){
+    return _stats;
+}
+
+void I2C::i2c_ResetStats(){
+    _stats.Transactions = 0;
+    _stats.Bytes = 0;
+    _stats.WaitCycles = 0;
+    _stats.Nacks = 0;
+    _stats.ArbitrationLost = 0;
+    _stats.BusErrors = 0;
+    _stats.Timeouts = 0;
+    _stats.Recoveries = 0;
+    _stats.HighRequests = 0;
+    _stats.HighWaitWorst = 0;
+    _stats.HighLate = 0;
+    _stats.Preemptions = 0;
+}
+
+/******************************************************************************
+ * Transaction engine.  Each phase is started here or in the event interrupt *
+ * and finished by the next flag:                                             *
+ *                                                                            *
+ *   START -SB-> ADDRESS -ADDR-> REGISTER -TXE-> (register bytes)             *
+ *     write: DATA (DMA, one stream run per row) -TC-> LASTBYTE -BTF-> STOP   *
+ *     read:  RESTART -BTF-> READSTART -SB-> READADDR -ADDR-> (see below)     *
+ *                                                                            *
+ * Reads with no register bytes go straight to READSTART.  The end of a read  *
+ * follows RM0383 18.3.3 so the NACK and STOP land on the right byte however  *
+ * late the interrupt is served:                                              *
+ *   1 byte:   NACK + STOP at ADDR, READ -RXNE->                              *
+ *   2 bytes:  NACK + POS at ADDR, READLAST -BTF-> STOP, read both            *
+ *   N bytes:  READ -RXNE-> ... until 3 are left, READTAIL -BTF-> NACK, read  *
+ *             N-2, READLAST -BTF-> STOP, read the last two                   *
+ *   DMA:      READDMA (LAST NACKs the final byte) -TC-> STOP                 *
+ *                                                                            *
+ * A splittable low write goes out in chunks; at a chunk's TC with a high     *
+ * request queued it takes YIELD -BTF-> STOP and is suspended, to be resumed  *
+ * (register bytes again, then the rest) once the high queue is empty.        *
+ ******************************************************************************/
+void I2C::i2c_startNext(){
+    bool resume = false;
+
+    if (_queueHead[I2C_PRIO_HIGH] != _queueTail[I2C_PRIO_HIGH]){
+        _current = _queue[I2C_PRIO_HIGH][_queueHead[I2C_PRIO_HIGH]];
+        _queueHead[I2C_PRIO_HIGH] = (_queueHead[I2C_PRIO_HIGH] + 1) % I2C_QUEUE_SIZE;
+    } else if (_suspended){
+        _current = _suspended;
+        _suspended = 0;
+        resume = true;
+    } else if (_queueHead[I2C_PRIO_LOW] != _queueTail[I2C_PRIO_LOW]){
+        _current = _queue[I2C_PRIO_LOW][_queueHead[I2C_PRIO_LOW]];
+        _queueHead[I2C_PRIO_LOW] = (_queueHead[I2C_PRIO_LOW] + 1) % I2C_QUEUE_SIZE;
+    } else {
+        _current = 0;
+        _state = I2C_STATE_IDLE;
+        return;
+    }
+
+    _regLeft = _current->RegLen;
+    _left = _current->Length;
+    if (resume){
+        _rowsLeft = _suspendRows;
+        _rowOffset = _suspendOffset;
+        _data = _suspendData;
+    } else {
+        _rowsLeft = _current->Rows ? _current->Rows : 1;
+        _rowOffset = 0;
+        _data = _current->Buffer;
+    }
+
+    // a STOP just issued is still on the wire for up to a bit time
+    uint32_t start = CYCLES_Now();
+    i2c_arm(1);
+    while (_i2c->CR1 & I2C_CR1_STOP){
+        if (i2c_expired()){
+            _stats.Timeouts++;
+            i2c_recover();
+            break;
+        }
+    }
+    _stats.WaitCycles += CYCLES_Now() - start;
+
+    if (_current->Priority == I2C_PRIO_HIGH){
+        uint32_t waited = CYCLES_Now() - _current->Queued;
+        _stats.HighRequests++;
+        if (waited > _stats.HighWaitWorst){
+            _stats.HighWaitWorst = waited;
+        }
+        if (waited > _highWaitCycles){
+            _stats.HighLate++;
+        }
+    }
+
+    _stats.Transactions++;
+    _stats.Bytes += _current->RegLen;
+#ifdef I2C_TRACE
+    if (!resume){
+        _traceStart = CYCLES_Now();
+    }
+#endif
+    if (_current->Dir == I2C_DIR_READ && _current->RegLen == 0){
+        _state = I2C_STATE_READSTART;
+    } else {
+        _state = I2C_STATE_START;
+    }
+    i2c_arm(1 + _current->RegLen);      /* address and register bytes */
+    _i2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    _i2c->CR1 |= I2C_CR1_START;
+}
+
+/******************************************************************************
+ * ADDR is set for the read address and SCL is held until it is cleared, so   *
+ * ACK, POS and the DMA are all set up before the first byte can arrive.      *
+ ******************************************************************************/
+void I2C::i2c_startRead(){
     volatile int tmp;
-    while(_i2c->SR2&I2C_SR2_BUSY){;}
-    _i2c->CR1|=I2C_CR1_START;
-    while(!(_i2c->SR1&I2C_SR1_SB)){;}
-    _i2c->DR=saddr<<1;
-    while(!(_i2c->SR1&I2C_SR1_ADDR)){;}
-    tmp=_i2c->SR2;
-    while(!(_i2c->SR1&I2C_SR1_TXE)){;}
-    _i2c->DR=maddr;
-    while(!(_i2c->SR1&I2C_SR1_TXE)){;}
-    _i2c->CR1|=I2C_CR1_START;
-    while(!(_i2c->SR1&I2C_SR1_SB)){;}	
-    _i2c->DR=saddr<<1|1;
-    while(!(_i2c->SR1&I2C_SR1_ADDR)){;}
-    _i2c->CR1&=~I2C_CR1_ACK;
-    tmp =_i2c->SR2;
+
+    i2c_arm(_left);
+    if (_left >= 2 && _left >= I2C_READ_DMA_MIN){
+        i2c_startReadDMA();
+        return;
+    }
+
+    if (_left <= 1){
+        _i2c->CR1 &= ~I2C_CR1_ACK;          /* NACK the only byte */
+        tmp = _i2c->SR2;                    /* clear ADDR */
+        _i2c->CR1 |= I2C_CR1_STOP;
+        if (_left == 0){
+            i2c_finish(I2C_REQ_DONE);
+            return;
+        }
+        _state = I2C_STATE_READ;
+        _i2c->CR2 |= I2C_CR2_ITBUFEN;
+    } else if (_left == 2){
+        // ACK then NACK: POS makes the cleared ACK apply to the second byte
+        _i2c->CR1 = (_i2c->CR1 & ~I2C_CR1_ACK) | I2C_CR1_POS;
+        tmp = _i2c->SR2;
+        _state = I2C_STATE_READLAST;
+    } else {
+        _i2c->CR1 |= I2C_CR1_ACK;
+        tmp = _i2c->SR2;
+        if (_left == 3){
+            _state = I2C_STATE_READTAIL;
+        } else {
+            _state = I2C_STATE_READ;
+            _i2c->CR2 |= I2C_CR2_ITBUFEN;
+        }
+    }
     if (tmp==0){}
-    _i2c->CR1|=I2C_CR1_STOP;
-    while(!(_i2c->SR1&I2C_SR1_RXNE)){;}
-    *data++=_i2c->DR;
-    return 0;
 }
 
-void I2C::i2c_writeByte(char saddr,char maddr,char data){
+// peripheral to memory, byte wide; LAST makes the master NACK the final byte
+void I2C::i2c_startReadDMA(){
     volatile int tmp;
-    while(_i2c->SR2&I2C_SR2_BUSY){;}    /* wait until bus not busy */
-    _i2c->CR1|=I2C_CR1_START;           /* generate start */
-    while(!(_i2c->SR1&I2C_SR1_SB)){;}   /* wait until start bit is set */
-    _i2c->DR = saddr<< 1;               /* Send slave address */
-    while(!(_i2c->SR1&I2C_SR1_ADDR)){;} /* wait until address flag is set */
-    tmp = _i2c->SR2;                    /* clear SR2 by reading it */
-    if (tmp==0){}
-    while(!(_i2c->SR1&I2C_SR1_TXE)){;}  /* Wait until Data register empty */
-    _i2c->DR = maddr;                   /* send memory address */
-    while(!(_i2c->SR1&I2C_SR1_TXE)){;}  /* wait until data register empty */
-    _i2c->DR = data; 	
-    while (!(_i2c->SR1 & I2C_SR1_BTF)); /* wait until transfer finished */
-    _i2c->CR1 |=I2C_CR1_STOP;		    /* Generate Stop */	
-}
-
-void I2C::i2c_WriteMulti(char saddr,char maddr,char *buffer, uint8_t length){
-    while (_i2c->SR2 & I2C_SR2_BUSY); //wait until bus not busy
-    _i2c->CR1 |= I2C_CR1_START; //generate start
-    while (!(_i2c->SR1 & I2C_SR1_SB)){;} //wait until start is generated
-    volatile int tmp;														
-    _i2c->DR = saddr<< 1; // Send slave address
-    while (!(_i2c->SR1 & I2C_SR1_ADDR)){;} //wait until address flag is set
-    tmp = _i2c->SR2; //Clear SR2
+
+    _i2c->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+
+    _dmaRx->CR &= ~DMA_SxCR_EN;
+    while ((_dmaRx->CR & DMA_SxCR_EN) && !i2c_expired()){;}
+    DMA1->LIFCR = DMA_FLAG_ALL << _dmaRxFlagShift;
+    _dmaRx->PAR = (uint32_t)(uintptr_t)&_i2c->DR;
+    _dmaRx->M0AR = (uint32_t)(uintptr_t)_data;
+    _dmaRx->NDTR = _left;
+    _dmaRx->CR = (_dmaRxChannel << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_PL_1 | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    _dmaRx->CR |= DMA_SxCR_EN;
+
+    _state = I2C_STATE_READDMA;
+    _i2c->CR1 |= I2C_CR1_ACK;
+    _i2c->CR2 |= I2C_CR2_LAST | I2C_CR2_DMAEN;
+    tmp = _i2c->SR2;                        /* clear ADDR, bytes start */
     if (tmp==0){}
-    while (!(_i2c->SR1 & I2C_SR1_TXE)); //Wait until Data register empty
-    _i2c->DR = maddr; // send memory address
-    while (!(_i2c->SR1 & I2C_SR1_TXE)); //wait until data register empty
-
-    //sending the data
-    for (uint8_t i=0;i<length;i++)
-    { 
-        _i2c->DR=buffer[i]; //filling buffer with command or data
-        while (!(_i2c->SR1 & I2C_SR1_BTF));
-    }	
-                                
-    _i2c->CR1 |= I2C_CR1_STOP; //wait until transfer finished
-}
\ No newline at end of file
+}
+
+// register bytes are out (or there were none): hand the payload to the DMA
+void I2C::i2c_startData(){
+    _i2c->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+
+    if (_current->Length == 0){
+        // nothing more to send, STOP once the last byte has gone
+        _state = I2C_STATE_LASTBYTE;
+        _i2c->CR2 |= I2C_CR2_ITEVTEN;
+        return;
+    }
+
+    // memory to peripheral, byte wide, first run
+    _dmaTx->CR &= ~DMA_SxCR_EN;
+    while ((_dmaTx->CR & DMA_SxCR_EN) && !i2c_expired()){;}
+    DMA1->HIFCR = DMA_FLAG_ALL << _dmaTxFlagShift;
+    _dmaTx->PAR = (uint32_t)(uintptr_t)&_i2c->DR;
+    _dmaTx->CR = (_dmaTxChannel << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_PL_1 | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    i2c_loadPiece();
+
+    _state = I2C_STATE_DATA;
+    _i2c->CR2 |= I2C_CR2_DMAEN;
+    _dmaTx->CR |= DMA_SxCR_EN;
+}
+
+void I2C::i2c_EventIRQHandler(){
+    volatile int tmp;
+    uint32_t sr1 = _i2c->SR1;
+
+    switch (_state){
+        case I2C_STATE_START:
+            if (sr1 & I2C_SR1_SB){
+                _i2c->DR = _current->Saddr << 1;    /* Send slave address (write) */
+                _state = I2C_STATE_ADDRESS;
+            }
+            break;
+
+        case I2C_STATE_ADDRESS:
+            if (sr1 & I2C_SR1_ADDR){
+                tmp = _i2c->SR2;                    /* clear ADDR by reading SR2 */
+                if (tmp==0){}
+                _state = I2C_STATE_REGISTER;
+                _i2c->CR2 |= I2C_CR2_ITBUFEN;       /* TXE is set, feed it */
+            }
+            break;
+
+        case I2C_STATE_REGISTER:
+            if (!(sr1 & I2C_SR1_TXE)){
+                break;
+            }
+            if (_regLeft > 0){
+                _regLeft--;
+                _i2c->DR = (_current->Reg >> (8 * _regLeft)) & 0xFF;
+            } else if (_current->Dir == I2C_DIR_WRITE){
+                i2c_startData();
+            } else {
+                // repeated START once the register has left the shift register
+                _i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+                _state = I2C_STATE_RESTART;
+            }
+            break;
+
+        case I2C_STATE_RESTART:
+            if (sr1 & I2C_SR1_BTF){
+                _state = I2C_STATE_READSTART;
+                i2c_arm(1);
+                _i2c->CR1 |= I2C_CR1_START;
+            }
+            break;
+
+        case I2C_STATE_READSTART:
+            if (sr1 & I2C_SR1_SB){
+                _i2c->DR = _current->Saddr << 1 | 1; /* Send slave address (read) */
+                _state = I2C_STATE_READADDR;
+            }
+            break;
+
+        case I2C_STATE_READADDR:
+            if (sr1 & I2C_SR1_ADDR){
+                i2c_startRead();
+            }
+            break;
+
+        case I2C_STATE_READ:
+            if (sr1 & I2C_SR1_RXNE){
+                *_data++ = _i2c->DR;
+                _left--;
+                _stats.Bytes++;
+                if (_left == 0){
+                    i2c_finish(I2C_REQ_DONE);   /* the single byte read */
+                } else if (_left == 3){
+                    // let the last three stack up in DR and the shift register
+                    _i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+                    _state = I2C_STATE_READTAIL;
+                }
+            }
+            break;
+
+        case I2C_STATE_READTAIL:
+            if (sr1 & I2C_SR1_BTF){
+                _i2c->CR1 &= ~I2C_CR1_ACK;      /* NACK byte N, now coming in */
+                *_data++ = _i2c->DR;
+                _left--;
+                _stats.Bytes++;
+                _state = I2C_STATE_READLAST;
+            }
+            break;
+
+        case I2C_STATE_READLAST:
+            if (sr1 & I2C_SR1_BTF){
+                _i2c->CR1 = (_i2c->CR1 & ~I2C_CR1_POS) | I2C_CR1_STOP;
+                *_data++ = _i2c->DR;
+                *_data++ = _i2c->DR;
+                _left -= 2;
+                _stats.Bytes += 2;
+                i2c_finish(I2C_REQ_DONE);
+            }
+            break;
+
+        case I2C_STATE_LASTBYTE:
+            if (sr1 & I2C_SR1_BTF){
+                _i2c->CR1 |= I2C_CR1_STOP;
+                i2c_finish(I2C_REQ_DONE);
+            }
+            break;
+
+        case I2C_STATE_YIELD:
+            if (sr1 & I2C_SR1_BTF){
+                _i2c->CR1 |= I2C_CR1_STOP;
+                i2c_suspend();
+            }
+            break;
+
+        default:
+            // not ours, stop listening
+            _i2c->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+            break;
+    }
+}
+
+void I2C::i2c_ErrorIRQHandler(){
+    uint32_t sr1 = _i2c->SR1;
+    _i2c->SR1 &= ~(I2C_SR1_AF | I2C_SR1_ARLO | I2C_SR1_BERR | I2C_SR1_OVR);
+
+    if (sr1 & I2C_SR1_AF) _stats.Nacks++;
+    if (sr1 & I2C_SR1_ARLO) _stats.ArbitrationLost++;
+    if (sr1 & (I2C_SR1_BERR | I2C_SR1_OVR)) _stats.BusErrors++;
+
+    if (_state == I2C_STATE_IDLE){
+        return;
+    }
+
+    if (sr1 & (I2C_SR1_ARLO | I2C_SR1_BERR)){
+        // the bus itself is in doubt
+        i2c_abort(I2C_REQ_ERROR);
+    } else {
+        // NACK: the bus is fine, release it and move on
+        _dmaTx->CR &= ~DMA_SxCR_EN;
+        _dmaRx->CR &= ~DMA_SxCR_EN;
+        _i2c->CR1 |= I2C_CR1_STOP;
+        i2c_finish(I2C_REQ_ERROR);
+    }
+}
+
+void I2C::i2c_DMATxIRQHandler(){
+    uint32_t flags = (DMA1->HISR >> _dmaTxFlagShift) & DMA_FLAG_ALL;
+    DMA1->HIFCR = DMA_FLAG_ALL << _dmaTxFlagShift;
+
+    if (flags & DMA_FLAG_TEIF){
+        _stats.BusErrors++;
+        i2c_abort(I2C_REQ_ERROR);
+        return;
+    }
+
+    if (flags & DMA_FLAG_TCIF){
+        _stats.Bytes += _piece;
+        _rowOffset += _piece;
+        if (_rowOffset >= _current->Length){
+            _rowOffset = 0;
+            _rowsLeft--;
+            _data += _current->Stride;
+        }
+
+        if (_rowsLeft > 0){
+            if (i2c_mayYield()){
+                // let the chunk's last byte out, then STOP for the high request
+                _i2c->CR2 &= ~I2C_CR2_DMAEN;
+                _state = I2C_STATE_YIELD;
+                i2c_arm(1);
+                _i2c->CR2 |= I2C_CR2_ITEVTEN;
+                return;
+            }
+            // next run: the master stretches SCL until the stream feeds DR again
+            i2c_loadPiece();
+            _dmaTx->CR |= DMA_SxCR_EN;
+            return;
+        }
+
+        // last byte is still shifting out, STOP once BTF is set
+        _i2c->CR2 &= ~I2C_CR2_DMAEN;
+        _state = I2C_STATE_LASTBYTE;
+        i2c_arm(1);
+        _i2c->CR2 |= I2C_CR2_ITEVTEN;
+    }
+}
+
+void I2C::i2c_DMARxIRQHandler(){
+    uint32_t flags = (DMA1->LISR >> _dmaRxFlagShift) & DMA_FLAG_ALL;
+    DMA1->LIFCR = DMA_FLAG_ALL << _dmaRxFlagShift;
+
+    if (flags & DMA_FLAG_TEIF){
+        _stats.BusErrors++;
+        i2c_abort(I2C_REQ_ERROR);
+        return;
+    }
+
+    if ((flags & DMA_FLAG_TCIF) && _state == I2C_STATE_READDMA){
+        // final byte is in and NACKed
+        _i2c->CR1 |= I2C_CR1_STOP;
+        _stats.Bytes += _current->Length;
+        i2c_finish(I2C_REQ_DONE);
+    }
+}
+
+/* points the TX stream at the next run: the rest of the row, or one chunk */
+void I2C::i2c_loadPiece(){
+    uint16_t piece = _current->Length - _rowOffset;
+
+    if (_current->Splittable && _current->Priority == I2C_PRIO_LOW && piece > _chunkBytes){
+        piece = _chunkBytes;
+    }
+    _piece = piece;
+    _dmaTx->M0AR = (uint32_t)(uintptr_t)(_data + _rowOffset);
+    _dmaTx->NDTR = piece;
+    i2c_arm(piece);
+}
+
+// at a chunk boundary of a splittable write, with a high request waiting
+bool I2C::i2c_mayYield(){
+    return _current->Splittable && _current->Priority == I2C_PRIO_LOW &&
+           _queueHead[I2C_PRIO_HIGH] != _queueTail[I2C_PRIO_HIGH];
+}
+
+// STOP is issued: park the write where it got to and run the high queue
+void I2C::i2c_suspend(){
+    _i2c->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN | I2C_CR2_DMAEN);
+    _state = I2C_STATE_IDLE;
+
+    _suspendRows = _rowsLeft;
+    _suspendOffset = _rowOffset;
+    _suspendData = _data;
+    _suspended = _current;
+    _stats.Preemptions++;
+
+    i2c_startNext();
+}
+
+/******************************************************************************
+ * Ends the transaction on the wire and starts the next queued one before    *
+ * the callback runs, so a callback that queues more work just joins the     *
+ * back of the queue.                                                         *
+ ******************************************************************************/
+void I2C::i2c_finish(uint8_t status){
+    I2C_REQUEST_t* request = _current;
+
+    _i2c->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN | I2C_CR2_DMAEN | I2C_CR2_LAST);
+
+#ifdef I2C_TRACE
+    // still busy: a request the hook submits is queued, not started under us
+    i2c_traceRecord(status);
+#endif
+    _state = I2C_STATE_IDLE;
+
+    I2C_Callback callback = request->Callback;
+    void* context = request->Context;
+    request->Status = status;
+
+    i2c_startNext();
+    if (callback){
+        callback(context);
+    }
+}
+
+#ifdef I2C_TRACE
+// logs the transaction ending now, before its status is published
+void I2C::i2c_traceRecord(uint8_t status){
+    I2C_TRACE_t* entry = &_trace[_traceCount % I2C_TRACE_SIZE];
+    uint8_t rows = _current->Rows ? _current->Rows : 1;
+
+    entry->Start = _traceStart;
+    entry->Cycles = CYCLES_Now() - _traceStart;
+    entry->Saddr = _current->Saddr;
+    entry->Dir = _current->Dir;
+    entry->Reg = _current->Reg;
+    entry->RegLen = _current->RegLen;
+    entry->Status = status;
+    entry->Length = (_current->Dir == I2C_DIR_READ) ? _current->Length : _current->Length * rows;
+    for (uint8_t i = 0; i < I2C_TRACE_PAYLOAD; i++){
+        entry->Payload[i] = (i < _current->Length) ? _current->Buffer[i] : 0;
+    }
+    _traceCount++;
+
+    if (_traceHook){
+        _traceHook(entry, _current, _traceContext);
+    }
+}
+
+uint32_t I2C::i2c_TraceCount(){
+    return _traceCount;
+}
+
+bool I2C::i2c_TraceGet(uint32_t number, I2C_TRACE_t* entry){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    bool held = number < _traceCount && _traceCount - number <= I2C_TRACE_SIZE;
+    if (held){
+        *entry = _trace[number % I2C_TRACE_SIZE];
+    }
+
+    __set_PRIMASK(primask);
+    return held;
+}
+
+void I2C::i2c_TraceClear(){
+    _traceCount = 0;
+}
+
+void I2C::i2c_SetTraceHook(I2C_TraceHook hook, void* context){
+    _traceContext = context;
+    _traceHook = hook;
+}
+#endif
+
+// ends a transfer the bus can not be trusted after: recover, then move on
+void I2C::i2c_abort(uint8_t status){
+    _i2c->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN | I2C_CR2_DMAEN | I2C_CR2_LAST);
+    _dmaTx->CR &= ~DMA_SxCR_EN;
+    _dmaRx->CR &= ~DMA_SxCR_EN;
+    i2c_recover();
+    i2c_finish(status);
+}
+
+/******************************************************************************
+ * Bus recovery: with the pins taken over as open drain GPIO, clock SCL up   *
+ * to 9 times until a slave stuck mid-byte lets go of SDA, send a STOP by    *
+ * hand, then hand the pins back and reset the peripheral (SWRST).           *
+ * Bounded: 10 SCL periods at ~100 kHz.                                       *
+ ******************************************************************************/
+void I2C::i2c_recover(){
+    uint32_t scl = 1UL << _sclIndex;
+    uint32_t sda = 1UL << _sdaIndex;
+    uint32_t outputs = (1UL << (2 * _sclIndex)) | (1UL << (2 * _sdaIndex));
+    uint32_t modes = (3UL << (2 * _sclIndex)) | (3UL << (2 * _sdaIndex));
+    volatile uint32_t wait;
+    uint32_t halfPeriod = SystemCoreClock / 1000000 * 5 / 4;   /* ~5 us of loop */
+
+    _stats.Recoveries++;
+    _i2c->CR1 &= ~I2C_CR1_PE;
+
+    GPIOB->BSRR = scl | sda;            /* released (open drain high) */
+    GPIOB->MODER = (GPIOB->MODER & ~modes) | outputs;
+
+    for (uint8_t i = 0; i < 9 && !(GPIOB->IDR & sda); i++){
+        GPIOB->BSRR = scl << 16;        /* SCL low */
+        for (wait = halfPeriod; wait > 0; wait--){;}
+        GPIOB->BSRR = scl;              /* SCL high */
+        for (wait = halfPeriod; wait > 0; wait--){;}
+    }
+
+    // STOP: SDA low to high while SCL is high
+    GPIOB->BSRR = scl << 16;
+    for (wait = halfPeriod; wait > 0; wait--){;}
+    GPIOB->BSRR = sda << 16;
+    for (wait = halfPeriod; wait > 0; wait--){;}
+    GPIOB->BSRR = scl;
+    for (wait = halfPeriod; wait > 0; wait--){;}
+    GPIOB->BSRR = sda;
+    for (wait = halfPeriod; wait > 0; wait--){;}
+
+    GPIOB->MODER = (GPIOB->MODER & ~modes) | (outputs << 1);   /* back to AF */
+    i2c_configure();
+}
+
+// gives the phase starting now time for 'bytes' bytes, twice over, plus the slack
+void I2C::i2c_arm(uint16_t bytes){
+    _deadline = CYCLES_Now() + _slackCycles + 2 * _byteCycles * bytes;
+}
+
+bool I2C::i2c_expired(){
+    return (int32_t)(CYCLES_Now() - _deadline) > 0;
+}
+
+/******************************************************************************
+ * Interrupt vectors                                                          *
+ ******************************************************************************/
+extern "C" void I2C1_EV_IRQHandler(void){
+    if (i2c_instances[0]) i2c_instances[0]->i2c_EventIRQHandler();
+}
+
+extern "C" void I2C1_ER_IRQHandler(void){
+    if (i2c_instances[0]) i2c_instances[0]->i2c_ErrorIRQHandler();
+}
+
+extern "C" void DMA1_Stream6_IRQHandler(void){
+    if (i2c_instances[0]) i2c_instances[0]->i2c_DMATxIRQHandler();
+}
+
+extern "C" void DMA1_Stream0_IRQHandler(void){
+    if (i2c_instances[0]) i2c_instances[0]->i2c_DMARxIRQHandler();
+}
+
+extern "C" void I2C2_EV_IRQHandler(void){
+    if (i2c_instances[1]) i2c_instances[1]->i2c_EventIRQHandler();
+}
+
+extern "C" void I2C2_ER_IRQHandler(void){
+    if (i2c_instances[1]) i2c_instances[1]->i2c_ErrorIRQHandler();
+}
+
+extern "C" void DMA1_Stream7_IRQHandler(void){
+    if (i2c_instances[1]) i2c_instances[1]->i2c_DMATxIRQHandler();
+}
+
+extern "C" void DMA1_Stream2_IRQHandler(void){
+    if (i2c_instances[1]) i2c_instances[1]->i2c_DMARxIRQHandler();
+}
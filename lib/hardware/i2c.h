@@ -17,9 +17,158 @@ extern "C" {
 #endif
 
 #include "stm32f4xx.h"  // Device header
+#include "cycles.h"
+#include "i2ctiming.h"
+
+/* completion callback for queued transfers, runs in interrupt context */
+typedef void (*I2C_Callback)(void* context);
+
+/* transfer direction */
+#define I2C_DIR_WRITE       0
+#define I2C_DIR_READ        1
+
+/* request status */
+#define I2C_REQ_DONE        0
+#define I2C_REQ_PENDING     1
+#define I2C_REQ_ERROR       2   // NACK, arbitration lost, bus or DMA error
+#define I2C_REQ_TIMEOUT     3   // a phase overran its deadline, the bus was recovered
+
+/* every phase may take twice its bytes' wire time plus this before it is abandoned */
+#ifndef I2C_TIMEOUT_SLACK_US
+#define I2C_TIMEOUT_SLACK_US 500
+#endif
+
+/* reads of at least this many bytes go through the RX DMA, shorter ones are
+   taken a byte per interrupt */
+#ifndef I2C_READ_DMA_MIN
+#define I2C_READ_DMA_MIN    4
+#endif
+
+/* requests waiting behind the one on the wire, per priority */
+#ifndef I2C_QUEUE_SIZE
+#define I2C_QUEUE_SIZE      8
+#endif
+
+/* NVIC preemption priority of the event, error and DMA interrupts: below
+   the encoder edges and the control tick, a transfer waits out a tick */
+#ifndef I2C_IRQ_PRIORITY
+#define I2C_IRQ_PRIORITY    2
+#endif
+
+/* request priority: high requests (sensor reads) go ahead of every low one
+   and may cut into a splittable low write (display flush) between chunks */
+#define I2C_PRIO_LOW        0
+#define I2C_PRIO_HIGH       1
+#define I2C_PRIORITIES      2
+
+/* wait a high request should see at most, behind one chunk of a low write.
+   Splittable writes are cut into chunks that fit it, see i2c_init */
+#ifndef I2C_HIGH_WAIT_US
+#define I2C_HIGH_WAIT_US    500
+#endif
+
+/* byte times a high request can wait besides the chunk: START, address,
+   register, the last byte's BTF and the STOP, each rounded up to a byte */
+#define I2C_CHUNK_OVERHEAD  5
+
+/* engine states, one per phase of a transaction */
+#define I2C_STATE_IDLE      0
+#define I2C_STATE_START     1   // START sent, waiting for SB
+#define I2C_STATE_ADDRESS   2   // write address sent, waiting for ADDR
+#define I2C_STATE_REGISTER  3   // register bytes going out on TXE
+#define I2C_STATE_RESTART   4   // register sent, waiting for BTF to repeat START
+#define I2C_STATE_READSTART 5   // repeated START sent, waiting for SB
+#define I2C_STATE_READADDR  6   // read address sent, waiting for ADDR
+#define I2C_STATE_READ      7   // bytes arriving on RXNE
+#define I2C_STATE_DATA      8   // DMA streaming the payload
+#define I2C_STATE_LASTBYTE  9   // payload handed over, waiting for BTF before STOP
+#define I2C_STATE_READTAIL  10  // byte N-2 in DR, N-1 in the shift register: BTF, then NACK
+#define I2C_STATE_READLAST  11  // last two bytes in DR and shift register: BTF, then STOP
+#define I2C_STATE_READDMA   12  // RX DMA taking the bytes, LAST NACKs the final one
+#define I2C_STATE_YIELD     13  // chunk handed over, a high request waits: BTF, then STOP
+
+/******************************************************************************
+ * One transaction: [START addr+W] [register bytes] then either the payload   *
+ * written from Buffer, or [repeated START addr+R] and Length bytes read into *
+ * Buffer.  Writes may gather Rows rows of Length bytes, Stride bytes apart.  *
+ * The request and its buffer belong to the caller and must stay untouched    *
+ * until Status leaves I2C_REQ_PENDING (the callback runs just after).        *
+ *                                                                            *
+ * A Splittable low priority write may be cut at a chunk boundary, STOPped,   *
+ * and finished later in a new transaction that sends the register bytes      *
+ * again.  Only for devices where that continues the write, e.g. SSD1306 data *
+ * (control byte 0x40) which carries on at the GDDRAM pointer.                *
+ ******************************************************************************/
+typedef struct {
+    char Saddr;                 // 7 bit device address
+    uint16_t Reg;               // register / memory address, high byte first
+    uint8_t RegLen;             // 0, 1 or 2 register bytes
+    uint8_t Dir;                // I2C_DIR_WRITE or I2C_DIR_READ
+    char* Buffer;
+    uint16_t Length;            // bytes per row
+    uint8_t Rows;               // writes only, 0 is taken as 1
+    uint16_t Stride;
+    uint8_t Priority;           // I2C_PRIO_LOW (0) or I2C_PRIO_HIGH
+    bool Splittable;            // low priority writes only, see above
+    I2C_Callback Callback;      // optional
+    void* Context;
+    uint32_t Queued;            // CYCLES_Now() at submit, set by i2c_Submit
+    volatile uint8_t Status;
+} I2C_REQUEST_t;
+
+/* bus counters, see i2c_GetStats */
+typedef struct {
+    uint32_t Transactions;      // STARTs issued
+    uint32_t Bytes;             // bytes after the address (register + payload)
+    uint32_t WaitCycles;        // CPU cycles spent waiting for the bus
+    uint32_t Nacks;             // address or data not acknowledged
+    uint32_t ArbitrationLost;
+    uint32_t BusErrors;         // misplaced START/STOP, overrun, DMA error
+    uint32_t Timeouts;          // phases that overran their deadline
+    uint32_t Recoveries;        // SCL toggling + SWRST bus recoveries
+    uint32_t HighRequests;      // high priority requests started
+    uint32_t HighWaitWorst;     // longest submit to START of a high request, cycles
+    uint32_t HighLate;          // high requests that waited past I2C_HIGH_WAIT_US
+    uint32_t Preemptions;       // low writes cut to let a high request in
+} I2C_STATS_t;
+
+/******************************************************************************
+ * Transaction trace, compiled in with -D I2C_TRACE.  Every finished request  *
+ * is recorded in a ring of I2C_TRACE_SIZE entries with the first             *
+ * I2C_TRACE_PAYLOAD bytes of its data, and handed in full to an optional     *
+ * hook (interrupt context) so a host build can decode the whole stream,      *
+ * e.g. into an SSD1306Model.                                                 *
+ ******************************************************************************/
+#ifndef I2C_TRACE_SIZE
+#define I2C_TRACE_SIZE      32
+#endif
+
+#ifndef I2C_TRACE_PAYLOAD
+#define I2C_TRACE_PAYLOAD   8
+#endif
+
+typedef struct {
+    uint32_t Start;             // CYCLES_Now() at START
+    uint32_t Cycles;            // START to finish
+    char Saddr;
+    uint8_t Dir;
+    uint16_t Reg;
+    uint8_t RegLen;
+    uint8_t Status;             // I2C_REQ_DONE, _ERROR or _TIMEOUT
+    uint16_t Length;            // payload bytes, all rows
+    uint8_t Payload[I2C_TRACE_PAYLOAD];  // first bytes of the first row
+} I2C_TRACE_t;
+
+typedef void (*I2C_TraceHook)(const I2C_TRACE_t* entry, const I2C_REQUEST_t* request, void* context);
 
 /*!
 * @brief Generic I2C Library
+*
+* Transfers are queued and run from the event/error interrupts, so devices on
+* the same bus (e.g. the SSD1306 and the 24LC256 on the OLED-GYRO board) can
+* share one I2C object.  The blocking calls submit a request and wait for it.
+* Reads are queued high priority and writes low; a display flush is cut into
+* chunks so a sensor read waits about I2C_HIGH_WAIT_US at most for the bus.
 */
 class I2C {
 
@@ -27,17 +176,124 @@ private:
     uint16_t _i2cmodule;
     uint16_t _sclPin;
     uint16_t _sdaPin;
+    I2C_TIMING_t _timing;
+    uint8_t _sclIndex;          // port B pin numbers, for bus recovery
+    uint8_t _sdaIndex;
+    bool _initialised = false;
 
     I2C_TypeDef* _i2c;
 
+    // TX DMA stream serving this module (I2C1: DMA1 S6 CH1, I2C2: DMA1 S7 CH7)
+    DMA_Stream_TypeDef* _dmaTx;
+    uint32_t _dmaTxChannel;
+    uint8_t _dmaTxFlagShift;    // bit offset of the stream flags in DMA1 HISR/HIFCR
+
+    // RX DMA stream (I2C1: DMA1 S0 CH1, I2C2: DMA1 S2 CH7)
+    DMA_Stream_TypeDef* _dmaRx;
+    uint32_t _dmaRxChannel;
+    uint8_t _dmaRxFlagShift;    // bit offset of the stream flags in DMA1 LISR/LIFCR
+
+    // request queue per priority, _queueHead == _queueTail when empty
+    I2C_REQUEST_t* _queue[I2C_PRIORITIES][I2C_QUEUE_SIZE];
+    volatile uint8_t _queueHead[I2C_PRIORITIES];
+    volatile uint8_t _queueTail[I2C_PRIORITIES];
+
+    // low write cut for a high request, resumed before any other low one
+    I2C_REQUEST_t* volatile _suspended;
+    uint8_t _suspendRows;
+    uint16_t _suspendOffset;
+    char* _suspendData;
+
+    // transaction on the wire
+    volatile uint8_t _state = I2C_STATE_IDLE;
+    I2C_REQUEST_t* _current;
+    uint8_t _regLeft;
+    uint16_t _left;             // bytes still to read
+    uint8_t _rowsLeft;          // rows still to hand to the DMA
+    char* _data;                // next byte to read / row to write
+    uint16_t _rowOffset;        // bytes of the row already written
+    uint16_t _piece;            // bytes in the DMA run going out
+    uint16_t _chunkBytes;       // longest run of a splittable write
+    uint32_t _highWaitCycles;   // I2C_HIGH_WAIT_US in cycles
+    volatile uint32_t _deadline;  // cycle count the current phase must finish by
+    uint32_t _byteCycles;       // one byte (9 SCL clocks) on the wire
+    uint32_t _slackCycles;
+
+    // requests behind i2c_WriteMultiDMA and i2c_ReadMultiDMA
+    I2C_REQUEST_t _dmaRequest;
+    I2C_REQUEST_t _dmaReadRequest;
+
+    I2C_STATS_t _stats;
+
+#ifdef I2C_TRACE
+    I2C_TRACE_t _trace[I2C_TRACE_SIZE];
+    volatile uint32_t _traceCount;  // entries ever recorded, the ring keeps the newest
+    uint32_t _traceStart;
+    I2C_TraceHook _traceHook;
+    void* _traceContext;
+
+    void i2c_traceRecord(uint8_t status);
+#endif
+
+    void i2c_configure();
+    void i2c_startNext();
+    void i2c_startData();
+    void i2c_loadPiece();
+    bool i2c_mayYield();
+    void i2c_suspend();
+    void i2c_startRead();
+    void i2c_startReadDMA();
+    void i2c_finish(uint8_t status);
+    void i2c_abort(uint8_t status);
+    void i2c_recover();
+    void i2c_arm(uint16_t bytes);
+    bool i2c_expired();
+    uint8_t i2c_transfer(I2C_REQUEST_t* request);
+
 public:
     I2C();
-    I2C(uint16_t sdapin, uint16_t sclpin, uint16_t i2cmodule);
+    I2C(uint16_t sdapin, uint16_t sclpin, uint16_t i2cmodule, I2C_TIMING_t timing);
 
     void i2c_init();
+
+    // queued transfers
+    bool i2c_Submit(I2C_REQUEST_t* request);
+    bool i2c_IsBusy();          // also runs i2c_Service
+    void i2c_Service();         // abandons a transfer that has overrun its deadline
+
+    // blocking wrappers, not for interrupt context, return the request status
     char i2c_readByte(char saddr,char maddr,char *data);
-    void i2c_writeByte(char saddr,char maddr,char data);
-    void i2c_WriteMulti(char saddr,char maddr,char *buffer, uint8_t length);
+    char i2c_readMulti(char saddr,char maddr,char *buffer, uint16_t length);
+    char i2c_writeByte(char saddr,char maddr,char data);
+    char i2c_WriteMulti(char saddr,char maddr,const char *buffer, uint16_t length);
+    char i2c_WriteMultiStrided(char saddr,char maddr,const char *buffer, uint16_t length, uint8_t rows, uint16_t stride, bool splittable = false);
+
+    // background write through an internal request, false while it is still queued
+    bool i2c_WriteMultiDMA(char saddr, char maddr, char *buffer, uint16_t length, I2C_Callback callback, void* context);
+
+    // background burst read the same way, buffer is filled once the callback runs
+    bool i2c_ReadMultiDMA(char saddr, char maddr, char *buffer, uint16_t length, I2C_Callback callback, void* context);
+
+    // chunk size splittable writes are cut to, valid after i2c_init
+    uint16_t i2c_GetChunkBytes();
+
+    // counters since init or the last reset
+    I2C_STATS_t i2c_GetStats();
+    void i2c_ResetStats();
+
+#ifdef I2C_TRACE
+    // transaction trace, entries numbered from 0 = first ever recorded
+    uint32_t i2c_TraceCount();
+    bool i2c_TraceGet(uint32_t number, I2C_TRACE_t* entry);    // false once overwritten
+    void i2c_TraceClear();
+    void i2c_SetTraceHook(I2C_TraceHook hook, void* context);
+#endif
+
+    // called from the interrupt vectors in i2c.cpp
+    void i2c_EventIRQHandler();
+    void i2c_ErrorIRQHandler();
+    void i2c_DMATxIRQHandler();
+    void i2c_DMARxIRQHandler();
 };
 
 #ifdef __cplusplus
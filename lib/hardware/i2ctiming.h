@@ -0,0 +1,93 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * -------------------------------------------------------------------------- *
+ * I2C bus timing (CR2 FREQ, CCR with FS/DUTY, TRISE) worked out at compile   *
+ * time from the APB1 clock and the wanted SCL rate, following RM0383 18.6.   *
+ * I2C_TimingFor<pclk1, speed>::Value is the checked form: a combination the  *
+ * peripheral can not run fails the build.  There is no default, the caller   *
+ * passes the one for its clock tree, e.g.                                    *
+ *   I2C_TimingFor<CLOCK_PCLK1_HZ, I2C_SPEED_HZ>::Value                       *
+ * C++ only.                                                                  *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef I2C_TIMING_H
+#define I2C_TIMING_H
+
+#include <stdint.h>
+
+// C++ even when included from inside another header's extern "C" block
+extern "C++" {
+
+/* bus speed classes, the F411 I2C has no Fast-mode Plus (1 MHz) */
+#define I2C_TIMING_STANDARD_HZ  100000
+#define I2C_TIMING_FAST_HZ      400000
+#define I2C_TIMING_FASTPLUS_HZ  1000000
+
+/* CR2 FREQ limits in MHz, fast mode needs at least 4 MHz */
+#define I2C_TIMING_FREQ_MIN     2
+#define I2C_TIMING_FREQ_FAST    4
+#define I2C_TIMING_FREQ_MAX     50
+
+/* register values, written as they are */
+typedef struct {
+    uint8_t Freq;               // CR2 FREQ, PCLK1 in MHz
+    uint16_t Ccr;               // CCR including FS and DUTY
+    uint8_t Trise;              // TRISE, max rise time in PCLK1 cycles + 1
+    uint32_t SpeedHz;           // SCL rate these give, never above the one asked for
+} I2C_TIMING_t;
+
+/* CCR for 'perCcr' PCLK1 cycles per CCR count, rounded so SCL never runs fast */
+constexpr uint32_t I2C_TimingDivide(uint32_t pclk1Hz, uint32_t perCcr, uint32_t speedHz, uint32_t floor) {
+    uint32_t ccr = (pclk1Hz + perCcr * speedHz - 1) / (perCcr * speedHz);
+    return (ccr < floor) ? floor : ccr;
+}
+
+/******************************************************************************
+ * Standard mode: SCL high = low = CCR PCLK1 cycles, 1000 ns rise time.       *
+ * Fast mode: DUTY 0 gives low:high 2:1 (3 cycles per CCR), DUTY 1 gives 16:9 *
+ * (25 per CCR), whichever lands closer under the wanted rate; 300 ns rise.   *
+ ******************************************************************************/
+constexpr I2C_TIMING_t I2C_Timing(uint32_t pclk1Hz, uint32_t speedHz) {
+    uint8_t freq = pclk1Hz / 1000000;
+
+    if (speedHz <= I2C_TIMING_STANDARD_HZ) {
+        uint32_t ccr = I2C_TimingDivide(pclk1Hz, 2, speedHz, 4);
+        return I2C_TIMING_t{freq, (uint16_t)ccr, (uint8_t)(freq + 1), pclk1Hz / (2 * ccr)};
+    }
+
+    uint32_t ccr = I2C_TimingDivide(pclk1Hz, 3, speedHz, 1);
+    uint32_t ccrDuty = I2C_TimingDivide(pclk1Hz, 25, speedHz, 1);
+    uint8_t trise = freq * 300 / 1000 + 1;
+
+    if (pclk1Hz / (3 * ccr) >= pclk1Hz / (25 * ccrDuty)) {
+        return I2C_TIMING_t{freq, (uint16_t)((1 << 15) | ccr), trise, pclk1Hz / (3 * ccr)};
+    }
+    return I2C_TIMING_t{freq, (uint16_t)((1 << 15) | (1 << 14) | ccrDuty), trise, pclk1Hz / (25 * ccrDuty)};
+}
+
+template <uint32_t PCLK1_HZ, uint32_t SPEED_HZ>
+struct I2C_TimingFor {
+    static_assert(PCLK1_HZ % 1000000 == 0,
+                  "I2C: CR2 FREQ takes PCLK1 in whole MHz");
+    static_assert(PCLK1_HZ >= I2C_TIMING_FREQ_MIN * 1000000 && PCLK1_HZ <= I2C_TIMING_FREQ_MAX * 1000000,
+                  "I2C: PCLK1 must be 2 to 50 MHz");
+    static_assert(SPEED_HZ > 0 && SPEED_HZ <= I2C_TIMING_FAST_HZ,
+                  "I2C: the F411 peripheral stops at 400 kHz, it has no Fast-mode Plus");
+    static_assert(SPEED_HZ <= I2C_TIMING_STANDARD_HZ || PCLK1_HZ >= I2C_TIMING_FREQ_FAST * 1000000,
+                  "I2C: fast mode needs PCLK1 of at least 4 MHz");
+    static_assert(I2C_TimingDivide(PCLK1_HZ, 2, SPEED_HZ, 4) <= 0x0FFF,
+                  "I2C: SCL too slow for the 12 bit CCR");
+
+    static constexpr I2C_TIMING_t Value = I2C_Timing(PCLK1_HZ, SPEED_HZ);
+};
+
+}
+
+#endif // I2C_TIMING_H
@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ *****************************************************************************/
+#include "motor.h"
+
+/******************************************************************************
+ * Constructor, nothing touches the hardware until Init.                      *
+ * -------------------------------------------------------------------------- *
+ * @param timer         // TIM2-5, both inputs on the same timer              *
+ * @param channel1..    // IN1: timer channel 1-4, its pin and port           *
+ * @param channel2..    // IN2                                                *
+ * @param alternate     // GPIO_AFx_TIMy of the pins                          *
+ * @param reversed      // motor mounted the other way round                  *
+ *****************************************************************************/
+Motor::Motor(TIM_TypeDef* timer, uint8_t channel1, uint32_t pin1, GPIO_TypeDef* port1,
+             uint8_t channel2, uint32_t pin2, GPIO_TypeDef* port2, uint32_t alternate, bool reversed){
+    _timer = timer;
+    _channel1 = channel1;
+    _channel2 = channel2;
+    _ccr1 = &timer->CCR1 + (channel1 - 1);
+    _ccr2 = &timer->CCR1 + (channel2 - 1);
+    _pin1 = pin1;
+    _pin2 = pin2;
+    _port1 = port1;
+    _port2 = port2;
+    _alternate = alternate;
+    _reversed = reversed;
+
+    _period = 0;
+    _decay = MOTOR_DECAY_FAST;
+    _state = MOTOR_STATE_NONE;
+    _duty = 0;
+}
+
+void Motor::Init(MOTOR_PWM_t pwm){
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    if (_timer == TIM2) __HAL_RCC_TIM2_CLK_ENABLE();
+    if (_timer == TIM3) __HAL_RCC_TIM3_CLK_ENABLE();
+    if (_timer == TIM4) __HAL_RCC_TIM4_CLK_ENABLE();
+    if (_timer == TIM5) __HAL_RCC_TIM5_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+
+    GPIO_InitStruct.Pin = _pin1;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    GPIO_InitStruct.Alternate = _alternate;
+    HAL_GPIO_Init(_port1, &GPIO_InitStruct);
+
+    GPIO_InitStruct.Pin = _pin2;
+    HAL_GPIO_Init(_port2, &GPIO_InitStruct);
+
+    // up counting, ARR and CCRs buffered to the update event
+    _period = pwm.Period;
+    _timer->CR1 &= ~TIM_CR1_CEN;
+    _timer->CR1 |= TIM_CR1_ARPE;
+    _timer->PSC = pwm.Prescaler - 1;
+    _timer->ARR = pwm.Period - 1;
+
+    InitChannel(_channel1);
+    InitChannel(_channel2);
+    Coast();
+
+    _timer->EGR = TIM_EGR_UG;               /* load PSC, ARR and the compares */
+    _timer->CR1 |= TIM_CR1_CEN;
+}
+
+// PWM mode 1 (high while CNT < CCR), preloaded, output on
+void Motor::InitChannel(uint8_t channel){
+    volatile uint32_t* ccmr = (channel <= 2) ? &_timer->CCMR1 : &_timer->CCMR2;
+    uint32_t shift = (channel % 2) ? 0 : 8;
+
+    *ccmr &= ~((TIM_CCMR1_CC1S | TIM_CCMR1_OC1M | TIM_CCMR1_OC1PE) << shift);
+    *ccmr |= ((TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1PE) << shift);
+    _timer->CCER &= ~(TIM_CCER_CC1P << ((channel - 1) * 4));
+    _timer->CCER |= TIM_CCER_CC1E << ((channel - 1) * 4);
+}
+
+// takes effect at once if driving, otherwise from the next Set
+void Motor::SetDecay(uint8_t decay){
+    _decay = decay;
+    if (_state == MOTOR_STATE_FORWARD || _state == MOTOR_STATE_REVERSE){
+        _state = MOTOR_STATE_NONE;  // both inputs written again
+        Set(_duty);
+    }
+}
+
+/******************************************************************************
+ * New duty, from the control tick.  Only the switching input changes while   *
+ * the direction holds, so this is one multiply and one register store.       *
+ * -------------------------------------------------------------------------- *
+ * @param duty          // +/- MOTOR_DUTY_FULL, clamped                       *
+ *****************************************************************************/
+void Motor::Set(int32_t duty){
+    if (duty > MOTOR_DUTY_FULL) duty = MOTOR_DUTY_FULL;
+    if (duty < -MOTOR_DUTY_FULL) duty = -MOTOR_DUTY_FULL;
+    _duty = duty;
+
+    bool forward = (duty >= 0) != _reversed;
+    uint32_t compare = ((uint32_t)(duty >= 0 ? duty : -duty) * _period) >> MOTOR_DUTY_BITS;
+    uint8_t state = forward ? MOTOR_STATE_FORWARD : MOTOR_STATE_REVERSE;
+
+    // fast: the forward input switches, the other sits low
+    // slow: the forward input sits high, the other switches, low for the duty
+    volatile uint32_t* hold;
+    volatile uint32_t* pwm;
+    if (_decay == MOTOR_DECAY_SLOW){
+        hold = forward ? _ccr1 : _ccr2;
+        pwm = forward ? _ccr2 : _ccr1;
+        compare = _period - compare;
+    } else {
+        pwm = forward ? _ccr1 : _ccr2;
+        hold = forward ? _ccr2 : _ccr1;
+    }
+
+    if (state != _state){
+        *hold = (_decay == MOTOR_DECAY_SLOW) ? _period : 0;
+        _state = state;
+    }
+    *pwm = compare;
+}
+
+/******************************************************************************
+ * New drive voltage: the duty that puts it across the motor at the present   *
+ * supply.  One more multiply than Set.                                       *
+ * -------------------------------------------------------------------------- *
+ * @param millivolts    // signed, positive drives forward                    *
+ * @param dutyPerMillivolt // Q16, Battery::DutyPerMillivolt                  *
+ *****************************************************************************/
+void Motor::SetVoltage(int32_t millivolts, uint32_t dutyPerMillivolt){
+    Set((int32_t)(((int64_t)millivolts * dutyPerMillivolt) >> 16));
+}
+
+// both inputs high: the windings shorted through the low side
+void Motor::Brake(){
+    *_ccr1 = _period;
+    *_ccr2 = _period;
+    _state = MOTOR_STATE_BRAKE;
+    _duty = 0;
+}
+
+// both inputs low: outputs off, the motor spins down on its own
+void Motor::Coast(){
+    *_ccr1 = 0;
+    *_ccr2 = 0;
+    _state = MOTOR_STATE_COAST;
+    _duty = 0;
+}
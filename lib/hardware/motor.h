@@ -0,0 +1,135 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * DRV8833 H bridge, one motor per pair of inputs, both inputs on timer PWM   *
+ * channels so either can switch:                                             *
+ *                                                                            *
+ *   fast decay   one input PWMs, the other low; off time coasts              *
+ *   slow decay   one input high, the other PWMs low; off time brakes         *
+ *   Brake        both high                                                   *
+ *   Coast        both low (also the state after Init)                        *
+ *                                                                            *
+ * Compare registers are preloaded, so a new duty (and a reversal, which      *
+ * writes both inputs) lands on the next PWM period in one piece.             *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+
+/* duty given to Set, +/- full scale */
+#define MOTOR_DUTY_BITS         10
+#define MOTOR_DUTY_FULL         (1 << MOTOR_DUTY_BITS)
+
+#define MOTOR_DECAY_FAST        0
+#define MOTOR_DECAY_SLOW        1
+
+/* what the inputs were last set up for */
+#define MOTOR_STATE_NONE        0
+#define MOTOR_STATE_FORWARD     1
+#define MOTOR_STATE_REVERSE     2
+#define MOTOR_STATE_BRAKE       3
+#define MOTOR_STATE_COAST       4
+
+/* DRV8833 inputs are good to 50 kHz */
+#ifndef MOTOR_PWM_MAX_HZ
+#define MOTOR_PWM_MAX_HZ        50000
+#endif
+
+/* timer settings, written as they are; each is 1 .. 65536 */
+typedef struct {
+    uint32_t Prescaler;         // PSC + 1
+    uint32_t Period;            // ARR + 1, counts per PWM cycle
+    uint32_t Hz;                // PWM rate these give
+} MOTOR_PWM_t;
+
+// C++ even when included from inside another header's extern "C" block
+extern "C++" {
+
+/* smallest prescaler that fits the 16 bit counter, then the nearest period */
+constexpr MOTOR_PWM_t Motor_Pwm(uint32_t timerHz, uint32_t pwmHz) {
+    uint32_t counts = (timerHz + pwmHz / 2) / pwmHz;
+    uint32_t prescaler = (counts + 65535) / 65536;
+    uint32_t period = (timerHz / prescaler + pwmHz / 2) / pwmHz;
+    return MOTOR_PWM_t{prescaler, period, timerHz / (prescaler * period)};
+}
+
+/* the checked form: a rate the timer or the bridge can not run fails the build */
+template <uint32_t TIMER_HZ, uint32_t PWM_HZ>
+struct Motor_PwmFor {
+    static_assert(PWM_HZ > 0 && PWM_HZ <= MOTOR_PWM_MAX_HZ,
+                  "Motor: PWM rate beyond what the DRV8833 switches");
+    // divided down: 65536 * 65536 is 0 in a 32 bit unsigned long
+    static_assert(TIMER_HZ / PWM_HZ / 65536 < 65536,
+                  "Motor: PWM rate too slow for the timer");
+
+    static constexpr MOTOR_PWM_t Value = Motor_Pwm(TIMER_HZ, PWM_HZ);
+
+    static_assert(Value.Prescaler <= 65536 && Value.Period <= 65536,
+                  "Motor: PSC or ARR beyond 16 bits");
+
+    static_assert(Value.Period >= MOTOR_DUTY_FULL,
+                  "Motor: fewer timer counts per period than duty steps");
+    static_assert(Value.Hz * 100 >= PWM_HZ * 99 && Value.Hz * 100 <= PWM_HZ * 101,
+                  "Motor: PWM rate more than 1% off");
+};
+
+}
+
+/*!
+* @brief One drive motor on a DRV8833
+*/
+class Motor {
+
+private:
+    TIM_TypeDef* _timer;
+    uint8_t _channel1;          // IN1, driving it high turns the motor forward
+    uint8_t _channel2;
+    volatile uint32_t* _ccr1;
+    volatile uint32_t* _ccr2;
+    uint32_t _pin1, _pin2;
+    GPIO_TypeDef* _port1;
+    GPIO_TypeDef* _port2;
+    uint32_t _alternate;
+    bool _reversed;             // mirrored on the chassis: forward is IN2
+
+    uint32_t _period;
+    uint8_t _decay;
+    uint8_t _state;
+    int32_t _duty;
+
+    void InitChannel(uint8_t channel);
+
+public:
+    Motor(TIM_TypeDef* timer, uint8_t channel1, uint32_t pin1, GPIO_TypeDef* port1,
+          uint8_t channel2, uint32_t pin2, GPIO_TypeDef* port2, uint32_t alternate, bool reversed);
+
+    void Init(MOTOR_PWM_t pwm);     // motors sharing a timer must share pwm
+    void SetDecay(uint8_t decay);
+
+    // control tick side: one compare store, two on a change of direction
+    void Set(int32_t duty);         // +/- MOTOR_DUTY_FULL, positive drives forward
+    void SetVoltage(int32_t millivolts, uint32_t dutyPerMillivolt);  // scale from Battery
+    void Brake();
+    void Coast();
+
+    int32_t GetDuty() { return _duty; }
+    uint8_t GetState() { return _state; }
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTOR_H
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ *****************************************************************************/
+#include "syncsampler.h"
+
+// object serving the TIM1 update vector, registered by Init
+static SyncSampler* syncsampler_instance;
+
+/******************************************************************************
+ * Constructor, nothing touches the hardware until Init.                      *
+ * -------------------------------------------------------------------------- *
+ * @param left, right   // encoders, Init already called                      *
+ * @param timerHz       // TIM1 kernel clock (PCLK2, x2 if APB2 is divided)   *
+ * @param rateHz        // samples per second                                 *
+ *****************************************************************************/
+SyncSampler::SyncSampler(Encoder* left, Encoder* right, uint32_t timerHz, uint32_t rateHz){
+    _left = left;
+    _right = right;
+    _timerHz = timerHz;
+    _rateHz = rateHz;
+    _callback = 0;
+    _context = 0;
+
+    _sample.Time = 0;
+    _sample.Ticks = 0;
+    _sample.LeftPosition = 0;
+    _sample.RightPosition = 0;
+    _sample.LeftDelta = 0;
+    _sample.RightDelta = 0;
+
+    // smallest prescaler that fits the 16 bit counter
+    uint32_t counts = timerHz / rateHz;
+    _prescaler = (counts + 65535) / 65536;
+    _period = counts / _prescaler;
+}
+
+void SyncSampler::Init(){
+    _cyclesPerCount = (uint32_t)((uint64_t)SystemCoreClock * _prescaler / _timerHz);
+
+    _left->EnableSyncLatch();
+    _right->EnableSyncLatch();
+
+    // TIM1: up counting at the rate, update event out on TRGO
+    RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
+    TIM1->CR1 = 0;
+    TIM1->PSC = _prescaler - 1;
+    TIM1->ARR = _period - 1;
+    TIM1->RCR = 0;
+    TIM1->CR2 = TIM_CR2_MMS_1;              /* MMS = 010, update */
+    TIM1->CR1 = TIM_CR1_URS;                /* only overflows interrupt, not UG */
+    TIM1->EGR = TIM_EGR_UG;                 /* load PSC */
+    TIM1->SR = 0;
+    TIM1->DIER = TIM_DIER_UIE;
+
+    syncsampler_instance = this;
+    NVIC_SetPriority(TIM1_UP_TIM10_IRQn, SYNCSAMPLE_IRQ_PRIORITY);
+    NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
+    TIM1->CR1 |= TIM_CR1_CEN;
+}
+
+void SyncSampler::SetCallback(SyncSampler_Callback callback, void* context){
+    _context = context;
+    _callback = callback;
+}
+
+// the last pair, in one piece
+SYNCSAMPLE_t SyncSampler::Snapshot(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    SYNCSAMPLE_t sample = _sample;
+    __set_PRIMASK(primask);
+    return sample;
+}
+
+/******************************************************************************
+ * TIM1 update.  The counts were latched at the update itself; TIM1's CNT    *
+ * says how long ago that was, which dates the pair exactly whatever the     *
+ * interrupt latency.                                                         *
+ *****************************************************************************/
+void SyncSampler::IRQHandler(){
+    if (!(TIM1->SR & TIM_SR_UIF)){
+        return;
+    }
+    TIM1->SR = ~TIM_SR_UIF;
+
+    uint32_t now = CYCLES_Now();
+    uint32_t time = now - TIM1->CNT * _cyclesPerCount;
+
+    _left->UpdateLatched(time);
+    _right->UpdateLatched(time);
+
+    _sample.Time = time;
+    _sample.Ticks++;
+    _sample.LeftPosition = _left->Position();
+    _sample.RightPosition = _right->Position();
+    _sample.LeftDelta = _left->Delta();
+    _sample.RightDelta = _right->Delta();
+
+    if (_callback){
+        _callback(&_sample, _context);
+    }
+}
+
+/******************************************************************************
+ * Interrupt vector                                                           *
+ *****************************************************************************/
+extern "C" void TIM1_UP_TIM10_IRQHandler(void){
+    if (syncsampler_instance) syncsampler_instance->IRQHandler();
+}
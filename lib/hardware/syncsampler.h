@@ -0,0 +1,79 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Both wheels sampled on one hardware tick: TIM1 runs at the control rate    *
+ * and its update (TRGO) latches TIM2 and TIM4 into their CCR3 on the same    *
+ * clock edge.  The update interrupt then reads the latched counts, stamps    *
+ * them with the cycle count of the latch, and hands the pair on.             *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef SYNCSAMPLER_H
+#define SYNCSAMPLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+#include "cycles.h"
+#include "encoder.h"
+
+/* NVIC preemption priority of the control tick: above the I2C and DMA
+   interrupts so display traffic can not hold it off */
+#ifndef SYNCSAMPLE_IRQ_PRIORITY
+#define SYNCSAMPLE_IRQ_PRIORITY 1
+#endif
+
+/* one tick's left/right pair, taken at the same instant */
+typedef struct {
+    uint32_t Time;              // CYCLES_Now() at the latch
+    uint32_t Ticks;             // samples since Init
+    int32_t LeftPosition;
+    int32_t RightPosition;
+    int16_t LeftDelta;          // counts since the previous sample
+    int16_t RightDelta;
+} SYNCSAMPLE_t;
+
+/* runs in the TIM1 update interrupt after every sample */
+typedef void (*SyncSampler_Callback)(const SYNCSAMPLE_t* sample, void* context);
+
+/*!
+* @brief TIM1 control tick latching both encoders together
+*/
+class SyncSampler {
+
+private:
+    Encoder* _left;
+    Encoder* _right;
+    uint32_t _timerHz;          // TIM1 kernel clock
+    uint32_t _rateHz;
+    uint16_t _prescaler;        // PSC + 1
+    uint16_t _period;           // ARR + 1
+    uint32_t _cyclesPerCount;   // core cycles per TIM1 count
+
+    SYNCSAMPLE_t _sample;
+    SyncSampler_Callback _callback;
+    void* _context;
+
+public:
+    SyncSampler(Encoder* left, Encoder* right, uint32_t timerHz, uint32_t rateHz);
+
+    void Init();
+    void SetCallback(SyncSampler_Callback callback, void* context);
+    SYNCSAMPLE_t Snapshot();
+
+    // called from the interrupt vector in syncsampler.cpp
+    void IRQHandler();
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SYNCSAMPLER_H
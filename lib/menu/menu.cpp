@@ -22,9 +22,9 @@ Menu::Menu(Button* leftbutton, Button* rightbutton, Encoder* wheel, Display* dis
 
 bool Menu::TestPrint(const char str[]){
     _display->GotoXY (5,40);
-    sprintf(screen_buffer,"= %d", strlen(str));
     _display->Print(str, _font, COLOR_WHITE);
-    _display->Print(screen_buffer, _font, COLOR_WHITE);
+    _display->Print("= ", _font, COLOR_WHITE);
+    _display->PrintUint(strlen(str), 0, ' ', false, _font, COLOR_WHITE);
     _display->UpdateScreen();
     return true;
 }
@@ -37,6 +37,7 @@ bool Menu::menu_Main() {
             case MENU_MODE: page_MenuMode(); break;
             case MENU_SETUP: page_MenuSetUp(); break;
             case MENU_CALIBRATE: page_MenuCalibrate(); break;
+            case MENU_STATS: page_MenuStats(); break;
             case MENU_EXITMENU: exitMenu = true; break;
         }
     }
@@ -47,7 +48,7 @@ bool Menu::menu_Main() {
 void Menu::page_MenuRoot(){
 
     //initialise root menu
-    initMenuPage("Main", 4);
+    initMenuPage("Main", 5);
 
     while (1) {
         // print the display items when requested
@@ -64,6 +65,9 @@ void Menu::page_MenuRoot(){
                 _display->Print("Calibrate  ", _font, COLOR_WHITE); _display->UpdateScreen();
             }
             if (menuItemPrintable(1,4)){
+                _display->Print("Stats      ", _font, COLOR_WHITE); _display->UpdateScreen();
+            }
+            if (menuItemPrintable(1,5)){
                 _display->Print("Exit Menu  ", _font, COLOR_WHITE); _display->UpdateScreen();
             }
 
@@ -83,7 +87,8 @@ void Menu::page_MenuRoot(){
                 case 1 : currPage = MENU_MODE; return;
                 case 2 : currPage = MENU_SETUP; return;
                 case 3 : currPage = MENU_CALIBRATE; return;
-                case 4 : currPage = MENU_EXITMENU; return;
+                case 4 : currPage = MENU_STATS; return;
+                case 5 : currPage = MENU_EXITMENU; return;
             }
         }
 
@@ -118,6 +123,63 @@ void Menu::page_MenuCalibrate(){
     while (1) {}
 }
 
+void Menu::page_MenuStats(){
+
+    //initialise stats page, no pointer
+    initMenuPage("Display Stats", 1);
+
+    // live counters, left button resets them, right button goes back.
+    // Six rows inside the frame (rows 17..62): 7 pixels apart, the 6x8
+    // glyphs' blank bottom row is the gap
+    uint32_t frames, bytes, avgUs, worstUs, waitUs, errors;
+    TextField fieldFrames(_display, 5, 18, "Frames   ", 10, _font);
+    TextField fieldBytes(_display, 5, 25, "Bytes    ", 10, _font);
+    TextField fieldAvg(_display, 5, 32, "Avg us   ", 10, _font);
+    TextField fieldWorst(_display, 5, 39, "Worst us ", 10, _font);
+    TextField fieldWait(_display, 5, 46, "Wait us  ", 10, _font);
+    TextField fieldErrors(_display, 5, 53, "Bus err  ", 10, _font);
+    fieldFrames.BindUint(&frames);
+    fieldBytes.BindUint(&bytes);
+    fieldAvg.BindUint(&avgUs);
+    fieldWorst.BindUint(&worstUs);
+    fieldWait.BindUint(&waitUs);
+    fieldErrors.BindUint(&errors);
+
+    while (1) {
+        DISPLAY_STATS_t stats = _display->GetStats();
+        I2C_STATS_t bus = _display->GetBusStats();
+
+        frames = stats.Frames;
+        bytes = stats.Bytes;
+        avgUs = stats.Frames ? CYCLES_ToMicros(stats.FlushCycles / stats.Frames) : 0;
+        worstUs = CYCLES_ToMicros(stats.WorstLatency);
+        waitUs = CYCLES_ToMicros(bus.WaitCycles);
+        errors = bus.Nacks + bus.ArbitrationLost + bus.BusErrors + bus.Timeouts;
+
+        fieldFrames.Update();
+        fieldBytes.Update();
+        fieldAvg.Update();
+        fieldWorst.Update();
+        fieldWait.Update();
+        fieldErrors.Update();
+        _display->UpdateScreen();
+
+        // capture the button down states
+        captureButtonDownState();
+
+        if (_leftbutton->PressRelesed()){
+            _display->ResetStats();
+        }
+
+        if (_rightbutton->PressRelesed()){
+            currPage = MENU_ROOT;
+            return;
+        }
+
+        pacingWait();
+    }
+}
+
 void Menu::initMenuPage(const char title[], uint8_t itemCount){
 
     // clear the display
@@ -332,6 +394,6 @@ void Menu::printOnOff(bool val) {
 }
 
 void Menu::printUint32_tAtWidth(uint32_t value, uint8_t width, char c, bool isRight) {
-
+    _display->PrintUint(value, width, c, isRight, _font, COLOR_WHITE);
 }
 
@@ -20,6 +20,7 @@ extern "C" {
 #include "stm32f4xx.h"  // Device header
 #include <stdio.h>
 #include "display.h"
+#include "textfield.h"
 #include "button.h"
 #include "encoder.h"
 
@@ -47,6 +48,7 @@ class Menu {
         MENU_MODE,
         MENU_SETUP,
         MENU_CALIBRATE,
+        MENU_STATS,
         MENU_EXITMENU
     };
     enum PageType currPage = MENU_ROOT;
@@ -70,6 +72,7 @@ class Menu {
     void page_MenuMode();    
     void page_MenuSetUp();    
     void page_MenuCalibrate();
+    void page_MenuStats();
 
     // menu control function declarations
     void initMenuPage(const char title[], uint8_t itemCount);
@@ -0,0 +1,83 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ *****************************************************************************/
+#include "odometry.h"
+
+Odometry::Odometry(ODOMETRY_CONFIG_t config){
+    _config = config;
+    Reset(0, 0, 0);
+}
+
+/******************************************************************************
+ * Puts the robot at a known pose, e.g. the start cell.                       *
+ * -------------------------------------------------------------------------- *
+ * @param x, y          // mm Q16.16                                          *
+ * @param theta         // binary angle, 0 along +x                           *
+ *****************************************************************************/
+void Odometry::Reset(int32_t x, int32_t y, uint32_t theta){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _difference = 0;
+    _theta0 = theta;
+    _x = (int64_t)x * 256;
+    _y = (int64_t)y * 256;
+
+    _pose.X = x;
+    _pose.Y = y;
+    _pose.Theta = theta;
+    _pose.Velocity = 0;
+    _pose.AngularVelocity = 0;
+    _pose.Updates = 0;
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ * One control tick.  The wheel paths over a tick are near enough straight    *
+ * that stepping the mean travel along the heading halfway through the tick   *
+ * (second order) stays well inside a micron a tick at mouse speeds.          *
+ * -------------------------------------------------------------------------- *
+ * @param leftDelta, rightDelta // counts this tick, latched together         *
+ *****************************************************************************/
+void Odometry::Update(int16_t leftDelta, int16_t rightDelta){
+    uint32_t thetaOld = _pose.Theta;
+
+    _difference += rightDelta - leftDelta;
+    uint32_t theta = _theta0 + (uint32_t)(((int64_t)_difference * _config.AnglePerCountQ16) >> 16);
+    int32_t turn = (int32_t)(theta - thetaOld);
+    uint32_t mid = thetaOld + (uint32_t)(turn / 2);
+
+    int64_t travel = ((int64_t)(leftDelta + rightDelta) * _config.MmPerCountQ24) >> 1;    /* mm Q24 */
+    // sin and cos top out at 32767, the step is scaled up to make the >> 15 exact
+    int64_t step = ((int64_t)(leftDelta + rightDelta) * _config.StepPerCountQ24) >> 1;
+    _x += (step * TRIG_Cos(mid)) >> 15;
+    _y += (step * TRIG_Sin(mid)) >> 15;
+
+    _pose.X = (int32_t)(_x >> 8);
+    _pose.Y = (int32_t)(_y >> 8);
+    _pose.Theta = theta;
+    _pose.Velocity = (int32_t)((travel * _config.RateHz) >> 8);
+    _pose.AngularVelocity = (int32_t)(((int64_t)turn * _config.RateHz * ODOMETRY_TWO_PI_Q16) >> 32);
+    _pose.Updates++;
+}
+
+// the last pose, in one piece
+ODOMETRY_POSE_t Odometry::Pose(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    ODOMETRY_POSE_t pose = _pose;
+    __set_PRIMASK(primask);
+    return pose;
+}
+
+void Odometry::OnTick(const SCHEDULER_TICK_t* tick, void* context){
+    const SYNCSAMPLE_t* sample = (const SYNCSAMPLE_t*)tick->Data;
+    ((Odometry*)context)->Update(sample->LeftDelta, sample->RightDelta);
+}
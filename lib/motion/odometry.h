@@ -0,0 +1,105 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Differential drive odometry in fixed point, updated from the time aligned  *
+ * wheel deltas of the control tick (SyncSampler).                            *
+ *                                                                            *
+ *   heading   binary angle (2^32 a turn), worked out from the running        *
+ *             right - left count, so it never drifts from the encoders       *
+ *   x, y      mm Q16.16 (+/-32 m), stepped along the mid-tick heading        *
+ *   v, w      forward mm/s Q16.16 and rad/s Q16.16 over the last tick        *
+ *                                                                            *
+ * Every Update runs the same instructions: no loops, no divisions, no float. *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+#include "trig.h"
+#include "syncsampler.h"
+#include "scheduler.h"
+
+/* scale factors, from Odometry_Config at compile time */
+typedef struct {
+    int32_t MmPerCountQ24;      // wheel travel per count
+    int32_t StepPerCountQ24;    // the same over the trig table's 32767 full scale
+    int64_t AnglePerCountQ16;   // binary angle per count of right minus left
+    uint32_t RateHz;            // Update calls per second
+} ODOMETRY_CONFIG_t;
+
+/* where the robot is, x forward at heading 0, heading anticlockwise */
+typedef struct {
+    int32_t X;                  // mm Q16.16
+    int32_t Y;                  // mm Q16.16
+    uint32_t Theta;             // binary angle
+    int32_t Velocity;           // mm/s Q16.16
+    int32_t AngularVelocity;    // rad/s Q16.16
+    uint32_t Updates;
+} ODOMETRY_POSE_t;
+
+/* 2 pi rad as Q16.16 */
+#define ODOMETRY_TWO_PI_Q16     411775
+
+// C++ even when included from inside another header's extern "C" block
+extern "C++" {
+
+/******************************************************************************
+ * Scale factors from the drive train, evaluated by the compiler so the       *
+ * target never sees the doubles, e.g. from config-robot-E4.h:                *
+ *     constexpr ODOMETRY_CONFIG_t c = Odometry_Config(                       *
+ *         ROBOT_WHEEL_DIAMETER_MM, ROBOT_COUNTS_PER_WHEEL_REV,               *
+ *         ROBOT_TRACK_WIDTH_MM, CONTROL_TICK_HZ);                            *
+ ******************************************************************************/
+constexpr ODOMETRY_CONFIG_t Odometry_Config(double wheelDiameterMm, double countsPerWheelRev, double trackMm, uint32_t rateHz) {
+    double mmPerCount = 3.14159265358979324 * wheelDiameterMm / countsPerWheelRev;
+    double turnsPerCount = mmPerCount / trackMm / (2 * 3.14159265358979324);
+    return ODOMETRY_CONFIG_t{(int32_t)(mmPerCount * 16777216.0 + 0.5),
+                             (int32_t)(mmPerCount * 32768.0 / 32767.0 * 16777216.0 + 0.5),
+                             (int64_t)(turnsPerCount * 4294967296.0 * 65536.0 + 0.5),
+                             rateHz};
+}
+
+}
+
+/*!
+* @brief Robot pose from the two wheels
+*/
+class Odometry {
+
+private:
+    ODOMETRY_CONFIG_t _config;
+
+    int32_t _difference;        // right - left counts since Reset
+    uint32_t _theta0;           // heading given to Reset
+    int64_t _x;                 // mm Q24
+    int64_t _y;
+
+    ODOMETRY_POSE_t _pose;
+
+public:
+    Odometry(ODOMETRY_CONFIG_t config);
+
+    void Reset(int32_t x, int32_t y, uint32_t theta);  // mm Q16.16, bin. angle
+    void Update(int16_t leftDelta, int16_t rightDelta);
+    ODOMETRY_POSE_t Pose();
+
+    // SCHED_PHASE_STATE stage, context is the Odometry, tick Data a SYNCSAMPLE_t
+    static void OnTick(const SCHEDULER_TICK_t* tick, void* context);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ODOMETRY_H
@@ -0,0 +1,303 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ *****************************************************************************/
+#include "profile.h"
+#include <math.h>
+
+Profile::Profile(uint32_t rateHz){
+    _rateHz = rateHz;
+    Reset();
+}
+
+void Profile::Reset(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _move.Distance = 0;
+    _move.Speed = 0;
+    _move.EndSpeed = 0;
+    _move.Acceleration = 0;
+    _move.Jerk = 0;
+    _move.RampTicks = 0;
+    _move.TicksPerAcceleration = 0;
+    _move.TicksSquaredPerSpeed = 0;
+    _move.Sign = 1;
+    _hasNext = false;
+    _position = 0;
+    _done = 0;
+    _velocity = 0;
+    _acceleration = 0;
+    _state = PROFILE_IDLE;
+    _moves = 0;
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ * Starts a move now, from the present speed.  A queued move is dropped.      *
+ *****************************************************************************/
+void Profile::Start(PROFILE_MOVE_t move){
+    Start(Profile_Steps(move, _rateHz));
+}
+
+void Profile::Start(const PROFILE_STEPS_t& move){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _hasNext = false;
+    Begin(&move);
+    _done = 0;
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ * Queues a move to follow the running one without a break.  With nothing     *
+ * running it starts at once; after a move has ended (and carried on at its   *
+ * end speed) the distance covered since counts towards this one.  A move     *
+ * already queued is replaced.                                                *
+ *****************************************************************************/
+void Profile::Next(PROFILE_MOVE_t move){
+    Next(Profile_Steps(move, _rateHz));
+}
+
+void Profile::Next(const PROFILE_STEPS_t& move){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (_state == PROFILE_IDLE){
+        Begin(&move);
+        _done = 0;
+    } else if (_state == PROFILE_DONE){
+        int64_t over = _done - _move.Distance;
+        Begin(&move);
+        _done = over;
+    } else {
+        _next = move;
+        _hasNext = true;
+    }
+    __set_PRIMASK(primask);
+}
+
+void Profile::Stop(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _hasNext = false;
+    _velocity = 0;
+    _acceleration = 0;
+    _state = PROFILE_IDLE;
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ * One tick.  Speeds up while a tick at the faster speed still leaves room to  *
+ * brake, holds while a tick at the present speed does, brakes otherwise; so  *
+ * braking starts within a tick of the last moment and the end speed is met   *
+ * with less than a tick to spare.  The last step is cut at the distance,     *
+ * whatever was left of it goes into the next move, so the positions always   *
+ * add up to the distances exactly.                                           *
+ *****************************************************************************/
+void Profile::Update(){
+    if (_state == PROFILE_IDLE){
+        return;
+    }
+    if (_state == PROFILE_DONE){
+        // carrying on at the end speed until there is a next move
+        _done += _velocity;
+        _position += _move.Sign * _velocity;
+        return;
+    }
+
+    int64_t remaining = _move.Distance - _done;
+
+    if (_state == PROFILE_ACCELERATING){
+        int64_t step = _move.Jerk ? _acceleration >> 16 : _move.Acceleration >> 16;
+        int64_t next = _velocity + step;
+        if (next > _move.Speed) next = _move.Speed;
+        if (next < _velocity) next = _velocity;
+        if (MustBrake(remaining, next)){
+            _state = PROFILE_BRAKING;
+        }
+    }
+
+    if (_state == PROFILE_ACCELERATING){
+        Ramp(_move.Speed);
+    } else if (MustBrake(remaining, _velocity)){
+        Ramp(_move.EndSpeed);
+    } else {
+        // early: hold (an S curve eases off to where that lands), brake a tick later
+        int64_t hold = _velocity + Shed();
+        if (hold < _move.EndSpeed) hold = _move.EndSpeed;
+        if (hold > _move.Speed) hold = _move.Speed;
+        Ramp(hold);
+    }
+
+    // braking to a stop must still get there: never slower than one tick's acceleration
+    if (_state == PROFILE_BRAKING && _acceleration < 0){
+        int64_t floor = _move.Acceleration >> 16;
+        if (floor < _move.EndSpeed) floor = _move.EndSpeed;
+        if (_velocity < floor){
+            _velocity = floor;
+            _acceleration = 0;
+        }
+    }
+
+    if (_velocity < remaining){
+        _done += _velocity;
+        _position += _move.Sign * _velocity;
+        return;
+    }
+
+    // arrives in this tick
+    int64_t over = _velocity - remaining;
+    _position += _move.Sign * remaining;
+    _moves++;
+    if (_hasNext){
+        _hasNext = false;
+        Begin(&_next);
+        _done = over;
+        _position += _move.Sign * over;
+    } else {
+        _done = _move.Distance;
+        _velocity = _move.EndSpeed;
+        _acceleration = 0;
+        _state = PROFILE_DONE;
+    }
+}
+
+/******************************************************************************
+ * True if, after a tick at speed v, the distance left would be too short to  *
+ * brake to the end speed.  Braking a step a a tick from v to vf covers       *
+ * (v^2 - vf^2 - a (v - vf)) / 2a; compared as a product, in Q24 so the       *
+ * squares fit.  An S curve first sheds a rising acceleration (a1 / j ticks,  *
+ * gaining a1^2 / 2j of speed) and spends (v + vf) a / 2j more building up    *
+ * and easing off the braking; below a^2 / j to lose it never reaches a, and  *
+ * the whole brake is (v + vf) sqrt((v - vf) / j).                            *
+ *****************************************************************************/
+bool Profile::MustBrake(int64_t remaining, int64_t velocity){
+    int64_t v = velocity >> 8;
+    int64_t vf = _move.EndSpeed >> 8;
+    int64_t a = _move.Acceleration >> 24;
+    int64_t d = (remaining >> 8) - v;
+
+    if (_acceleration > 0){
+        int64_t ticks = ((_acceleration >> 16) * _move.TicksPerAcceleration) >> 16;     /* Q16 */
+        v += Shed() >> 8;
+        d -= (v * ticks) >> 16;
+    }
+    if (v <= vf){
+        return false;
+    }
+    if (_move.Jerk){
+        if (v - vf < (a * _move.RampTicks) >> 16){
+            // too little to shed for the full braking rate: up and down at the jerk
+            float ticks = sqrtf((float)(v - vf) * _move.TicksSquaredPerSpeed);
+            return (float)(v + vf) * ticks > (float)d;
+        }
+        d -= ((v + vf) * _move.RampTicks) >> 17;
+    }
+    return v * v - vf * vf - a * (v - vf) > 2 * a * d;
+}
+
+/******************************************************************************
+ * Speed gained (or lost) easing the acceleration off to 0 at the jerk,       *
+ * a |a| / 2j, Q32 per tick; nothing for a trapezoid.                         *
+ *****************************************************************************/
+int64_t Profile::Shed(){
+    int64_t a = _acceleration >> 16;
+    int64_t ticks = ((a < 0 ? -a : a) * _move.TicksPerAcceleration) >> 16;        /* Q16 */
+    return (a * ticks) >> 17;
+}
+
+/******************************************************************************
+ * Moves the velocity towards target: at once at the full acceleration for a  *
+ * trapezoid; for an S curve the acceleration itself moves by the jerk, and   *
+ * starts coming off while the speed still to gain, dv, is a^2 / 2j.          *
+ *****************************************************************************/
+void Profile::Ramp(int64_t target){
+    int64_t before = _velocity;
+    int64_t dv = target - _velocity;
+
+    if (!_move.Jerk){
+        int64_t step = _move.Acceleration >> 16;
+        if (dv > step) dv = step;
+        if (dv < -step) dv = -step;
+        _velocity += dv;
+        _acceleration = dv << 16;
+        return;
+    }
+
+    int64_t a = _acceleration >> 16;
+    int64_t shed = a * a;                               /* Q64 */
+    int64_t room = 2 * _move.Jerk * ((dv < 0 ? -dv : dv) >> 16);
+
+    if (dv > 0 && (_acceleration < 0 || shed < room)){
+        _acceleration += _move.Jerk;
+        if (_acceleration > _move.Acceleration) _acceleration = _move.Acceleration;
+    } else if (dv < 0 && (_acceleration > 0 || shed < room)){
+        _acceleration -= _move.Jerk;
+        if (_acceleration < -_move.Acceleration) _acceleration = -_move.Acceleration;
+    } else if (_acceleration > _move.Jerk){
+        _acceleration -= _move.Jerk;                    /* easing off */
+    } else if (_acceleration < -_move.Jerk){
+        _acceleration += _move.Jerk;
+    } else {
+        _acceleration = 0;
+    }
+
+    _velocity += _acceleration >> 16;
+
+    // landing on the target, not through it
+    if ((dv >= 0 && _velocity > target) || (dv <= 0 && _velocity < target)){
+        _velocity = target;
+        _acceleration = (target - before) << 16;
+    }
+}
+
+// a move the other way round starts from the present speed turned round
+void Profile::Begin(const PROFILE_STEPS_t* move){
+    if (move->Sign != _move.Sign){
+        _velocity = -_velocity;
+        _acceleration = -_acceleration;
+    }
+    _move = *move;
+    _state = PROFILE_ACCELERATING;
+}
+
+// the setpoints in outside units, in one piece
+PROFILE_SETPOINT_t Profile::Setpoint(){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    int64_t position = _position;
+    int64_t velocity = _velocity;
+    int64_t acceleration = _acceleration;
+    int64_t remaining = _move.Distance - _done;
+    int8_t sign = _move.Sign;
+    uint8_t state = _state;
+    uint32_t moves = _moves;
+    __set_PRIMASK(primask);
+
+    PROFILE_SETPOINT_t setpoint;
+    setpoint.Position = (int32_t)(position >> 16);
+    setpoint.Velocity = (int32_t)(sign * ((velocity * _rateHz) >> 16));
+    setpoint.Acceleration = (int32_t)(sign * ((((acceleration * _rateHz) >> 16) * _rateHz) >> 16));
+    setpoint.Remaining = (int32_t)(sign * ((remaining > 0 ? remaining : 0) >> 16));
+    setpoint.State = state;
+    setpoint.Moves = moves;
+    return setpoint;
+}
+
+bool Profile::IsFinished(){
+    return (_state == PROFILE_DONE || _state == PROFILE_IDLE) && !_hasNext;
+}
+
+bool Profile::HasNext(){
+    return _hasNext;
+}
+
+void Profile::OnTick(const SCHEDULER_TICK_t* tick, void* context){
+    ((Profile*)context)->Update();
+}
@@ -0,0 +1,165 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Motion profile for one axis (forward mm or rotation degrees): per tick     *
+ * position, velocity and acceleration setpoints that take a move from the    *
+ * speed it starts at to its top speed and down to its end speed, arriving    *
+ * on the distance.  A jerk of 0 gives a trapezoid, otherwise the             *
+ * acceleration ramps at the jerk (S curve).                                  *
+ *                                                                            *
+ * A move queued with Next starts on the tick the running one ends, carrying  *
+ * the speed and the part of that tick's step past the end, so a run made of  *
+ * moves with non zero end speeds never stops between them.                   *
+ *                                                                            *
+ * Update is a fixed set of 64 bit multiplies and compares, no division (a    *
+ * short S curve brake takes one sqrtf, a single FPU instruction); Start and  *
+ * Next divide a few times to turn the move into per tick units, unless given *
+ * one already turned by Profile_Steps (at compile time, for a table).        *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+#include "scheduler.h"
+
+#define PROFILE_IDLE            0   // nothing to do, holding still
+#define PROFILE_ACCELERATING    1   // towards the top speed, or cruising at it
+#define PROFILE_BRAKING         2   // towards the end speed
+#define PROFILE_DONE            3   // arrived, at the end speed
+
+/* a move; the units are whatever the axis uses (mm, degrees) */
+typedef struct {
+    int32_t Distance;           // Q16.16, negative goes backwards
+    int32_t Speed;              // top speed, units/s Q16.16
+    int32_t EndSpeed;           // units/s Q16.16, at most Speed
+    int32_t Acceleration;       // units/s^2, also used to brake
+    int32_t Jerk;               // units/s^3, 0 for a trapezoid
+} PROFILE_MOVE_t;
+
+/* the setpoints for this tick */
+typedef struct {
+    int32_t Position;           // Q16.16, since Reset, across moves
+    int32_t Velocity;           // units/s Q16.16
+    int32_t Acceleration;       // units/s^2 Q16.16
+    int32_t Remaining;          // Q16.16, left of the running move
+    uint8_t State;
+    uint32_t Moves;             // moves finished since Reset
+} PROFILE_SETPOINT_t;
+
+/* a move in the per tick units Update works in, from Profile_Steps */
+typedef struct {
+    int64_t Distance;           // Q32, positive
+    int64_t Speed;              // Q32 per tick
+    int64_t EndSpeed;
+    int64_t Acceleration;       // Q48 per tick^2
+    int64_t Jerk;               // Q48 per tick^3, 0 for a trapezoid
+    int64_t RampTicks;          // Q16, Acceleration / Jerk
+    int64_t TicksPerAcceleration;   // 2^48 / Jerk: Q48 acceleration to ticks Q32
+    float TicksSquaredPerSpeed;     // 2^24 / Jerk: Q24 speed to ticks^2 at the jerk
+    int8_t Sign;
+} PROFILE_STEPS_t;
+
+// C++ even when included from inside another header's extern "C" block
+extern "C++" {
+
+/* a move from plain numbers, e.g. a table in the robot config */
+constexpr PROFILE_MOVE_t Profile_Move(double distance, double speed, double endSpeed, double acceleration, double jerk = 0) {
+    return PROFILE_MOVE_t{(int32_t)(distance * 65536.0 + (distance < 0 ? -0.5 : 0.5)),
+                          (int32_t)(speed * 65536.0 + 0.5),
+                          (int32_t)(endSpeed * 65536.0 + 0.5),
+                          (int32_t)(acceleration + 0.5),
+                          (int32_t)(jerk + 0.5)};
+}
+
+/* a move turned into per tick units for rateHz, the divisions Start and Next
+   would otherwise do; constexpr so a table of moves costs nothing at run time */
+constexpr PROFILE_STEPS_t Profile_Steps(PROFILE_MOVE_t move, uint32_t rateHz) {
+    int64_t rate = rateHz;
+    int32_t speed = (move.Speed > 0) ? move.Speed : 0;
+    int32_t endSpeed = (move.EndSpeed > 0) ? move.EndSpeed : 0;
+    if (endSpeed > speed) endSpeed = speed;
+
+    PROFILE_STEPS_t out{};
+    out.Sign = (move.Distance < 0) ? -1 : 1;
+    out.Distance = (int64_t)(move.Distance < 0 ? -move.Distance : move.Distance) << 16;
+    out.Speed = ((int64_t)speed << 16) / rate;
+    out.EndSpeed = ((int64_t)endSpeed << 16) / rate;
+    out.Acceleration = ((((int64_t)(move.Acceleration > 1 ? move.Acceleration : 1)) << 40) / (rate * rate)) << 8;
+    if (move.Jerk > 0){
+        out.Jerk = ((((int64_t)move.Jerk) << 40) / (rate * rate * rate)) << 8;
+        if (out.Jerk < 1) out.Jerk = 1;
+        out.RampTicks = (out.Acceleration << 16) / out.Jerk;
+        out.TicksPerAcceleration = ((int64_t)1 << 48) / out.Jerk;
+        out.TicksSquaredPerSpeed = 16777216.0f / (float)out.Jerk;
+    }
+    return out;
+}
+
+}
+
+/*!
+* @brief Trapezoid / S curve setpoints, one Update per control tick
+*
+* Per tick units inside: distance and velocity Q32 (units, units per tick),
+* acceleration and jerk Q48 (units per tick^2, ^3).
+*/
+class Profile {
+
+private:
+    uint32_t _rateHz;
+
+    PROFILE_STEPS_t _move;
+    PROFILE_STEPS_t _next;
+    bool _hasNext;
+
+    int64_t _position;          // Q32, since Reset, signed
+    int64_t _done;              // Q32, into the running move
+    int64_t _velocity;          // Q32 per tick, of the running move's direction
+    int64_t _acceleration;      // Q48 per tick^2
+    uint8_t _state;
+    uint32_t _moves;
+
+    void Begin(const PROFILE_STEPS_t* move);
+    bool MustBrake(int64_t remaining, int64_t velocity);
+    void Ramp(int64_t target);
+    int64_t Shed();
+
+public:
+    Profile(uint32_t rateHz);
+
+    void Reset();               // stopped, position 0, queue dropped
+    void Start(PROFILE_MOVE_t move);    // replaces the running move, keeps the speed
+    void Next(PROFILE_MOVE_t move);     // runs when the present one ends
+
+    // the same from Profile_Steps for this rate, no division: safe in the tick
+    void Start(const PROFILE_STEPS_t& move);
+    void Next(const PROFILE_STEPS_t& move);
+    void Stop();                // speed and acceleration to 0 at once, queue dropped
+
+    // tick side, one context only
+    void Update();
+
+    PROFILE_SETPOINT_t Setpoint();
+    bool IsFinished();          // done and nothing queued
+    bool HasNext();
+
+    // SCHED_PHASE_CONTROL stage, context is the Profile
+    static void OnTick(const SCHEDULER_TICK_t* tick, void* context);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_H
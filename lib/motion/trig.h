@@ -0,0 +1,38 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Fixed point sine and cosine of binary angles: a full turn is 2^32, so      *
+ * angles add, subtract and wrap with plain unsigned arithmetic.  Quarter     *
+ * wave table of 257 entries, linear interpolation, Q15 out (error about      *
+ * 1 LSB), same few instructions for every angle.                             *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef TRIG_H
+#define TRIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* binary angle units */
+#define TRIG_TURN_BITS      32
+#define TRIG_QUARTER        0x40000000UL    // 90 degrees
+#define TRIG_HALF           0x80000000UL    // 180 degrees
+
+/* sin and cos as Q15, -32767 .. 32767 */
+int32_t TRIG_Sin(uint32_t angle);
+int32_t TRIG_Cos(uint32_t angle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRIG_H
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ *                                                                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ *****************************************************************************/
+#include "turn.h"
+
+Turn::Turn(Profile* forward, Profile* rotation, const TURN_PLAN_t* plans, uint8_t count){
+    _forward = forward;
+    _rotation = rotation;
+    _plans = plans;
+    _count = count;
+    _sensor = nullptr;
+    _sensorContext = nullptr;
+    _plan = nullptr;
+    _pending = false;
+    _state = TURN_IDLE;
+    _triggered = false;
+    _endMoves = 0;
+    _turns = 0;
+}
+
+// called from the tick, so it must only read the latest sample
+void Turn::SetSensor(Turn_Sensor sensor, void* context){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _sensor = sensor;
+    _sensorContext = context;
+    __set_PRIMASK(primask);
+}
+
+/******************************************************************************
+ * Asks for a turn from the table; the next tick queues its run in behind     *
+ * whatever the forward profile is doing, so give it at the cell edge or      *
+ * while the last straight is still running.                                  *
+ * -------------------------------------------------------------------------- *
+ * @param index         // entry in the plan table, e.g. ROBOT_TURN_SS90L     *
+ *****************************************************************************/
+bool Turn::Start(uint8_t index){
+    if (index >= _count){
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool idle = (_state == TURN_IDLE) && !_pending;
+    if (idle){
+        _plan = &_plans[index];
+        _pending = true;
+    }
+    __set_PRIMASK(primask);
+    return idle;
+}
+
+/******************************************************************************
+ * One tick, after the forward profile's.  The arc is queued behind the run   *
+ * in and the run out behind the arc, so the forward moves follow on without  *
+ * a break; a phase ends when the forward profile has finished _endMoves.     *
+ *****************************************************************************/
+void Turn::Update(){
+    uint32_t moves = _forward->Setpoint().Moves;
+
+    if (_pending){
+        _pending = false;
+        int32_t reading = _sensor ? _sensor(_sensorContext) : -1;
+        _triggered = (_plan->Trigger > 0) && (reading >= 0);
+
+        // a run in behind a straight still going waits for it, else starts now
+        bool now = _forward->IsFinished();
+        _forward->Next(_triggered ? _plan->RunInLong : _plan->RunIn);
+        if (now){
+            _forward->Next(_plan->Arc);
+        }
+        _endMoves = moves + (now ? 1 : 2);
+        _state = TURN_RUN_IN;
+        return;
+    }
+
+    switch (_state){
+        case TURN_RUN_IN:
+            if (moves == _endMoves){
+                Rotate(moves);                      // the arc has taken over
+            } else if (moves + 1 == _endMoves){
+                if (!_forward->HasNext()){
+                    _forward->Next(_plan->Arc);     // the run in has just begun
+                }
+                if (_triggered && _sensor && _sensor(_sensorContext) >= _plan->Trigger){
+                    _forward->Start(_plan->Arc);
+                    Rotate(moves);
+                }
+            }
+            break;
+
+        case TURN_ROTATING:
+            if (moves == _endMoves){
+                _endMoves = moves + 1;
+                _state = TURN_RUN_OUT;
+            }
+            break;
+
+        case TURN_RUN_OUT:
+            if (moves == _endMoves){
+                _turns++;
+                _state = TURN_IDLE;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// arc running on the forward profile: rotate alongside it, run out behind it
+void Turn::Rotate(uint32_t moves){
+    _rotation->Start(_plan->Rotation);
+    _forward->Next(_plan->RunOut);
+    _endMoves = moves + 1;
+    _state = TURN_ROTATING;
+}
+
+uint8_t Turn::GetState(){
+    return _state;
+}
+
+bool Turn::IsFinished(){
+    return _state == TURN_IDLE && !_pending;
+}
+
+uint32_t Turn::GetTurns(){
+    return _turns;
+}
+
+void Turn::OnTick(const SCHEDULER_TICK_t* tick, void* context){
+    ((Turn*)context)->Update();
+}
@@ -0,0 +1,158 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Smooth turns from a turn table (TurnParameters in config.h): a run in      *
+ * straight at the turn speed, a rotation that ramps up at alpha, holds omega *
+ * and ramps down again while the robot keeps going forward at that speed,    *
+ * then a run out straight.  The forward moves are chained on the forward     *
+ * Profile so the speed never drops; the rotation runs on its own Profile.    *
+ *                                                                            *
+ * Turn_Plan works a table entry out for the control tick at compile time,    *
+ * down to the per tick moves, so a tick only looks them up.  With a front    *
+ * sensor and a trigger the turn starts when the reading gets there, at most  *
+ * TURN_TRIGGER_WINDOW_MM past run_in; otherwise at run_in.                   *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef TURN_H
+#define TURN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx.h"  // Device header
+#include "profile.h"
+#include "scheduler.h"
+
+/* forward acceleration, mm/s^2, should a turn start from another speed */
+#ifndef TURN_ACCELERATION
+#define TURN_ACCELERATION       3000
+#endif
+
+/* how far, mm, past run_in the front sensor may trigger a turn */
+#ifndef TURN_TRIGGER_WINDOW_MM
+#define TURN_TRIGGER_WINDOW_MM  10
+#endif
+
+#define TURN_IDLE               0   // no turn, forward left as the last one ended
+#define TURN_RUN_IN             1
+#define TURN_ROTATING           2
+#define TURN_RUN_OUT            3
+
+/* a table entry worked out for the control tick, from Turn_Plan */
+typedef struct {
+    PROFILE_STEPS_t RunIn;      // straight to the turn point, at the turn speed
+    PROFILE_STEPS_t RunInLong;  // the same, TURN_TRIGGER_WINDOW_MM longer
+    PROFILE_STEPS_t Arc;        // forward travel while rotating
+    PROFILE_STEPS_t RunOut;     // straight on to the cell edge
+    PROFILE_STEPS_t Rotation;   // degrees, ending still
+    int32_t Trigger;            // front sensor reading to turn at, 0 for none
+    uint32_t RampTicks;         // angular acceleration, each end
+    uint32_t OmegaTicks;        // at omega, 0 if the turn never reaches it
+    uint32_t Ticks;             // the whole rotation
+    int32_t ArcMm;              // Q16.16, forward while rotating
+} TURN_PLAN_t;
+
+/* front sensor reading, or negative with no wall ahead to see */
+typedef int32_t (*Turn_Sensor)(void* context);
+
+// C++ even when included from inside another header's extern "C" block
+extern "C++" {
+
+// square root the compiler can work out, x >= 0
+constexpr double Turn_Sqrt(double x) {
+    double root = (x > 1) ? x : 1;
+    for (int i = 0; i < 64; i++) {
+        root = (root + x / root) / 2;
+    }
+    return root;
+}
+
+/******************************************************************************
+ * A turn table entry for rateHz control ticks, evaluated by the compiler;    *
+ * any struct with the TurnParameters fields will do, e.g.                    *
+ *     constexpr TURN_PLAN_t ss90l = Turn_Plan(                               *
+ *         robotTurns[ROBOT_TURN_SS90L], CONTROL_TICK_HZ);                    *
+ * A turn too short to reach omega peaks at sqrt(angle alpha).  A zero omega  *
+ * or alpha divides by zero and fails the build.                              *
+ ******************************************************************************/
+template <typename PARAMETERS>
+constexpr TURN_PLAN_t Turn_Plan(const PARAMETERS& turn, uint32_t rateHz) {
+    double angle = (turn.angle < 0) ? -turn.angle : turn.angle;
+    double omega = turn.omega;
+    double alpha = turn.alpha;
+    double peak = (angle * alpha < omega * omega) ? Turn_Sqrt(angle * alpha) : omega;
+    double ramp = peak / alpha;                         /* s */
+    double hold = (angle - peak * ramp) / peak;
+    double arc = turn.speed * (2 * ramp + hold);        /* mm */
+
+    TURN_PLAN_t plan{};
+    plan.RunIn = Profile_Steps(Profile_Move(turn.run_in, turn.speed, turn.speed, TURN_ACCELERATION), rateHz);
+    plan.RunInLong = Profile_Steps(Profile_Move(turn.run_in + TURN_TRIGGER_WINDOW_MM, turn.speed, turn.speed,
+                                                TURN_ACCELERATION), rateHz);
+    plan.Arc = Profile_Steps(Profile_Move(arc, turn.speed, turn.speed, TURN_ACCELERATION), rateHz);
+    plan.RunOut = Profile_Steps(Profile_Move(turn.run_out, turn.speed, turn.speed, TURN_ACCELERATION), rateHz);
+    plan.Rotation = Profile_Steps(Profile_Move(turn.angle, peak, 0, alpha), rateHz);
+    plan.Trigger = turn.trigger;
+    plan.RampTicks = (uint32_t)(ramp * rateHz + 0.5);
+    plan.OmegaTicks = (uint32_t)(hold * rateHz + 0.5);
+    plan.Ticks = 2 * plan.RampTicks + plan.OmegaTicks;
+    plan.ArcMm = (int32_t)(arc * 65536.0 + 0.5);
+    return plan;
+}
+
+}
+
+/*!
+* @brief Runs turn table entries on the forward and rotation profiles
+*
+* Its stage goes between the two profiles' in SCHED_PHASE_CONTROL, so the
+* rotation starts on the tick the arc does.
+*/
+class Turn {
+
+private:
+    Profile* _forward;
+    Profile* _rotation;
+    const TURN_PLAN_t* _plans;
+    uint8_t _count;
+
+    Turn_Sensor _sensor;
+    void* _sensorContext;
+
+    const TURN_PLAN_t* _plan;   // running or about to
+    volatile bool _pending;     // Start asked, the tick has not begun it yet
+    volatile uint8_t _state;
+    bool _triggered;            // this run in has a wall to trigger on
+    uint32_t _endMoves;         // forward moves finished when this phase ends
+    uint32_t _turns;
+
+    void Rotate(uint32_t moves);
+
+public:
+    Turn(Profile* forward, Profile* rotation, const TURN_PLAN_t* plans, uint8_t count);
+
+    void SetSensor(Turn_Sensor sensor, void* context);
+
+    bool Start(uint8_t index);  // false while a turn runs, or no such entry
+    void Update();              // tick side
+
+    uint8_t GetState();
+    bool IsFinished();          // idle, the forward profile runs on at the turn speed
+    uint32_t GetTurns();        // turns completed
+
+    // SCHED_PHASE_CONTROL stage, context is the Turn
+    static void OnTick(const SCHEDULER_TICK_t* tick, void* context);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TURN_H
@@ -10,31 +10,36 @@
  *     https://opensource.org/licenses/MIT.                                   *
  ******************************************************************************/
 #include "config.h"
-#include <stdio.h>
 #include "display.h"
+#include "textfield.h"
 #include "button.h"
 #include "led.h"
 #include "menu.h"
 #include "timer.h"
 #include "encoder.h"
+#include "syncsampler.h"
+#include "odometry.h"
+#include "profile.h"
+#include "turn.h"
+#include "scheduler.h"
+#include "motor.h"
+#include "battery.h"
 
 // Private forward function prototypes
 void GPIO_Init();
 void SystemClock_Config();
 void Error_Handler_Main();
 void CaptureButtonDownStates();
-uint8_t getUint32_tCharCnt(uint32_t value);
-uint8_t getFloat_CharCnt(float value, uint8_t places);
-void printChars(uint8_t cnt, char c);
-void printUint32_tAtWidth(uint32_t value, uint8_t width, char c, bool isRight);
-void printFloat_AtWidth(float value, uint8_t width, char c, bool isRight);
 
-// create object for OLED display
+// I2C1 bus, shared by the OLED and the EEPROM on the OLED-GYRO board
 // see config-blackpill.h for pin definitions
-Display display(SDA_PIN, SCL_PIN, I2C_MODULE_1); 
+I2C i2cBus(SDA_PIN, SCL_PIN, I2C_MODULE_1, I2C_TimingFor<CLOCK_PCLK1_HZ, I2C_SPEED_HZ>::Value);
+
+// create object for OLED display
+Display display(&i2cBus);
 
 // Global Fonts used for application
-FontDef_t Font_6x8 = {6, 8, Font6x8};
+FontDef_t Font_6x8 = Font6x8Packed.Def();
 
 // Button Objects PIN definitions in config-blackpill.h
 Button LeftButton(BUTTON_LEFT, GPIOA);
@@ -43,6 +48,14 @@ Button RightButton(BUTTON_RIGHT, GPIOA);
 Timer t2(2, 0, TIM_COUNTERMODE_UP, 65535, TIM_CLOCKDIVISION_DIV1, TIM_AUTORELOAD_PRELOAD_DISABLE);
 Timer t4(4, 0, TIM_COUNTERMODE_UP, 65535, TIM_CLOCKDIVISION_DIV1, TIM_AUTORELOAD_PRELOAD_DISABLE);
 
+// drive motors, both on TIM3; PIN definitions in config-blackpill.h
+Motor leftMotor(TIM3, 1, MOTOR_LEFT_IN1, GPIOA, 2, MOTOR_LEFT_IN2, GPIOA, GPIO_AF2_TIM3, ROBOT_MOTOR_LEFT_REVERSED);
+Motor rightMotor(TIM3, 3, MOTOR_RIGHT_IN1, GPIOB, 4, MOTOR_RIGHT_IN2, GPIOB, GPIO_AF2_TIM3, ROBOT_MOTOR_RIGHT_REVERSED);
+
+// supply monitor, PIN definitions in config-blackpill.h, divider in the robot config
+Battery battery(BATTERY_PIN, GPIOA, BATTERY_ADC_CHANNEL, Battery_MillivoltsPerCount(ADC_VREF_MV, ROBOT_BATTERY_DIVIDER),
+                ROBOT_BATTERY_LOW_MV, ROBOT_BATTERY_CRITICAL_MV);
+
 // LED Objects PIN definitions in config-blackpill.h
 Led LedLeft(LED_LEFT, GPIOB, true);
 Led LedRight(LED_RIGHT, GPIOB, true);
@@ -56,8 +69,9 @@ Led IRSideLeft(IR_SIDE_LEFT, GPIOB, true);
 
 // global score variables (TODO : Move to local scope to clean this up)
 char zz[30];
-uint32_t cntL = 0;
-uint32_t cntR = 0;
+int32_t cntL = 0;
+int32_t cntR = 0;
+int32_t batteryVolts = 0;      // Q8, for the display
 
 float angleL = 0.0;
 float angleR = 0.0;
@@ -72,9 +86,22 @@ int main()
     HAL_Init();
   	SystemClock_Config();
 
+    // cycle counter for the display / I2C timing stats
+    CYCLES_Init();
+
     // initialise the buttons / leds (slowly being deprecated as fucntionality moved to buttons and leds classes)
     GPIO_Init();
 
+    // motors off (coasting) before anything else can move them
+    constexpr MOTOR_PWM_t motorPwm = Motor_PwmFor<CLOCK_TIM3_HZ, ROBOT_MOTOR_PWM_HZ>::Value;
+    leftMotor.Init(motorPwm);
+    rightMotor.Init(motorPwm);
+    leftMotor.SetDecay(ROBOT_MOTOR_SLOW_DECAY ? MOTOR_DECAY_SLOW : MOTOR_DECAY_FAST);
+    rightMotor.SetDecay(ROBOT_MOTOR_SLOW_DECAY ? MOTOR_DECAY_SLOW : MOTOR_DECAY_FAST);
+
+    // supply voltage, converting from here on, filtered every control tick
+    battery.Init();
+
     // initialise LCD display
 	display.Init();  
 
@@ -93,6 +120,41 @@ int main()
     // initialise encoders
     leftWheel.Init();
     rightWheel.Init();
+    leftWheel.SetCountsPerRev(ROBOT_COUNTS_PER_WHEEL_REV);
+    rightWheel.SetCountsPerRev(ROBOT_COUNTS_PER_WHEEL_REV);
+
+    // control pipeline, run in the TIM1 interrupt; the loop below is background
+    Scheduler control(CONTROL_TICK_HZ);
+    control.Init();
+
+    // pose from the latched deltas, every control tick
+    constexpr ODOMETRY_CONFIG_t odometryConfig = Odometry_Config(ROBOT_WHEEL_DIAMETER_MM,
+        ROBOT_COUNTS_PER_WHEEL_REV, ROBOT_TRACK_WIDTH_MM, CONTROL_TICK_HZ);
+    Odometry odometry(odometryConfig);
+    control.Add(SCHED_PHASE_SAMPLE, Battery::OnTick, &battery, "battery");
+    control.Add(SCHED_PHASE_STATE, Odometry::OnTick, &odometry, "odometry");
+
+    // setpoints for forward (mm) and rotation (degrees) moves, idle until given one
+    Profile forward(CONTROL_TICK_HZ);
+    Profile rotation(CONTROL_TICK_HZ);
+
+    // the robot's turn table, worked out for the control tick by the compiler
+    static constexpr TURN_PLAN_t turnPlans[ROBOT_TURN_COUNT] = {
+        Turn_Plan(robotTurns[ROBOT_TURN_SS90L], CONTROL_TICK_HZ),
+        Turn_Plan(robotTurns[ROBOT_TURN_SS90R], CONTROL_TICK_HZ),
+    };
+    Turn turns(&forward, &rotation, turnPlans, ROBOT_TURN_COUNT);
+
+    // in this order: a turn sees the forward move that just started and starts
+    // the rotation on the same tick
+    control.Add(SCHED_PHASE_CONTROL, Profile::OnTick, &forward, "forward");
+    control.Add(SCHED_PHASE_CONTROL, Turn::OnTick, &turns, "turns");
+    control.Add(SCHED_PHASE_CONTROL, Profile::OnTick, &rotation, "rotation");
+
+    // both wheels latched together on the TIM1 control tick, which drives the pipeline
+    SyncSampler wheels(&leftWheel, &rightWheel, CLOCK_TIM1_HZ, CONTROL_TICK_HZ);
+    wheels.SetCallback(Scheduler::OnSample, &control);
+    wheels.Init();
 
     // menu system
     Menu menu(&LeftButton, &RightButton, &rightWheel, &display, Font_6x8);
@@ -121,6 +183,19 @@ int main()
     display.DrawRectangle (0, 16, 127, 47, COLOR_WHITE);
     display.UpdateScreen(); //display
 
+    // live values, each redrawn only when its text changes
+    TextField fieldL(&display, 5, 20, "L = ", 10, Font_6x8);
+    TextField fieldR(&display, 5, 30, "R = ", 10, Font_6x8);
+    TextField fieldAngle(&display, 5, 40, "Angle = ", 10, Font_6x8);
+    fieldL.BindInt(&cntL);
+    fieldR.BindInt(&cntR);
+    fieldAngle.BindFloat(&angleL, 4);
+
+    // pack voltage in the title bar, inverse when low, flashing when critical
+    TextField fieldBattery(&display, 79, 4, "", 6, Font_6x8);
+    fieldBattery.BindFixed(&batteryVolts, 8, 2);
+    DISPLAY_COLOR_t batteryColor = COLOR_WHITE;
+
     while (1)
     {
         i++;
@@ -129,22 +204,25 @@ int main()
         angleL = leftWheel.GetAngle();
 		angleR = rightWheel.GetAngle();
 
-        cntL = leftWheel.Read();
-        cntR = rightWheel.Read();
-
-        display.GotoXY (5,20);
-        display.Print("L = ", Font_6x8, COLOR_WHITE);
-        printUint32_tAtWidth(cntL, 10, ' ', false);      // cntL
-        
-        display.GotoXY (5,30);
-        display.Print("R = ", Font_6x8, COLOR_WHITE);
-        printUint32_tAtWidth(cntR, 10, ' ', false);
-
-        display.GotoXY (5,40);
-        display.Print("Angle = ", Font_6x8, COLOR_WHITE);
-        printFloat_AtWidth(angleL, 10, ' ', false);
+        SYNCSAMPLE_t sample = wheels.Snapshot();
+        cntL = sample.LeftPosition;
+        cntR = sample.RightPosition;
+
+        fieldL.Update();
+        fieldR.Update();
+        fieldAngle.Update();
+
+        batteryVolts = (battery.Millivolts() << 8) / 1000;
+        uint8_t level = battery.Level();
+        bool flash = (level == BATT_LEVEL_CRITICAL) && ((HAL_GetTick() / 250) & 1);
+        DISPLAY_COLOR_t color = (level == BATT_LEVEL_OK || flash) ? COLOR_WHITE : COLOR_BLACK;
+        if (color != batteryColor){
+            fieldBattery.SetColor(color);       // redraws the whole field
+            batteryColor = color;
+        }
+        fieldBattery.Update();
 
-        display.UpdateScreen(); //display"
+        display.UpdateScreenAsync(); //display, sends nothing if no field changed
 
         // press the left button
         if (LeftButton.Repeated()){
@@ -175,6 +253,24 @@ void GPIO_Init()
     __HAL_RCC_GPIOB_CLK_ENABLE();
 }
 
+// the clock tree in config-blackpill.h, checked before it reaches the PLL
+static_assert(CLOCK_HSE_HZ / CLOCK_PLLM >= 1000000 && CLOCK_HSE_HZ / CLOCK_PLLM <= 2000000, "PLL input must be 1-2 MHz");
+static_assert(CLOCK_HSE_HZ / CLOCK_PLLM * CLOCK_PLLN >= 100000000 &&
+              CLOCK_HSE_HZ / CLOCK_PLLM * CLOCK_PLLN <= 432000000, "PLL VCO must be 100-432 MHz");
+static_assert(CLOCK_PLLP == 2 || CLOCK_PLLP == 4 || CLOCK_PLLP == 6 || CLOCK_PLLP == 8, "PLLP is 2, 4, 6 or 8");
+static_assert(CLOCK_SYSCLK_HZ <= 100000000, "SYSCLK above 100 MHz, FLASH_LATENCY_3 covers up to 100 MHz");
+static_assert(CLOCK_PCLK1_HZ <= 50000000, "APB1 above 50 MHz");
+static_assert(CLOCK_TIM1_HZ % CONTROL_TICK_HZ == 0, "TIM1 can not divide down to the control tick exactly");
+static_assert(DRIVER_PWM_PERIOD == MOTOR_DUTY_FULL, "Motor::Set takes DRIVER_PWM_PERIOD as full scale");
+static_assert(CONTROL_TICK_HZ >= 1000 && CONTROL_TICK_HZ <= 2000, "control tick must be 1-2 kHz");
+
+// APB prescaler register value for a divider of 1, 2, 4, 8 or 16
+static constexpr uint32_t ApbDivider(uint32_t div)
+{
+    return div == 16 ? RCC_HCLK_DIV16 : div == 8 ? RCC_HCLK_DIV8 : div == 4 ? RCC_HCLK_DIV4 :
+           div == 2 ? RCC_HCLK_DIV2 : RCC_HCLK_DIV1;
+}
+
 void SystemClock_Config()
 {
     RCC_OscInitTypeDef RCC_OscInitStruct = {0};
@@ -192,10 +288,10 @@ void SystemClock_Config()
     RCC_OscInitStruct.HSEState = RCC_HSE_ON;
     RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
     RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
-    RCC_OscInitStruct.PLL.PLLM = 25;
-    RCC_OscInitStruct.PLL.PLLN = 192;
-    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
-    RCC_OscInitStruct.PLL.PLLQ = 4;
+    RCC_OscInitStruct.PLL.PLLM = CLOCK_PLLM;
+    RCC_OscInitStruct.PLL.PLLN = CLOCK_PLLN;
+    RCC_OscInitStruct.PLL.PLLP = CLOCK_PLLP;    // RCC_PLLP_DIVn is n
+    RCC_OscInitStruct.PLL.PLLQ = CLOCK_PLLQ;
     if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
     {
         Error_Handler_Main();
@@ -206,8 +302,8 @@ void SystemClock_Config()
     RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK|RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
     RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
     RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
-    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+    RCC_ClkInitStruct.APB1CLKDivider = ApbDivider(CLOCK_APB1_DIV);
+    RCC_ClkInitStruct.APB2CLKDivider = ApbDivider(CLOCK_APB2_DIV);
 
     if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_3) != HAL_OK)
     {
@@ -229,93 +325,3 @@ void CaptureButtonDownStates(){
     LeftButton.CaptureDownState();
     RightButton.CaptureDownState();
 }
-
-uint8_t getUint32_tCharCnt(uint32_t value){
-
-    if (value==0){return 1;}
-    uint32_t tensCalc = 10;
-    uint8_t cnt = 1;
-
-    while (tensCalc <= value && cnt < 20){
-        tensCalc *= 10;
-        cnt += 1;
-    }
-
-    return cnt;
-}
-
-uint8_t getFloat_CharCnt(float value, uint8_t places){
-
-    if (value==0){return 1;}
-    uint8_t cnt = 1;
-
-    //float dum = 167.1234567;
-    // two components to a float: integer part, decimal part (4 decimal places only maybe!)
-    // integer component
-    int tmpInt = value;
-    int tmpNew = 0;
-    cnt = getUint32_tCharCnt(tmpInt);   // this gets the length of the integer component
-
-    // next we need to remove the integer component and leave the decimal
-    // 0.1234567
-    // iterate through decimal number by the number of decimal places asked for
-    float tmpDec = value - tmpInt;
-
-    for (int i=0; i < places; i++){
-        tmpNew = tmpDec * 10;  //1.234567
-        tmpDec = tmpDec - tmpNew;  //0.234567
-        cnt++;
-    }
-
-    return ++cnt;   // need to include a decimal point
-}
-
-void printChars(uint8_t cnt, char c){
-    if (cnt > 0){
-        char cc[] = " "; cc[0] = c;
-        for (uint8_t i = 1; i <= cnt; i++) {display.Print(cc, Font_6x8, COLOR_WHITE);}
-    }
-}
-
-void printUint32_tAtWidth(uint32_t value, uint8_t width, char c, bool isRight){
-    uint8_t numChars = getUint32_tCharCnt(value);
-    char str[numChars];
-    sprintf(str,"%d", value);
-
-    if (isRight){printChars(width-numChars, c);}
-    display.Print(str, Font_6x8, COLOR_WHITE);
-    if (!isRight){printChars(width-numChars, c);}
-}
-
-void printFloat_AtWidth(float value, uint8_t width, char c, bool isRight){
-
-    uint8_t numChars = getFloat_CharCnt(value, 4);
-    char str[numChars];
-    char dec[4];
-    dec[0] = ' ';
-    dec[1] = ' ';
-    dec[2] = ' ';
-    dec[3] = ' ';
-    dec[4] = ' ';  //needed to prevent a dodgy character being displayed.  not sure why!!!
-
-    int tmpInt1 = value;  // Get the integer (678).
-    float tmpFrac = value - (float)tmpInt1; // Get fraction (0.0123).
-    int tmpInt2 = tmpFrac*10000;
-
-    if (isRight){printChars(width-numChars, c);}
-    //print first part of number
-    sprintf (str, "%d.", tmpInt1);
-    display.Print(str, Font_6x8, COLOR_WHITE);
-
-    for (int i = 0; i < 4; i++){
-        // need to move the number up by 10 and print the actual number
-        tmpFrac = tmpFrac * (float)10;  // 0.1 becomes 1.0 and so on
-        tmpInt2 = tmpFrac;          // get the integer component
-        dec[i] = (char)(tmpInt2+ '0');
-        tmpFrac = tmpFrac - (float)tmpInt2;
-    }
-    display.Print(dec, Font_6x8, COLOR_WHITE);
-
-    if (!isRight){printChars(width-numChars, c);}
-    
-}
@@ -0,0 +1,225 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Peripheral memory, the HAL stand-ins, time and interrupts for the native   *
+ * build.  The I2C1/DMA1 bus model is in native_i2c.cpp.                      *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "native.h"
+
+/* interrupts taken back to back before the model gives up on a handler that
+   never clears its flag */
+#define NATIVE_IRQ_LIMIT    64
+
+static GPIO_TypeDef gpio[4];
+static I2C_TypeDef i2c[2];
+static TIM_TypeDef tim[5];
+static DMA_TypeDef dma[2];
+static DMA_Stream_TypeDef dmaStream[8];
+static DMA_Stream_TypeDef dma2Stream0;
+static RCC_TypeDef rcc;
+static ADC_TypeDef adc1;
+static ADC_Common_TypeDef adcCommon;
+static DWT_Type dwt;
+static CoreDebug_Type coreDebug;
+
+GPIO_TypeDef *GPIOA = &gpio[0], *GPIOB = &gpio[1], *GPIOC = &gpio[2], *GPIOH = &gpio[3];
+I2C_TypeDef *I2C1 = &i2c[0], *I2C2 = &i2c[1];
+TIM_TypeDef *TIM1 = &tim[0], *TIM2 = &tim[1], *TIM3 = &tim[2], *TIM4 = &tim[3], *TIM5 = &tim[4];
+DMA_TypeDef *DMA1 = &dma[0], *DMA2 = &dma[1];
+DMA_Stream_TypeDef *DMA1_Stream0 = &dmaStream[0], *DMA1_Stream1 = &dmaStream[1];
+DMA_Stream_TypeDef *DMA1_Stream2 = &dmaStream[2], *DMA1_Stream3 = &dmaStream[3];
+DMA_Stream_TypeDef *DMA1_Stream5 = &dmaStream[5], *DMA1_Stream6 = &dmaStream[6];
+DMA_Stream_TypeDef *DMA1_Stream7 = &dmaStream[7], *DMA2_Stream0 = &dma2Stream0;
+RCC_TypeDef *RCC = &rcc;
+ADC_TypeDef *ADC1 = &adc1;
+ADC_Common_TypeDef *ADC1_COMMON = &adcCommon;
+DWT_Type *DWT = &dwt;
+CoreDebug_Type *CoreDebug = &coreDebug;
+
+uint32_t SystemCoreClock = 96000000;
+
+uint32_t native_primask;
+uint8_t native_nvicPriority[96];
+bool native_nvicEnabled[96];
+uint32_t native_tick;
+
+static uint32_t cycles;
+static uint8_t irqDepth;        // handlers running, they do not nest
+
+void NATIVE_Reset(uint32_t start){
+    memset(gpio, 0, sizeof(gpio));
+    memset(i2c, 0, sizeof(i2c));
+    memset(tim, 0, sizeof(tim));
+    memset(dma, 0, sizeof(dma));
+    memset(dmaStream, 0, sizeof(dmaStream));
+    memset(&dma2Stream0, 0, sizeof(dma2Stream0));
+    memset(&rcc, 0, sizeof(rcc));
+    memset(&adc1, 0, sizeof(adc1));
+    memset(&adcCommon, 0, sizeof(adcCommon));
+    memset(&dwt, 0, sizeof(dwt));
+    memset(&coreDebug, 0, sizeof(coreDebug));
+    memset(native_nvicPriority, 0, sizeof(native_nvicPriority));
+    memset(native_nvicEnabled, 0, sizeof(native_nvicEnabled));
+
+    native_primask = 0;
+    native_tick = 0;
+    irqDepth = 0;
+    cycles = start;
+    NATIVE_I2C_Reset();
+}
+
+uint32_t NATIVE_Cycles(void){
+    return cycles;
+}
+
+/* one read of CYCCNT: time moves on, the bus catches up, pending interrupts run */
+static void Step(void){
+    cycles += NATIVE_CYCLES_PER_READ;
+    NATIVE_I2C_Advance(cycles);
+
+    if (native_primask || irqDepth){
+        return;
+    }
+    for (uint8_t i = 0; i < NATIVE_IRQ_LIMIT; i++){
+        NATIVE_Handler handler = NATIVE_I2C_Pending();
+        if (!handler){
+            break;
+        }
+        irqDepth++;
+        handler();
+        irqDepth--;
+    }
+}
+
+void NATIVE_Run(uint32_t span){
+    uint32_t end = cycles + span;
+    while ((int32_t)(end - cycles) > 0){
+        Step();
+    }
+}
+
+/******************************************************************************
+ * The firmware casts buffer pointers to uint32_t for the DMA address         *
+ * registers.  On a 64 bit host the high half is gone, so take it back from   *
+ * whichever of the stack, the program image or the heap the address lies    *
+ * nearest to.                                                                *
+ ******************************************************************************/
+void* NATIVE_Pointer(uint32_t address){
+    if (sizeof(void*) == sizeof(uint32_t)){
+        return (void*)(uintptr_t)address;
+    }
+
+    static void* heap = malloc(1);
+    uint8_t local;
+    uint64_t anchors[3] = {(uint64_t)(uintptr_t)&local, (uint64_t)(uintptr_t)&cycles, (uint64_t)(uintptr_t)heap};
+    uint64_t best = address;
+    uint64_t bestDistance = ~0ULL;
+
+    for (uint8_t a = 0; a < 3; a++){
+        for (int64_t half = -1; half <= 1; half++){
+            uint64_t candidate = (((anchors[a] >> 32) + half) << 32) | address;
+            uint64_t distance = (candidate > anchors[a]) ? candidate - anchors[a] : anchors[a] - candidate;
+            if (distance < bestDistance){
+                best = candidate;
+                bestDistance = distance;
+            }
+        }
+    }
+    return (void*)(uintptr_t)best;
+}
+
+/******************************************************************************
+ * Registers with side effects                                                *
+ ******************************************************************************/
+uint32_t NATIVE_RegRead(NATIVE_REG* reg){
+    uint32_t value;
+
+    if (reg == &dwt.CYCCNT){
+        Step();
+        return cycles;
+    }
+    if (NATIVE_I2C_Read(reg, &value)){
+        return value;
+    }
+    return reg->Value;
+}
+
+void NATIVE_RegWrite(NATIVE_REG* reg, uint32_t value){
+    if (reg == &dwt.CYCCNT){
+        cycles = value;
+        return;
+    }
+
+    // interrupt flag clear registers: write 1 to clear in the status word two up
+    for (uint8_t d = 0; d < 2; d++){
+        if (reg == &dma[d].LIFCR || reg == &dma[d].HIFCR){
+            (reg - 2)->Value &= ~value;
+            return;
+        }
+    }
+
+    if (!NATIVE_I2C_Write(reg, value)){
+        reg->Value = value;
+    }
+}
+
+/******************************************************************************
+ * HAL                                                                        *
+ ******************************************************************************/
+HAL_StatusTypeDef HAL_Init(void){ return HAL_OK; }
+void HAL_IncTick(void){ native_tick++; }
+uint32_t HAL_GetTick(void){ return native_tick; }
+void HAL_Delay(uint32_t delay){ native_tick += delay; }
+
+void HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init){ (void)port; (void)init; }
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state){
+    port->ODR = state ? (port->ODR | pin) : (port->ODR & ~pin);
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin){
+    return (port->IDR & pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* port, uint16_t pin){
+    port->ODR ^= pin;
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Init(TIM_HandleTypeDef* htim, TIM_Encoder_InitTypeDef* config){
+    (void)htim; (void)config;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef* htim, uint32_t channel){
+    (void)htim; (void)channel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim){ (void)htim; return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim){ (void)htim; return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef* htim){ (void)htim; return HAL_OK; }
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef* htim, TIM_MasterConfigTypeDef* config){
+    (void)htim; (void)config;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef* config){ (void)config; return HAL_OK; }
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef* config, uint32_t latency){
+    (void)config; (void)latency;
+    return HAL_OK;
+}
+
+/* the BlackPill clock tree */
+uint32_t HAL_RCC_GetHCLKFreq(void){ return 96000000; }
+uint32_t HAL_RCC_GetPCLK1Freq(void){ return 48000000; }
+uint32_t HAL_RCC_GetPCLK2Freq(void){ return 96000000; }
@@ -0,0 +1,97 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Host model of the few peripherals the firmware's timing and bus code       *
+ * depend on, so the native tests run the real drivers unchanged:             *
+ *                                                                            *
+ *   - DWT CYCCNT is the clock.  Every read moves time on by                  *
+ *     NATIVE_CYCLES_PER_READ, so the firmware's own spin loops (all of them  *
+ *     read CYCLES_Now) are what drive the model.                             *
+ *   - I2C1 as a master, at the SCL rate its CCR/FREQ give, with its TX and   *
+ *     RX DMA streams (DMA1 stream 6 and stream 0).  Flags, SCL stretching,   *
+ *     ACK/POS/LAST and STOP/START timing follow RM0383 18.3.                 *
+ *   - Interrupts are level triggered and taken while time moves on, unless   *
+ *     PRIMASK is set or a handler is already running (one priority level).   *
+ *                                                                            *
+ * Only I2C1 is modelled; the other peripherals are plain registers.          *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "stm32f4xx.h"
+
+/* core cycles a read of DWT->CYCCNT takes, i.e. the model's time step */
+#ifndef NATIVE_CYCLES_PER_READ
+#define NATIVE_CYCLES_PER_READ  12
+#endif
+
+/* the bus timing for the modelled clock tree (PCLK1 48 MHz, see
+   HAL_RCC_GetPCLK1Freq) at 400 kHz, for tests that include i2ctiming.h */
+#define NATIVE_I2C_TIMING       (I2C_TimingFor<48000000, 400000>::Value)
+
+/* devices that can be attached to the bus at once */
+#define NATIVE_I2C_DEVICES      4
+
+/* what a device listener is told, value is the byte on the wire */
+#define NATIVE_I2C_START        0   // addressed (START or repeated START), value = address byte
+#define NATIVE_I2C_WRITE        1   // byte from the master
+#define NATIVE_I2C_READ         2   // byte to the master
+#define NATIVE_I2C_STOP         3
+
+typedef void (*NATIVE_I2C_Listener)(uint8_t event, uint8_t value, void* context);
+
+/******************************************************************************
+ * A device that ACKs its address and every byte.  A write's first RegLen     *
+ * bytes set Pointer (high byte first), the rest are stored from it on; a     *
+ * read returns Memory from Pointer on.  Pointer wraps at 256.                *
+ ******************************************************************************/
+typedef struct {
+    uint8_t Saddr;              // 7 bit address
+    uint8_t RegLen;             // 0, 1 or 2
+    uint16_t Pointer;
+    uint8_t Memory[256];
+    NATIVE_I2C_Listener Listener;   // optional
+    void* Context;
+} NATIVE_I2C_DEVICE_t;
+
+/* what happened on the wire */
+typedef struct {
+    uint32_t Starts;            // repeated STARTs included
+    uint32_t Stops;
+    uint32_t Written;           // bytes after the address, master to device
+    uint32_t Read;              // bytes device to master
+    uint32_t Nacks;             // addresses no device answered
+    uint32_t BusyCycles;        // START to STOP, summed
+} NATIVE_I2C_STATS_t;
+
+extern uint32_t native_tick;    // HAL_GetTick
+
+/* registers, time, interrupts, the bus and its devices back to power on; the
+   cycle counter starts at 'cycles' so a test can run across its wrap */
+void NATIVE_Reset(uint32_t cycles = 0);
+
+uint32_t NATIVE_Cycles(void);           // the cycle counter, without moving time on
+void NATIVE_Run(uint32_t cycles);       // time passes, interrupts are taken
+
+/* a DMA address register holds 32 bits: the host pointer it came from */
+void* NATIVE_Pointer(uint32_t address);
+
+void NATIVE_I2C_Attach(NATIVE_I2C_DEVICE_t* device);   // on the bus until NATIVE_Reset
+NATIVE_I2C_STATS_t NATIVE_I2C_GetStats(void);
+
+/* model internals, between native.cpp and native_i2c.cpp */
+typedef void (*NATIVE_Handler)(void);
+void NATIVE_I2C_Reset(void);
+void NATIVE_I2C_Advance(uint32_t now);
+NATIVE_Handler NATIVE_I2C_Pending(void);
+bool NATIVE_I2C_Read(NATIVE_REG* reg, uint32_t* value);
+bool NATIVE_I2C_Write(NATIVE_REG* reg, uint32_t value);
+
+#endif // NATIVE_H
@@ -0,0 +1,422 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * I2C1 master and its DMA1 streams (TX stream 6, RX stream 0), byte timed.   *
+ * One thing is on the wire at a time: a START, the address byte, a data      *
+ * byte or a STOP, each taking its SCL time.  Between them SCL is stretched   *
+ * until the firmware (or the DMA) has done its part, as on the chip:         *
+ *                                                                            *
+ *   START -> SB, until DR is written with the address                        *
+ *   address -> ADDR (or AF with no device), until SR2 is read               *
+ *   transmit: DR moves to the shift register as it empties (TXE); with       *
+ *             nothing to send BTF is set and SCL held                        *
+ *   receive:  each byte lands in DR (RXNE), or waits in the shift register   *
+ *             (BTF) while DR is full; the ACK bit is CR1 ACK at the end of   *
+ *             the byte, POS ACKs the first, LAST with DMA NACKs the final    *
+ *   START/STOP set in CR1 go out at the next byte boundary                   *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <string.h>
+#include "native.h"
+
+/* the vectors, for builds that do not link the I2C driver */
+extern "C" __attribute__((weak)) void I2C1_EV_IRQHandler(void) {}
+extern "C" __attribute__((weak)) void I2C1_ER_IRQHandler(void) {}
+extern "C" __attribute__((weak)) void DMA1_Stream6_IRQHandler(void) {}
+extern "C" __attribute__((weak)) void DMA1_Stream0_IRQHandler(void) {}
+
+/* stream flag positions in DMA1 HISR / LISR */
+#define TX_FLAG_SHIFT   16
+#define RX_FLAG_SHIFT   0
+#define FLAG_TEIF       (1 << 3)
+#define FLAG_TCIF       (1 << 5)
+
+/* what is on the wire */
+#define WIRE_NONE       0
+#define WIRE_START      1
+#define WIRE_ADDRESS    2
+#define WIRE_WRITE      3
+#define WIRE_READ       4
+#define WIRE_STOP       5
+
+/* where the master is */
+#define PHASE_IDLE      0   // bus free
+#define PHASE_SB        1   // START sent, waiting for the address in DR
+#define PHASE_ADDR      2   // address ACKed, waiting for SR2 to be read
+#define PHASE_TX        3
+#define PHASE_RX        4
+#define PHASE_NACKED    5   // address not ACKed, waiting for STOP or START
+
+static struct {
+    uint8_t wire;
+    uint32_t due;               // when the thing on the wire is done
+    uint32_t busySince;         // START of the transaction
+    uint8_t phase;
+    uint8_t address;            // address byte, R/W in bit 0
+    NATIVE_I2C_DEVICE_t* device;
+    bool drFull;                // transmit: DR holds a byte not yet shifted
+    uint8_t shift;              // byte on the wire, or held in the shift register
+    bool held;                  // receive: a byte waits in the shift register
+    bool ended;                 // receive: the last byte was NACKed
+    bool first;                 // receive: next byte is the first
+    uint8_t regLeft;            // pointer bytes still to come in this write
+} bus;
+
+static NATIVE_I2C_DEVICE_t* devices[NATIVE_I2C_DEVICES];
+static NATIVE_I2C_STATS_t stats;
+
+void NATIVE_I2C_Reset(void){
+    memset(&bus, 0, sizeof(bus));
+    memset(devices, 0, sizeof(devices));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void NATIVE_I2C_Attach(NATIVE_I2C_DEVICE_t* device){
+    for (uint8_t i = 0; i < NATIVE_I2C_DEVICES; i++){
+        if (!devices[i]){
+            devices[i] = device;
+            return;
+        }
+    }
+}
+
+NATIVE_I2C_STATS_t NATIVE_I2C_GetStats(void){
+    return stats;
+}
+
+static void Listen(uint8_t event, uint8_t value){
+    if (bus.device && bus.device->Listener){
+        bus.device->Listener(event, value, bus.device->Context);
+    }
+}
+
+/* one SCL period in core cycles, from the timing the driver programmed */
+static uint32_t BitCycles(void){
+    uint32_t freq = I2C1->CR2.Value & I2C_CR2_FREQ;
+    uint32_t ccr = I2C1->CCR.Value;
+    uint32_t period = (ccr & I2C_CCR_CCR) * ((ccr & I2C_CCR_FS) ? ((ccr & I2C_CCR_DUTY) ? 25 : 3) : 2);
+
+    if (freq == 0 || period == 0){
+        return SystemCoreClock / 100000;
+    }
+    return (uint32_t)((uint64_t)period * SystemCoreClock / (freq * 1000000ULL));
+}
+
+static void Put(uint8_t wire, uint32_t now, uint32_t bits){
+    bus.wire = wire;
+    bus.due = now + bits * BitCycles();
+}
+
+/* a byte into DR, from the firmware or the TX stream */
+static void LoadDR(uint8_t value){
+    I2C1->DR.Value = value;
+    bus.drFull = true;
+    I2C1->SR1.Value &= ~(I2C_SR1_TXE | I2C_SR1_BTF);
+}
+
+/* DR read while receiving: the held byte moves up */
+static uint8_t TakeDR(void){
+    uint8_t value = (uint8_t)I2C1->DR.Value;
+
+    if (I2C1->SR1.Value & I2C_SR1_RXNE){
+        I2C1->SR1.Value &= ~(I2C_SR1_RXNE | I2C_SR1_BTF);
+        if (bus.held){
+            bus.held = false;
+            I2C1->DR.Value = bus.shift;
+            I2C1->SR1.Value |= I2C_SR1_RXNE;
+        }
+    }
+    return value;
+}
+
+/* one DMA request each way, when the peripheral asks for it */
+static void ServiceDMA(void){
+    DMA_Stream_TypeDef* tx = DMA1_Stream6;
+    DMA_Stream_TypeDef* rx = DMA1_Stream0;
+
+    if (!(I2C1->CR2.Value & I2C_CR2_DMAEN)){
+        return;
+    }
+
+    if (bus.phase == PHASE_TX && !bus.drFull && (tx->CR & DMA_SxCR_EN) && tx->NDTR > 0){
+        LoadDR(*(uint8_t*)NATIVE_Pointer(tx->M0AR));
+        if (tx->CR & DMA_SxCR_MINC){
+            tx->M0AR++;
+        }
+        if (--tx->NDTR == 0){
+            tx->CR &= ~DMA_SxCR_EN;
+            DMA1->HISR.Value |= FLAG_TCIF << TX_FLAG_SHIFT;
+        }
+    }
+
+    if ((I2C1->SR1.Value & I2C_SR1_RXNE) && (rx->CR & DMA_SxCR_EN) && rx->NDTR > 0){
+        *(uint8_t*)NATIVE_Pointer(rx->M0AR) = TakeDR();
+        if (rx->CR & DMA_SxCR_MINC){
+            rx->M0AR++;
+        }
+        if (--rx->NDTR == 0){
+            rx->CR &= ~DMA_SxCR_EN;
+            DMA1->LISR.Value |= FLAG_TCIF << RX_FLAG_SHIFT;
+        }
+    }
+}
+
+static NATIVE_I2C_DEVICE_t* Find(uint8_t saddr){
+    for (uint8_t i = 0; i < NATIVE_I2C_DEVICES; i++){
+        if (devices[i] && devices[i]->Saddr == saddr){
+            return devices[i];
+        }
+    }
+    return 0;
+}
+
+/* the thing on the wire has finished */
+static void Finish(void){
+    uint32_t cr1 = I2C1->CR1.Value;
+    uint32_t cr2 = I2C1->CR2.Value;
+    uint8_t done = bus.wire;
+
+    bus.wire = WIRE_NONE;
+    switch (done){
+        case WIRE_START:
+            I2C1->CR1.Value &= ~I2C_CR1_START;
+            I2C1->SR1.Value = (I2C1->SR1.Value & ~(I2C_SR1_TXE | I2C_SR1_BTF | I2C_SR1_RXNE)) | I2C_SR1_SB;
+            if (!(I2C1->SR2.Value & I2C_SR2_BUSY)){
+                bus.busySince = bus.due;
+            }
+            I2C1->SR2.Value |= I2C_SR2_BUSY | I2C_SR2_MSL;
+            bus.phase = PHASE_SB;
+            stats.Starts++;
+            break;
+
+        case WIRE_ADDRESS:
+            bus.device = Find(bus.address >> 1);
+            if (!bus.device){
+                I2C1->SR1.Value |= I2C_SR1_AF;
+                bus.phase = PHASE_NACKED;
+                stats.Nacks++;
+                break;
+            }
+            if (!(bus.address & 1)){
+                bus.regLeft = bus.device->RegLen;
+                if (bus.regLeft){
+                    bus.device->Pointer = 0;
+                }
+            }
+            I2C1->SR1.Value |= I2C_SR1_ADDR;
+            bus.phase = PHASE_ADDR;
+            Listen(NATIVE_I2C_START, bus.address);
+            break;
+
+        case WIRE_WRITE:
+            if (bus.regLeft){
+                bus.device->Pointer = (uint16_t)((bus.device->Pointer << 8) | bus.shift);
+                bus.regLeft--;
+            } else {
+                bus.device->Memory[bus.device->Pointer++ & 0xFF] = bus.shift;
+            }
+            stats.Written++;
+            Listen(NATIVE_I2C_WRITE, bus.shift);
+            break;
+
+        case WIRE_READ: {
+            bool full = I2C1->SR1.Value & I2C_SR1_RXNE;
+            bool ack = cr1 & I2C_CR1_ACK;
+            DMA_Stream_TypeDef* rx = DMA1_Stream0;
+
+            if (bus.first && (cr1 & I2C_CR1_POS)){
+                ack = true;             // POS: the cleared ACK is for the byte after
+            }
+            if ((cr2 & I2C_CR2_LAST) && (cr2 & I2C_CR2_DMAEN) && (rx->CR & DMA_SxCR_EN) && rx->NDTR == (full ? 2u : 1u)){
+                ack = false;            // the DMA's final byte
+            }
+            bus.first = false;
+            bus.ended = !ack;
+
+            if (full){
+                bus.held = true;
+                I2C1->SR1.Value |= I2C_SR1_BTF;
+            } else {
+                I2C1->DR.Value = bus.shift;
+                I2C1->SR1.Value |= I2C_SR1_RXNE;
+            }
+            stats.Read++;
+            Listen(NATIVE_I2C_READ, bus.shift);
+            break;
+        }
+
+        case WIRE_STOP:
+            I2C1->CR1.Value &= ~I2C_CR1_STOP;
+            I2C1->SR1.Value &= ~(I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_TXE | I2C_SR1_BTF);
+            I2C1->SR2.Value &= ~(I2C_SR2_BUSY | I2C_SR2_MSL);
+            bus.phase = PHASE_IDLE;
+            stats.Stops++;
+            stats.BusyCycles += bus.due - bus.busySince;
+            Listen(NATIVE_I2C_STOP, 0);
+            bus.device = 0;
+            break;
+    }
+}
+
+/* puts the next thing on the wire, false while SCL is held */
+static bool Begin(uint32_t now){
+    uint32_t cr1 = I2C1->CR1.Value;
+
+    switch (bus.phase){
+        case PHASE_IDLE:
+            if (cr1 & I2C_CR1_START){
+                Put(WIRE_START, now, 1);
+                return true;
+            }
+            return false;
+
+        case PHASE_TX:
+            if (bus.drFull){
+                bus.shift = (uint8_t)I2C1->DR.Value;
+                bus.drFull = false;
+                I2C1->SR1.Value |= I2C_SR1_TXE;
+                Put(WIRE_WRITE, now, 9);
+                return true;
+            }
+            I2C1->SR1.Value |= I2C_SR1_BTF;
+            break;
+
+        case PHASE_RX:
+            if (!bus.ended && !bus.held){
+                bus.shift = bus.device->Memory[bus.device->Pointer++ & 0xFF];
+                Put(WIRE_READ, now, 9);
+                return true;
+            }
+            break;
+
+        case PHASE_NACKED:
+            break;
+
+        default:
+            return false;               // SB or ADDR, the firmware's turn
+    }
+
+    // at a byte boundary with nothing more to clock: STOP or repeated START
+    if (cr1 & I2C_CR1_STOP){
+        Put(WIRE_STOP, now, 1);
+        return true;
+    }
+    if (cr1 & I2C_CR1_START){
+        Put(WIRE_START, now, 1);
+        return true;
+    }
+    return false;
+}
+
+void NATIVE_I2C_Advance(uint32_t now){
+    if (!(I2C1->CR1.Value & I2C_CR1_PE)){
+        return;
+    }
+
+    for (;;){
+        ServiceDMA();
+        if (bus.wire != WIRE_NONE){
+            if ((int32_t)(now - bus.due) < 0){
+                return;
+            }
+            Finish();
+            continue;
+        }
+        if (!Begin(now)){
+            return;
+        }
+    }
+}
+
+NATIVE_Handler NATIVE_I2C_Pending(void){
+    uint32_t cr2 = I2C1->CR2.Value;
+    uint32_t sr1 = I2C1->SR1.Value;
+    uint32_t tx = DMA1->HISR.Value >> TX_FLAG_SHIFT;
+    uint32_t rx = DMA1->LISR.Value >> RX_FLAG_SHIFT;
+
+    if ((cr2 & I2C_CR2_ITERREN) && (sr1 & (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | I2C_SR1_OVR))){
+        return I2C1_ER_IRQHandler;
+    }
+    if ((cr2 & I2C_CR2_ITEVTEN) && ((sr1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF)) ||
+                                     ((cr2 & I2C_CR2_ITBUFEN) && (sr1 & (I2C_SR1_TXE | I2C_SR1_RXNE))))){
+        return I2C1_EV_IRQHandler;
+    }
+    if (((tx & FLAG_TCIF) && (DMA1_Stream6->CR & DMA_SxCR_TCIE)) || ((tx & FLAG_TEIF) && (DMA1_Stream6->CR & DMA_SxCR_TEIE))){
+        return DMA1_Stream6_IRQHandler;
+    }
+    if (((rx & FLAG_TCIF) && (DMA1_Stream0->CR & DMA_SxCR_TCIE)) || ((rx & FLAG_TEIF) && (DMA1_Stream0->CR & DMA_SxCR_TEIE))){
+        return DMA1_Stream0_IRQHandler;
+    }
+    return 0;
+}
+
+/******************************************************************************
+ * Register side effects                                                      *
+ ******************************************************************************/
+bool NATIVE_I2C_Read(NATIVE_REG* reg, uint32_t* value){
+    if (reg == &I2C1->DR){
+        *value = TakeDR();
+        return true;
+    }
+
+    if (reg == &I2C1->SR2){
+        // SR1 then SR2 clears ADDR, and the transfer goes on
+        *value = reg->Value;
+        if (I2C1->SR1.Value & I2C_SR1_ADDR){
+            I2C1->SR1.Value &= ~I2C_SR1_ADDR;
+            if (bus.address & 1){
+                bus.phase = PHASE_RX;
+                bus.first = true;
+                bus.ended = false;
+                bus.held = false;
+            } else {
+                bus.phase = PHASE_TX;
+                I2C1->SR1.Value |= I2C_SR1_TXE;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool NATIVE_I2C_Write(NATIVE_REG* reg, uint32_t value){
+    if (reg == &I2C1->DR){
+        if (bus.phase == PHASE_SB){
+            // SB is cleared by the address write
+            I2C1->DR.Value = value;
+            I2C1->SR1.Value &= ~I2C_SR1_SB;
+            bus.address = (uint8_t)value;
+            bus.phase = PHASE_ADDR;
+            bus.device = 0;
+            Put(WIRE_ADDRESS, NATIVE_Cycles(), 9);
+        } else if (bus.phase == PHASE_TX){
+            LoadDR((uint8_t)value);
+        } else {
+            I2C1->DR.Value = value;
+        }
+        return true;
+    }
+
+    if (reg == &I2C1->CR1){
+        reg->Value = value;
+        if ((value & I2C_CR1_SWRST) || !(value & I2C_CR1_PE)){
+            // reset or disabled: the master lets go of the bus
+            bool swrst = value & I2C_CR1_SWRST;
+            memset(&bus, 0, sizeof(bus));
+            I2C1->SR1.Value = 0;
+            I2C1->SR2.Value = 0;
+            if (swrst){
+                I2C1->CR2.Value = 0;
+                I2C1->CCR.Value = 0;
+                I2C1->TRISE.Value = 2;
+            }
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,250 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Host stand-in for the CMSIS device header, [env:native] only.  Just the    *
+ * registers, bits and core functions the firmware uses, laid out as on the   *
+ * STM32F411.  Registers the bus model has to see (I2C, DMA flags, DWT        *
+ * CYCCNT) are NATIVE_REG, which hands reads and writes to native.cpp; the    *
+ * rest are plain memory the tests can poke.  See native.h.                   *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __IO volatile
+
+/* a register with side effects, modelled in native.cpp */
+struct NATIVE_REG;
+uint32_t NATIVE_RegRead(NATIVE_REG* reg);
+void NATIVE_RegWrite(NATIVE_REG* reg, uint32_t value);
+
+struct NATIVE_REG {
+    uint32_t Value;
+
+    operator uint32_t() { return NATIVE_RegRead(this); }
+    NATIVE_REG& operator=(uint32_t value) { NATIVE_RegWrite(this, value); return *this; }
+    NATIVE_REG& operator|=(uint32_t value) { NATIVE_RegWrite(this, Value | value); return *this; }
+    NATIVE_REG& operator&=(uint32_t value) { NATIVE_RegWrite(this, Value & value); return *this; }
+};
+
+/******************************************************************************
+ * Register blocks                                                            *
+ ******************************************************************************/
+typedef struct { __IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2]; } GPIO_TypeDef;
+typedef struct { NATIVE_REG CR1, CR2, OAR1, OAR2, DR, SR1, SR2, CCR, TRISE, FLTR; } I2C_TypeDef;
+typedef struct { __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR,
+                 CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR, OR; } TIM_TypeDef;
+typedef struct { __IO uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR; } DMA_Stream_TypeDef;
+typedef struct { NATIVE_REG LISR, HISR, LIFCR, HIFCR; } DMA_TypeDef;
+typedef struct { __IO uint32_t CR, PLLCFGR, CFGR, CIR, AHB1RSTR, AHB2RSTR, RESERVED0[2], APB1RSTR, APB2RSTR,
+                 RESERVED1[2], AHB1ENR, AHB2ENR, RESERVED2[2], APB1ENR, APB2ENR; } RCC_TypeDef;
+typedef struct { __IO uint32_t SR, CR1, CR2, SMPR1, SMPR2, JOFR1, JOFR2, JOFR3, JOFR4, HTR, LTR, SQR1, SQR2, SQR3,
+                 JSQR, JDR1, JDR2, JDR3, JDR4, DR; } ADC_TypeDef;
+typedef struct { __IO uint32_t CSR, CCR, CDR; } ADC_Common_TypeDef;
+typedef struct { NATIVE_REG CTRL, CYCCNT; } DWT_Type;
+typedef struct { __IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR; } CoreDebug_Type;
+
+typedef enum {
+    SysTick_IRQn        = -1,
+    DMA1_Stream0_IRQn   = 11,
+    DMA1_Stream2_IRQn   = 13,
+    DMA1_Stream3_IRQn   = 14,
+    DMA1_Stream5_IRQn   = 16,
+    DMA1_Stream6_IRQn   = 17,
+    ADC_IRQn            = 18,
+    TIM1_UP_TIM10_IRQn  = 25,
+    TIM2_IRQn           = 28,
+    TIM3_IRQn           = 29,
+    TIM4_IRQn           = 30,
+    I2C1_EV_IRQn        = 31,
+    I2C1_ER_IRQn        = 32,
+    I2C2_EV_IRQn        = 33,
+    I2C2_ER_IRQn        = 34,
+    DMA1_Stream7_IRQn   = 47,
+    DMA2_Stream0_IRQn   = 56,
+} IRQn_Type;
+
+extern GPIO_TypeDef *GPIOA, *GPIOB, *GPIOC, *GPIOH;
+extern I2C_TypeDef *I2C1, *I2C2;
+extern TIM_TypeDef *TIM1, *TIM2, *TIM3, *TIM4, *TIM5;
+extern DMA_TypeDef *DMA1, *DMA2;
+extern DMA_Stream_TypeDef *DMA1_Stream0, *DMA1_Stream1, *DMA1_Stream2, *DMA1_Stream3;
+extern DMA_Stream_TypeDef *DMA1_Stream5, *DMA1_Stream6, *DMA1_Stream7, *DMA2_Stream0;
+extern RCC_TypeDef *RCC;
+extern ADC_TypeDef *ADC1;
+extern ADC_Common_TypeDef *ADC1_COMMON;
+extern DWT_Type *DWT;
+extern CoreDebug_Type *CoreDebug;
+#define ADC ADC1_COMMON
+
+extern uint32_t SystemCoreClock;
+
+/******************************************************************************
+ * Core.  PRIMASK is a flag the interrupt model honours; NVIC settings are    *
+ * kept so a test can check them.                                             *
+ ******************************************************************************/
+extern uint32_t native_primask;
+extern uint8_t native_nvicPriority[96];
+extern bool native_nvicEnabled[96];
+
+static inline void __disable_irq(void) { native_primask = 1; }
+static inline void __enable_irq(void) { native_primask = 0; }
+static inline uint32_t __get_PRIMASK(void) { return native_primask; }
+static inline void __set_PRIMASK(uint32_t primask) { native_primask = primask; }
+static inline void __DSB(void) {}
+static inline void __DMB(void) {}
+static inline void __NOP(void) {}
+
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+    if (irq >= 0) native_nvicPriority[irq] = (uint8_t)priority;
+}
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { if (irq >= 0) native_nvicEnabled[irq] = true; }
+static inline void NVIC_DisableIRQ(IRQn_Type irq) { if (irq >= 0) native_nvicEnabled[irq] = false; }
+static inline uint32_t SysTick_Config(uint32_t ticks) { (void)ticks; return 0; }
+
+/******************************************************************************
+ * Register bits                                                              *
+ ******************************************************************************/
+#define NATIVE_BIT(n)               ((uint32_t)1U << (n))
+
+#define I2C_CR1_PE                  NATIVE_BIT(0)
+#define I2C_CR1_START               NATIVE_BIT(8)
+#define I2C_CR1_STOP                NATIVE_BIT(9)
+#define I2C_CR1_ACK                 NATIVE_BIT(10)
+#define I2C_CR1_POS                 NATIVE_BIT(11)
+#define I2C_CR1_SWRST               NATIVE_BIT(15)
+#define I2C_CR2_FREQ                0x3FUL
+#define I2C_CR2_ITERREN             NATIVE_BIT(8)
+#define I2C_CR2_ITEVTEN             NATIVE_BIT(9)
+#define I2C_CR2_ITBUFEN             NATIVE_BIT(10)
+#define I2C_CR2_DMAEN               NATIVE_BIT(11)
+#define I2C_CR2_LAST                NATIVE_BIT(12)
+#define I2C_SR1_SB                  NATIVE_BIT(0)
+#define I2C_SR1_ADDR                NATIVE_BIT(1)
+#define I2C_SR1_BTF                 NATIVE_BIT(2)
+#define I2C_SR1_STOPF               NATIVE_BIT(4)
+#define I2C_SR1_RXNE                NATIVE_BIT(6)
+#define I2C_SR1_TXE                 NATIVE_BIT(7)
+#define I2C_SR1_BERR                NATIVE_BIT(8)
+#define I2C_SR1_ARLO                NATIVE_BIT(9)
+#define I2C_SR1_AF                  NATIVE_BIT(10)
+#define I2C_SR1_OVR                 NATIVE_BIT(11)
+#define I2C_SR1_TIMEOUT             NATIVE_BIT(14)
+#define I2C_SR2_MSL                 NATIVE_BIT(0)
+#define I2C_SR2_BUSY                NATIVE_BIT(1)
+#define I2C_CCR_CCR                 0xFFFUL
+#define I2C_CCR_DUTY                NATIVE_BIT(14)
+#define I2C_CCR_FS                  NATIVE_BIT(15)
+
+#define RCC_AHB1ENR_GPIOAEN         NATIVE_BIT(0)
+#define RCC_AHB1ENR_GPIOBEN         NATIVE_BIT(1)
+#define RCC_AHB1ENR_DMA1EN          NATIVE_BIT(21)
+#define RCC_AHB1ENR_DMA2EN          NATIVE_BIT(22)
+#define RCC_APB1ENR_TIM3EN          NATIVE_BIT(1)
+#define RCC_APB1ENR_I2C1EN          NATIVE_BIT(21)
+#define RCC_APB1ENR_I2C2EN          NATIVE_BIT(22)
+#define RCC_APB1RSTR_I2C1RST        NATIVE_BIT(21)
+#define RCC_APB1RSTR_I2C2RST        NATIVE_BIT(22)
+#define RCC_APB2ENR_TIM1EN          NATIVE_BIT(0)
+#define RCC_APB2ENR_ADC1EN          NATIVE_BIT(8)
+
+#define GPIO_OTYPER_OT6             NATIVE_BIT(6)
+#define GPIO_OTYPER_OT7             NATIVE_BIT(7)
+#define GPIO_OTYPER_OT8             NATIVE_BIT(8)
+#define GPIO_OTYPER_OT9             NATIVE_BIT(9)
+#define GPIO_OTYPER_OT10            NATIVE_BIT(10)
+#define GPIO_OTYPER_OT11            NATIVE_BIT(11)
+
+#define DMA_SxCR_EN                 NATIVE_BIT(0)
+#define DMA_SxCR_TEIE               NATIVE_BIT(2)
+#define DMA_SxCR_TCIE               NATIVE_BIT(4)
+#define DMA_SxCR_DIR_0              NATIVE_BIT(6)
+#define DMA_SxCR_CIRC               NATIVE_BIT(8)
+#define DMA_SxCR_PINC               NATIVE_BIT(9)
+#define DMA_SxCR_MINC               NATIVE_BIT(10)
+#define DMA_SxCR_PSIZE_0            NATIVE_BIT(11)
+#define DMA_SxCR_MSIZE_0            NATIVE_BIT(13)
+#define DMA_SxCR_PL_1               NATIVE_BIT(17)
+#define DMA_SxCR_PL                 (NATIVE_BIT(16) | NATIVE_BIT(17))
+#define DMA_SxCR_CHSEL_Pos          25
+#define DMA_LISR_TEIF0              NATIVE_BIT(3)
+#define DMA_LISR_TCIF0              NATIVE_BIT(5)
+#define DMA_LIFCR_CFEIF0            NATIVE_BIT(0)
+#define DMA_LIFCR_CDMEIF0           NATIVE_BIT(2)
+#define DMA_LIFCR_CTEIF0            NATIVE_BIT(3)
+#define DMA_LIFCR_CHTIF0            NATIVE_BIT(4)
+#define DMA_LIFCR_CTCIF0            NATIVE_BIT(5)
+#define DMA_HISR_TEIF6              NATIVE_BIT(19)
+#define DMA_HISR_TCIF6              NATIVE_BIT(21)
+#define DMA_HIFCR_CFEIF6            NATIVE_BIT(16)
+#define DMA_HIFCR_CDMEIF6           NATIVE_BIT(18)
+#define DMA_HIFCR_CTEIF6            NATIVE_BIT(19)
+#define DMA_HIFCR_CHTIF6            NATIVE_BIT(20)
+#define DMA_HIFCR_CTCIF6            NATIVE_BIT(21)
+
+#define DWT_CTRL_CYCCNTENA_Msk      NATIVE_BIT(0)
+#define CoreDebug_DEMCR_TRCENA_Msk  NATIVE_BIT(24)
+
+#define TIM_CR1_CEN                 NATIVE_BIT(0)
+#define TIM_CR1_URS                 NATIVE_BIT(2)
+#define TIM_CR1_ARPE                NATIVE_BIT(7)
+#define TIM_CR2_MMS_1               NATIVE_BIT(5)
+#define TIM_SMCR_TS_Pos             4
+#define TIM_SMCR_TS_Msk             (7UL << TIM_SMCR_TS_Pos)
+#define TIM_DIER_UIE                NATIVE_BIT(0)
+#define TIM_DIER_CC1IE              NATIVE_BIT(1)
+#define TIM_SR_UIF                  NATIVE_BIT(0)
+#define TIM_SR_CC1IF                NATIVE_BIT(1)
+#define TIM_SR_CC3IF                NATIVE_BIT(3)
+#define TIM_SR_CC1OF                NATIVE_BIT(9)
+#define TIM_EGR_UG                  NATIVE_BIT(0)
+#define TIM_CCMR1_CC1S              (3UL << 0)
+#define TIM_CCMR1_OC1PE             NATIVE_BIT(3)
+#define TIM_CCMR1_OC1M_Pos          4
+#define TIM_CCMR1_OC1M              (7UL << TIM_CCMR1_OC1M_Pos)
+#define TIM_CCMR1_OC1M_1            NATIVE_BIT(5)
+#define TIM_CCMR1_OC1M_2            NATIVE_BIT(6)
+#define TIM_CCMR1_OC2PE             NATIVE_BIT(11)
+#define TIM_CCMR1_OC2M_Pos          12
+#define TIM_CCMR2_CC3S_Pos          0
+#define TIM_CCMR2_CC3S              (3UL << TIM_CCMR2_CC3S_Pos)
+#define TIM_CCMR2_OC3PE             NATIVE_BIT(3)
+#define TIM_CCMR2_OC3M_Pos          4
+#define TIM_CCMR2_OC4PE             NATIVE_BIT(11)
+#define TIM_CCMR2_OC4M_Pos          12
+#define TIM_CCER_CC1E               NATIVE_BIT(0)
+#define TIM_CCER_CC1P               NATIVE_BIT(1)
+#define TIM_CCER_CC2E               NATIVE_BIT(4)
+#define TIM_CCER_CC3E               NATIVE_BIT(8)
+#define TIM_CCER_CC4E               NATIVE_BIT(12)
+
+#define ADC_CR2_ADON                NATIVE_BIT(0)
+#define ADC_CR2_CONT                NATIVE_BIT(1)
+#define ADC_CR2_DMA                 NATIVE_BIT(8)
+#define ADC_CR2_DDS                 NATIVE_BIT(9)
+#define ADC_CR2_SWSTART             NATIVE_BIT(30)
+#define ADC_SR_EOC                  NATIVE_BIT(1)
+#define ADC_SMPR2_SMP0_Pos          0
+#define ADC_CCR_ADCPRE_0            NATIVE_BIT(16)
+#define ADC_CCR_ADCPRE              (3UL << 16)
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "stm32f4xx_hal.h"
+
+#endif // STM32F4XX_H
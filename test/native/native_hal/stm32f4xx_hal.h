@@ -0,0 +1,150 @@
+#pragma once
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Host stand-in for the STM32Cube HAL, [env:native] only.  The types and     *
+ * calls the firmware uses; the calls do nothing and report HAL_OK, except    *
+ * the tick, which native.h lets a test set.                                  *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+#include "stm32f4xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+typedef struct { uint32_t Pin, Mode, Pull, Speed, Alternate; } GPIO_InitTypeDef;
+typedef struct { uint32_t Prescaler, CounterMode, Period, ClockDivision, RepetitionCounter, AutoReloadPreload; } TIM_Base_InitTypeDef;
+typedef struct { TIM_TypeDef* Instance; TIM_Base_InitTypeDef Init; } TIM_HandleTypeDef;
+typedef struct { uint32_t EncoderMode, IC1Polarity, IC1Selection, IC1Prescaler, IC1Filter,
+                 IC2Polarity, IC2Selection, IC2Prescaler, IC2Filter; } TIM_Encoder_InitTypeDef;
+typedef struct { uint32_t MasterOutputTrigger, MasterSlaveMode; } TIM_MasterConfigTypeDef;
+typedef struct { uint32_t PLLState, PLLSource, PLLM, PLLN, PLLP, PLLQ; } RCC_PLLInitTypeDef;
+typedef struct { uint32_t OscillatorType, HSEState; RCC_PLLInitTypeDef PLL; } RCC_OscInitTypeDef;
+typedef struct { uint32_t ClockType, SYSCLKSource, AHBCLKDivider, APB1CLKDivider, APB2CLKDivider; } RCC_ClkInitTypeDef;
+
+#define GPIO_PIN_0                      0x0001u
+#define GPIO_PIN_1                      0x0002u
+#define GPIO_PIN_2                      0x0004u
+#define GPIO_PIN_3                      0x0008u
+#define GPIO_PIN_4                      0x0010u
+#define GPIO_PIN_5                      0x0020u
+#define GPIO_PIN_6                      0x0040u
+#define GPIO_PIN_7                      0x0080u
+#define GPIO_PIN_8                      0x0100u
+#define GPIO_PIN_9                      0x0200u
+#define GPIO_PIN_10                     0x0400u
+#define GPIO_PIN_11                     0x0800u
+#define GPIO_PIN_12                     0x1000u
+#define GPIO_PIN_13                     0x2000u
+#define GPIO_PIN_14                     0x4000u
+#define GPIO_PIN_15                     0x8000u
+
+#define GPIO_MODE_INPUT                 0x00
+#define GPIO_MODE_OUTPUT_PP             0x01
+#define GPIO_MODE_AF_PP                 0x02
+#define GPIO_MODE_ANALOG                0x03
+#define GPIO_MODE_OUTPUT_OD             0x11
+#define GPIO_MODE_AF_OD                 0x12
+#define GPIO_NOPULL                     0
+#define GPIO_PULLUP                     1
+#define GPIO_SPEED_FREQ_LOW             0
+#define GPIO_SPEED_FREQ_HIGH            2
+#define GPIO_SPEED_FREQ_VERY_HIGH       3
+#define GPIO_AF1_TIM1                   1
+#define GPIO_AF1_TIM2                   1
+#define GPIO_AF2_TIM3                   2
+#define GPIO_AF2_TIM4                   2
+#define GPIO_AF4_I2C1                   4
+
+#define TIM_COUNTERMODE_UP              0
+#define TIM_CLOCKDIVISION_DIV1          0
+#define TIM_AUTORELOAD_PRELOAD_DISABLE  0
+#define TIM_AUTORELOAD_PRELOAD_ENABLE   0x80
+#define TIM_ENCODERMODE_TI12            3
+#define TIM_ICPOLARITY_RISING           0
+#define TIM_ICSELECTION_DIRECTTI        1
+#define TIM_ICPSC_DIV1                  0
+#define TIM_ICPSC_DIV4                  8
+#define TIM_TRGO_RESET                  0
+#define TIM_TRGO_UPDATE                 0x20
+#define TIM_MASTERSLAVEMODE_DISABLE     0
+#define TIM_CHANNEL_1                   0
+#define TIM_CHANNEL_2                   4
+#define TIM_CHANNEL_3                   8
+#define TIM_CHANNEL_4                   12
+#define TIM_CHANNEL_ALL                 0x3C
+
+#define RCC_OSCILLATORTYPE_HSE          1
+#define RCC_HSE_ON                      1
+#define RCC_PLL_ON                      2
+#define RCC_PLLSOURCE_HSE               1
+#define RCC_PLLP_DIV2                   2
+#define RCC_CLOCKTYPE_SYSCLK            1
+#define RCC_CLOCKTYPE_HCLK              2
+#define RCC_CLOCKTYPE_PCLK1             4
+#define RCC_CLOCKTYPE_PCLK2             8
+#define RCC_SYSCLKSOURCE_PLLCLK         2
+#define RCC_SYSCLK_DIV1                 0
+#define RCC_HCLK_DIV1                   0
+#define RCC_HCLK_DIV2                   0x1000
+#define RCC_HCLK_DIV4                   0x1400
+#define RCC_HCLK_DIV8                   0x1800
+#define RCC_HCLK_DIV16                  0x1C00
+#define FLASH_LATENCY_3                 3
+#define PWR_REGULATOR_VOLTAGE_SCALE1    1
+
+#define __HAL_RCC_PWR_CLK_ENABLE()          do {} while (0)
+#define __HAL_PWR_VOLTAGESCALING_CONFIG(x)  do {} while (0)
+#define __HAL_RCC_GPIOA_CLK_ENABLE()        do {} while (0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()        do {} while (0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()        do {} while (0)
+#define __HAL_RCC_GPIOH_CLK_ENABLE()        do {} while (0)
+#define __HAL_RCC_TIM1_CLK_ENABLE()         do {} while (0)
+#define __HAL_RCC_TIM2_CLK_ENABLE()         do {} while (0)
+#define __HAL_RCC_TIM3_CLK_ENABLE()         do {} while (0)
+#define __HAL_RCC_TIM4_CLK_ENABLE()         do {} while (0)
+#define __HAL_RCC_TIM5_CLK_ENABLE()         do {} while (0)
+#define __HAL_RCC_ADC1_CLK_ENABLE()         do {} while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()         do {} while (0)
+#define __HAL_RCC_DMA2_CLK_ENABLE()         do {} while (0)
+
+HAL_StatusTypeDef HAL_Init(void);
+void HAL_IncTick(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t delay);
+
+void HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init);
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin);
+void HAL_GPIO_TogglePin(GPIO_TypeDef* port, uint16_t pin);
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Init(TIM_HandleTypeDef* htim, TIM_Encoder_InitTypeDef* config);
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef* htim, uint32_t channel);
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef* htim, TIM_MasterConfigTypeDef* config);
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef* config);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef* config, uint32_t latency);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STM32F4XX_HAL_H
@@ -0,0 +1,189 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * UpdateScreenAsync: returns at once, the TX DMA and the I2C interrupts send *
+ * the dirty windows, and the panel ends up as a blocking update leaves it.   *
+ * The panel is an SSD1306Model fed from the wire.                            *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "display.h"
+#include "ssd1306model.h"
+
+/* long enough for a full frame at 400 kHz */
+#define FRAME_CYCLES    (30 * 96000)
+
+static NATIVE_I2C_DEVICE_t device;
+static SSD1306Model panel;
+static I2C bus;
+static Display display(&bus);
+static uint32_t doneCalls;
+
+static void PanelListener(uint8_t event, uint8_t value, void* context){
+    SSD1306Model* model = (SSD1306Model*)context;
+
+    if (event == NATIVE_I2C_START){
+        model->Begin();
+    } else if (event == NATIVE_I2C_WRITE){
+        model->Byte(value);
+    }
+}
+
+static void Done(void* context){
+    (*(uint32_t*)context)++;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&device, 0, sizeof(device));
+    device.Saddr = DISPLAY_I2C_ADDR;
+    device.Listener = PanelListener;
+    device.Context = &panel;
+    NATIVE_I2C_Attach(&device);
+    panel.Reset();
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    display = Display(&bus);
+    display.Init();
+    doneCalls = 0;
+}
+
+void tearDown(void){}
+
+static void Draw(void){
+    display.DrawRectangle(0, 0, 127, 63, COLOR_WHITE);
+    display.FillRectangle(20, 20, 30, 12, COLOR_WHITE);
+    display.GotoXY(60, 30);
+    display.Print("async", Font7x10Packed.Def(), COLOR_WHITE);
+}
+
+/* the frame and the filled box of Draw, the text is left to the blocking comparison */
+static void AssertPanelMatches(void){
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            bool lit = (x == 0 || x == 127 || y == 0 || y == 63) || (x >= 20 && x < 50 && y >= 20 && y < 32);
+            if (x >= 60 && y >= 30 && y < 40){
+                continue;
+            }
+            TEST_ASSERT_EQUAL_MESSAGE(lit, panel.Pixel(x, y), "panel pixel");
+        }
+    }
+}
+
+void test_returns_before_the_frame_is_sent(void){
+    uint32_t start = NATIVE_Cycles();
+
+    display.Invalidate();
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    TEST_ASSERT_TRUE(display.IsUpdateBusy());
+    // a full frame takes about 23 ms on the wire, the call a tiny part of that
+    TEST_ASSERT_LESS_THAN(96000, NATIVE_Cycles() - start);
+
+    NATIVE_Run(FRAME_CYCLES);
+    TEST_ASSERT_FALSE(display.IsUpdateBusy());
+}
+
+void test_panel_matches_the_drawing(void){
+    Draw();
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    NATIVE_Run(FRAME_CYCLES);
+    TEST_ASSERT_FALSE(display.IsUpdateBusy());
+    AssertPanelMatches();
+}
+
+void test_sends_what_a_blocking_update_sends(void){
+    uint32_t before, async, blocking;
+    uint8_t asyncRam[DISPLAY_PAGES][DISPLAY_WIDTH];
+
+    Draw();
+    before = NATIVE_I2C_GetStats().Written;
+    display.UpdateScreenAsync();
+    NATIVE_Run(FRAME_CYCLES);
+    async = NATIVE_I2C_GetStats().Written - before;
+    for (uint8_t p = 0; p < DISPLAY_PAGES; p++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            asyncRam[p][x] = panel.Ram(p, x);
+        }
+    }
+
+    // same drawing from a cleared panel, blocking
+    setUp();
+    Draw();
+    before = NATIVE_I2C_GetStats().Written;
+    display.UpdateScreen();
+    blocking = NATIVE_I2C_GetStats().Written - before;
+
+    TEST_ASSERT_EQUAL_UINT32(blocking, async);
+    for (uint8_t p = 0; p < DISPLAY_PAGES; p++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            TEST_ASSERT_EQUAL_HEX8(panel.Ram(p, x), asyncRam[p][x]);
+        }
+    }
+}
+
+void test_callback_runs_once_when_done(void){
+    display.DrawPixel(3, 3, COLOR_WHITE);
+    display.DrawPixel(3, 60, COLOR_WHITE);
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync(Done, &doneCalls));
+    TEST_ASSERT_EQUAL_UINT32(0, doneCalls);
+    NATIVE_Run(FRAME_CYCLES);
+    TEST_ASSERT_EQUAL_UINT32(1, doneCalls);
+    TEST_ASSERT_TRUE(panel.Pixel(3, 3));
+    TEST_ASSERT_TRUE(panel.Pixel(3, 60));
+}
+
+void test_clean_screen_completes_at_once(void){
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync(Done, &doneCalls));
+    TEST_ASSERT_FALSE(display.IsUpdateBusy());
+    TEST_ASSERT_EQUAL_UINT32(1, doneCalls);
+}
+
+void test_refuses_a_second_update_in_flight(void){
+    display.Invalidate();
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    TEST_ASSERT_FALSE(display.UpdateScreenAsync());
+    NATIVE_Run(FRAME_CYCLES);
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+}
+
+void test_draw_over_a_window_in_flight_is_counted_and_resent(void){
+    display.FillRectangle(0, 0, 128, 8, COLOR_WHITE);
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    display.DrawPixel(64, 4, COLOR_BLACK);
+    TEST_ASSERT_EQUAL_UINT32(1, display.GetBusyWriteCount());
+
+    NATIVE_Run(FRAME_CYCLES);
+    display.UpdateScreenAsync();
+    NATIVE_Run(FRAME_CYCLES);
+    TEST_ASSERT_FALSE(panel.Pixel(64, 4));
+    TEST_ASSERT_TRUE(panel.Pixel(63, 4));
+}
+
+void test_blocking_update_waits_for_the_async_one(void){
+    display.FillRectangle(0, 0, 128, 64, COLOR_WHITE);
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    display.DrawPixel(10, 10, COLOR_BLACK);
+    display.UpdateScreen();
+    TEST_ASSERT_FALSE(display.IsUpdateBusy());
+    TEST_ASSERT_FALSE(panel.Pixel(10, 10));
+    TEST_ASSERT_TRUE(panel.Pixel(11, 10));
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_returns_before_the_frame_is_sent);
+    RUN_TEST(test_panel_matches_the_drawing);
+    RUN_TEST(test_sends_what_a_blocking_update_sends);
+    RUN_TEST(test_callback_runs_once_when_done);
+    RUN_TEST(test_clean_screen_completes_at_once);
+    RUN_TEST(test_refuses_a_second_update_in_flight);
+    RUN_TEST(test_draw_over_a_window_in_flight_is_counted_and_resent);
+    RUN_TEST(test_blocking_update_waits_for_the_async_one);
+    return UNITY_END();
+}
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Dirty page windows: UpdateScreen sends only what changed.  Counts the      *
+ * bytes the bus model sees after the address, control bytes included, so a  *
+ * window costs its 7 command bytes plus 1 + width * pages data bytes.        *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "display.h"
+
+#define WINDOW_BYTES(w, pages)  (1 + 6 + 1 + (w) * (pages))
+
+static NATIVE_I2C_DEVICE_t panel;
+static I2C bus;
+static Display display(&bus);
+static FontDef_t font;
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&panel, 0, sizeof(panel));
+    panel.Saddr = DISPLAY_I2C_ADDR;
+    NATIVE_I2C_Attach(&panel);
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    display = Display(&bus);
+    display.Init();
+    font = Font6x8Packed.Def();
+}
+
+void tearDown(void){}
+
+/* bytes on the wire for one UpdateScreen */
+static uint32_t Update(void){
+    uint32_t before = NATIVE_I2C_GetStats().Written;
+    display.UpdateScreen();
+    return NATIVE_I2C_GetStats().Written - before;
+}
+
+void test_clean_screen_sends_nothing(void){
+    NATIVE_I2C_STATS_t before = NATIVE_I2C_GetStats();
+
+    display.UpdateScreen();
+    TEST_ASSERT_EQUAL_UINT32(before.Starts, NATIVE_I2C_GetStats().Starts);
+    TEST_ASSERT_EQUAL_UINT32(before.Written, NATIVE_I2C_GetStats().Written);
+    TEST_ASSERT_EQUAL_UINT32(0, display.GetStats().Frames - 1);     // the Init frame only
+}
+
+void test_invalidate_sends_the_whole_frame(void){
+    display.Invalidate();
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_BYTES(DISPLAY_WIDTH, DISPLAY_PAGES), Update());
+    TEST_ASSERT_EQUAL_UINT32(0, Update());
+}
+
+void test_fill_sends_the_whole_frame(void){
+    display.Fill(COLOR_WHITE);
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_BYTES(DISPLAY_WIDTH, DISPLAY_PAGES), Update());
+}
+
+void test_pixel_sends_one_column(void){
+    display.DrawPixel(40, 20, COLOR_WHITE);
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_BYTES(1, 1), Update());
+    TEST_ASSERT_EQUAL_UINT32(0, Update());
+}
+
+void test_menu_pointer_flip_sends_one_glyph(void){
+    // the menu's '>' pointer: one 6 pixel glyph on one page
+    display.GotoXY(0, 16);
+    display.Putc('>', font, COLOR_WHITE);
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_BYTES(6, 1), Update());
+
+    display.GotoXY(0, 16);
+    display.Putc(' ', font, COLOR_WHITE);
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_BYTES(6, 1), Update());
+}
+
+void test_window_spans_the_dirty_columns(void){
+    display.DrawPixel(10, 3, COLOR_WHITE);
+    display.DrawPixel(30, 5, COLOR_WHITE);
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_BYTES(21, 1), Update());
+}
+
+void test_distant_pages_go_as_separate_windows(void){
+    display.DrawPixel(5, 0, COLOR_WHITE);
+    display.DrawPixel(100, 63, COLOR_WHITE);
+    TEST_ASSERT_EQUAL_UINT32(2 * WINDOW_BYTES(1, 1), Update());
+    TEST_ASSERT_EQUAL_UINT32(2, display.GetStats().Windows - 1);
+}
+
+void test_text_line_sends_its_pages(void){
+    // 7x10 text at y = 4 straddles pages 0 and 1
+    display.GotoXY(0, 4);
+    display.Print("E4", Font7x10Packed.Def(), COLOR_WHITE);
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_BYTES(14, 2), Update());
+}
+
+void test_stats_count_the_bytes_sent(void){
+    display.ResetStats();
+    display.DrawPixel(64, 32, COLOR_WHITE);
+    uint32_t wire = Update();
+
+    // the display counts what it hands the bus, less the two control bytes
+    TEST_ASSERT_EQUAL_UINT32(wire - 2, display.GetStats().Bytes);
+    TEST_ASSERT_EQUAL_UINT32(1, display.GetStats().Frames);
+    TEST_ASSERT_EQUAL_UINT32(1, display.GetStats().Windows);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_screen_sends_nothing);
+    RUN_TEST(test_invalidate_sends_the_whole_frame);
+    RUN_TEST(test_fill_sends_the_whole_frame);
+    RUN_TEST(test_pixel_sends_one_column);
+    RUN_TEST(test_menu_pointer_flip_sends_one_glyph);
+    RUN_TEST(test_window_spans_the_dirty_columns);
+    RUN_TEST(test_distant_pages_go_as_separate_windows);
+    RUN_TEST(test_text_line_sends_its_pages);
+    RUN_TEST(test_stats_count_the_bytes_sent);
+    return UNITY_END();
+}
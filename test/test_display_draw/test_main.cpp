@@ -0,0 +1,315 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Span fills, lines, rectangles and bitmap blits against a per-pixel         *
+ * reference: each shape drawn one DrawPixel at a time, as the driver did     *
+ * before spans, with the same clipping.  Random shapes, partly off screen,   *
+ * in white, black and XOR, with the Inverted state toggled along the way.    *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "display.h"
+#include "ssd1306model.h"
+
+#define SHAPES          3000
+#define SHAPES_PER_CHECK 40
+#define BLIT_MAX        40      // bitmap width and height limit
+
+static NATIVE_I2C_DEVICE_t device;
+static SSD1306Model panel;
+static I2C bus;
+static Display display(&bus);
+
+static bool reference[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+static bool inverted;
+static uint32_t seed;
+
+static void PanelListener(uint8_t event, uint8_t value, void* context){
+    SSD1306Model* model = (SSD1306Model*)context;
+
+    if (event == NATIVE_I2C_START){
+        model->Begin();
+    } else if (event == NATIVE_I2C_WRITE){
+        model->Byte(value);
+    }
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&device, 0, sizeof(device));
+    device.Saddr = DISPLAY_I2C_ADDR;
+    device.Listener = PanelListener;
+    device.Context = &panel;
+    NATIVE_I2C_Attach(&device);
+    panel.Reset();
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    display = Display(&bus);
+    display.Init();
+    memset(reference, 0, sizeof(reference));
+    inverted = false;
+    seed = 12345;
+}
+
+void tearDown(void){}
+
+static uint32_t Random(uint32_t range){
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % range;
+}
+
+/******************************************************************************
+ * Reference                                                                  *
+ ******************************************************************************/
+static void RefPixel(int32_t x, int32_t y, DISPLAY_COLOR_t c){
+    if (x < 0 || y < 0 || x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT){
+        return;
+    }
+    if (c == COLOR_INVERSE){
+        reference[y][x] = !reference[y][x];
+    } else {
+        reference[y][x] = (c == COLOR_WHITE) != inverted;
+    }
+}
+
+static void RefFill(int32_t x, int32_t y, int32_t w, int32_t h, DISPLAY_COLOR_t c){
+    for (int32_t i = 0; i < h; i++){
+        for (int32_t j = 0; j < w; j++){
+            RefPixel(x + j, y + i, c);
+        }
+    }
+}
+
+/* the line drawing from before spans: clamp the ends, then Bresenham */
+static void RefLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, DISPLAY_COLOR_t c){
+    int32_t dx, dy, sx, sy, err, e2;
+
+    x0 = (x0 >= DISPLAY_WIDTH) ? DISPLAY_WIDTH - 1 : x0;
+    x1 = (x1 >= DISPLAY_WIDTH) ? DISPLAY_WIDTH - 1 : x1;
+    y0 = (y0 >= DISPLAY_HEIGHT) ? DISPLAY_HEIGHT - 1 : y0;
+    y1 = (y1 >= DISPLAY_HEIGHT) ? DISPLAY_HEIGHT - 1 : y1;
+    dx = (x0 < x1) ? (x1 - x0) : (x0 - x1);
+    dy = (y0 < y1) ? (y1 - y0) : (y0 - y1);
+    sx = (x0 < x1) ? 1 : -1;
+    sy = (y0 < y1) ? 1 : -1;
+    err = ((dx > dy) ? dx : -dy) / 2;
+
+    for (;;){
+        RefPixel(x0, y0, c);
+        if (x0 == x1 && y0 == y1){
+            break;
+        }
+        e2 = err;
+        if (e2 > -dx){
+            err -= dy;
+            x0 += sx;
+        }
+        if (e2 < dy){
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static void RefRectangle(int32_t x, int32_t y, int32_t w, int32_t h, DISPLAY_COLOR_t c){
+    if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT){
+        return;
+    }
+    if ((x + w) >= DISPLAY_WIDTH){
+        w = DISPLAY_WIDTH - x;
+    }
+    if ((y + h) >= DISPLAY_HEIGHT){
+        h = DISPLAY_HEIGHT - y;
+    }
+    RefLine(x, y, x + w, y, c);
+    RefLine(x, y + h, x + w, y + h, c);
+    RefLine(x, y, x, y + h, c);
+    RefLine(x + w, y, x + w, y + h, c);
+}
+
+static void RefBitmap(int32_t x, int32_t y, const uint8_t* bitmap, int32_t w, int32_t h, DISPLAY_COLOR_t c){
+    for (int32_t i = 0; i < h; i++){
+        for (int32_t j = 0; j < w; j++){
+            if (bitmap[(i / 8) * w + j] & (1 << (i % 8))){
+                RefPixel(x + j, y + i, c);
+            }
+        }
+    }
+}
+
+static void RefXBM(int32_t x, int32_t y, const uint8_t* xbm, int32_t w, int32_t h, DISPLAY_COLOR_t c){
+    int32_t stride = (w + 7) / 8;
+
+    for (int32_t i = 0; i < h; i++){
+        for (int32_t j = 0; j < w; j++){
+            if (xbm[i * stride + j / 8] & (1 << (j % 8))){
+                RefPixel(x + j, y + i, c);
+            }
+        }
+    }
+}
+
+static void AssertPanel(uint32_t shape){
+    display.UpdateScreen();
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            if (panel.Pixel(x, y) != reference[y][x]){
+                char message[64];
+                snprintf(message, sizeof(message), "pixel %u,%u after shape %u", x, y, shape);
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+    }
+}
+
+static void ToggleInvert(void){
+    display.ToggleInvert();
+    inverted = !inverted;
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            reference[y][x] = !reference[y][x];
+        }
+    }
+}
+
+/* runs 'count' random shapes of the kinds set in 'kinds', checking the panel as it goes */
+static void RandomShapes(uint32_t count, uint32_t kinds){
+    static const DISPLAY_COLOR_t colors[] = {COLOR_WHITE, COLOR_BLACK, COLOR_INVERSE};
+    uint8_t bitmap[BLIT_MAX * BLIT_MAX];
+
+    for (uint32_t n = 1; n <= count; n++){
+        uint16_t x = Random(DISPLAY_WIDTH + 16);
+        uint16_t y = Random(DISPLAY_HEIGHT + 8);
+        uint16_t w = Random(DISPLAY_WIDTH + 16);
+        uint16_t h = Random(DISPLAY_HEIGHT + 8);
+        DISPLAY_COLOR_t c = colors[Random(3)];
+        uint8_t kind;
+
+        do {
+            kind = Random(8);
+        } while (!(kinds & (1 << kind)));
+
+        switch (kind){
+            case 0:
+                display.FillRectangle(x, y, w, h, c);
+                RefFill(x, y, w, h, c);
+                break;
+            case 1:
+                display.DrawHLine(x, y, w, c);
+                RefFill(x, y, w, 1, c);
+                break;
+            case 2:
+                display.DrawVLine(x, y, h, c);
+                RefFill(x, y, 1, h, c);
+                break;
+            case 3:
+                display.DrawRectangle(x, y, w, h, c);
+                RefRectangle(x, y, w, h, c);
+                break;
+            case 4:
+                display.DrawLine(x, y, w, h, c);
+                RefLine(x, y, w, h, c);
+                break;
+            case 5:
+                w = 1 + Random(BLIT_MAX);
+                h = 1 + Random(BLIT_MAX);
+                for (uint16_t i = 0; i < sizeof(bitmap); i++){
+                    bitmap[i] = Random(256);
+                }
+                display.DrawBitmap(x, y, bitmap, w, h, c);
+                RefBitmap(x, y, bitmap, w, h, c);
+                break;
+            case 6:
+                w = 1 + Random(BLIT_MAX);
+                h = 1 + Random(BLIT_MAX);
+                for (uint16_t i = 0; i < sizeof(bitmap); i++){
+                    bitmap[i] = Random(256);
+                }
+                display.DrawXBM(x, y, bitmap, w, h, c);
+                RefXBM(x, y, bitmap, w, h, c);
+                break;
+            case 7:
+                ToggleInvert();
+                break;
+        }
+
+        if (n % SHAPES_PER_CHECK == 0){
+            AssertPanel(n);
+        }
+    }
+    AssertPanel(count);
+}
+
+#define KIND(k)     (1u << (k))
+
+void test_fill_rectangle(void){
+    RandomShapes(SHAPES, KIND(0) | KIND(7));
+}
+
+void test_horizontal_and_vertical_lines(void){
+    RandomShapes(SHAPES, KIND(1) | KIND(2) | KIND(7));
+}
+
+void test_rectangle_outline(void){
+    RandomShapes(SHAPES, KIND(3) | KIND(7));
+}
+
+void test_lines(void){
+    RandomShapes(SHAPES, KIND(4) | KIND(7));
+}
+
+void test_page_major_bitmap(void){
+    RandomShapes(SHAPES, KIND(5) | KIND(7));
+}
+
+void test_xbm(void){
+    RandomShapes(SHAPES, KIND(6) | KIND(7));
+}
+
+void test_everything_mixed(void){
+    RandomShapes(SHAPES, 0xFF);
+}
+
+void test_xor_twice_restores_the_screen(void){
+    display.GotoXY(10, 10);
+    display.Print("XOR", Font7x10Packed.Def(), COLOR_WHITE);
+    display.UpdateScreen();
+    uint8_t before[DISPLAY_PAGES][DISPLAY_WIDTH];
+    for (uint8_t p = 0; p < DISPLAY_PAGES; p++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            before[p][x] = panel.Ram(p, x);
+        }
+    }
+
+    display.FillRectangle(5, 5, 60, 30, COLOR_INVERSE);
+    display.DrawLine(0, 0, 127, 63, COLOR_INVERSE);
+    display.UpdateScreen();
+    display.FillRectangle(5, 5, 60, 30, COLOR_INVERSE);
+    display.DrawLine(0, 0, 127, 63, COLOR_INVERSE);
+    display.UpdateScreen();
+
+    for (uint8_t p = 0; p < DISPLAY_PAGES; p++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            TEST_ASSERT_EQUAL_HEX8(before[p][x], panel.Ram(p, x));
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_fill_rectangle);
+    RUN_TEST(test_horizontal_and_vertical_lines);
+    RUN_TEST(test_rectangle_outline);
+    RUN_TEST(test_lines);
+    RUN_TEST(test_page_major_bitmap);
+    RUN_TEST(test_xbm);
+    RUN_TEST(test_everything_mixed);
+    RUN_TEST(test_xor_twice_restores_the_screen);
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Putc against the old per-pixel renderer: every glyph of every font, at    *
+ * every row offset within a page, in each colour and both Inverted states.   *
+ * The reference draws from the row-major source tables one pixel at a time  *
+ * as Putc did before glyphs were packed; the panel is an SSD1306Model fed    *
+ * from the wire.                                                             *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "display.h"
+#include "ssd1306model.h"
+
+typedef struct {
+    FontDef_t Def;
+    const uint16_t* Rows;       // source table, from ' '
+} FONT_CASE_t;
+
+static NATIVE_I2C_DEVICE_t device;
+static SSD1306Model panel;
+static I2C bus;
+static Display display(&bus);
+
+static bool reference[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+static bool inverted;
+
+static void PanelListener(uint8_t event, uint8_t value, void* context){
+    SSD1306Model* model = (SSD1306Model*)context;
+
+    if (event == NATIVE_I2C_START){
+        model->Begin();
+    } else if (event == NATIVE_I2C_WRITE){
+        model->Byte(value);
+    }
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&device, 0, sizeof(device));
+    device.Saddr = DISPLAY_I2C_ADDR;
+    device.Listener = PanelListener;
+    device.Context = &panel;
+    NATIVE_I2C_Attach(&device);
+    panel.Reset();
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    display = Display(&bus);
+    display.Init();
+    memset(reference, 0, sizeof(reference));
+    inverted = false;
+}
+
+void tearDown(void){}
+
+/* the renderer Putc replaced: DrawPixel per pixel, background included */
+static void ReferencePutc(uint16_t x, uint16_t y, char ch, const FONT_CASE_t* font, DISPLAY_COLOR_t color){
+    for (uint8_t i = 0; i < font->Def.FontHeight; i++){
+        uint16_t b = font->Rows[(ch - ' ') * font->Def.FontHeight + i];
+        for (uint8_t j = 0; j < font->Def.FontWidth; j++){
+            bool set = (b << j) & 0x8000;
+            bool* pixel = &reference[y + i][x + j];
+
+            if (color == COLOR_INVERSE){
+                *pixel ^= set;
+            } else {
+                *pixel = (set == (color == COLOR_WHITE)) != inverted;
+            }
+        }
+    }
+}
+
+static void AssertPanel(const char* what){
+    display.UpdateScreen();
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            if (panel.Pixel(x, y) != reference[y][x]){
+                char message[96];
+                snprintf(message, sizeof(message), "%s: pixel %u,%u", what, x, y);
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+    }
+}
+
+static void Background(bool lit){
+    display.Fill(lit ? COLOR_WHITE : COLOR_BLACK);
+    memset(reference, lit, sizeof(reference));
+}
+
+/* every glyph of the font, screenful by screenful, text rows starting 'offset' rows into a page */
+static void CheckFont(const FONT_CASE_t* font, uint8_t offset, DISPLAY_COLOR_t color, bool invert){
+    uint8_t w = font->Def.FontWidth;
+    uint8_t h = font->Def.FontHeight;
+    uint8_t step = ((h + 7) / 8) * 8;
+    uint16_t x = 0, y = offset;
+    char what[64];
+
+    snprintf(what, sizeof(what), "%ux%u offset %u colour %u inverted %u", w, h, offset, color, invert);
+    if (invert != inverted){
+        display.ToggleInvert();
+        inverted = invert;
+    }
+    Background(offset & 1);
+
+    for (char ch = font->Def.FirstChar; ; ch++){
+        // glyphs run up to the right and bottom edges
+        if (x + w > DISPLAY_WIDTH){
+            x = 0;
+            y += step;
+        }
+        if (y + h > DISPLAY_HEIGHT){
+            AssertPanel(what);
+            Background(!(offset & 1));
+            x = 0;
+            y = offset;
+        }
+
+        display.GotoXY(x, y);
+        TEST_ASSERT_EQUAL(ch, display.Putc(ch, font->Def, color));
+        ReferencePutc(x, y, ch, font, color);
+        x += w;
+
+        if (ch == font->Def.LastChar){
+            break;
+        }
+    }
+    AssertPanel(what);
+}
+
+static void CheckAll(const FONT_CASE_t* font){
+    static const DISPLAY_COLOR_t colors[] = {COLOR_WHITE, COLOR_BLACK, COLOR_INVERSE};
+
+    for (uint8_t invert = 0; invert < 2; invert++){
+        for (uint8_t c = 0; c < 3; c++){
+            for (uint8_t offset = 0; offset < 8; offset++){
+                CheckFont(font, offset, colors[c], invert);
+            }
+        }
+    }
+}
+
+void test_font_6x8(void){
+    FONT_CASE_t font = {Font6x8Packed.Def(), Font6x8};
+    CheckAll(&font);
+}
+
+void test_font_7x10(void){
+    FONT_CASE_t font = {Font7x10Packed.Def(), Font7x10};
+    CheckAll(&font);
+}
+
+void test_font_11x18(void){
+    FONT_CASE_t font = {Font11x18Packed.Def(), Font11x18};
+    CheckAll(&font);
+}
+
+void test_font_16x26_digits(void){
+    FONT_CASE_t font = {Font16x26Digits.Def(), Font16x26};
+    CheckAll(&font);
+}
+
+void test_character_outside_the_font_is_refused(void){
+    static constexpr auto digits = PackFont<7, 10, '0', '9'>(Font7x10);
+    FONT_CASE_t font = {digits.Def(), Font7x10};
+
+    display.GotoXY(0, 0);
+    TEST_ASSERT_EQUAL(0, display.Putc('A', font.Def, COLOR_WHITE));
+    TEST_ASSERT_EQUAL('5', display.Putc('5', font.Def, COLOR_WHITE));
+    ReferencePutc(0, 0, '5', &font, COLOR_WHITE);
+    AssertPanel("digits only");
+}
+
+/* a glyph ending on the last column or row is drawn, one a pixel further is refused */
+void test_glyph_at_the_edges(void){
+    FONT_CASE_t font = {Font6x8Packed.Def(), Font6x8};
+    uint16_t right = DISPLAY_WIDTH - 6;
+    uint16_t bottom = DISPLAY_HEIGHT - 8;
+
+    display.GotoXY(right, 0);
+    TEST_ASSERT_EQUAL('W', display.Putc('W', font.Def, COLOR_WHITE));
+    ReferencePutc(right, 0, 'W', &font, COLOR_WHITE);
+    display.GotoXY(0, bottom);
+    TEST_ASSERT_EQUAL('8', display.Putc('8', font.Def, COLOR_WHITE));
+    ReferencePutc(0, bottom, '8', &font, COLOR_WHITE);
+    display.GotoXY(right, bottom - 3);
+    TEST_ASSERT_EQUAL('#', display.Putc('#', font.Def, COLOR_WHITE));
+    ReferencePutc(right, bottom - 3, '#', &font, COLOR_WHITE);
+
+    display.GotoXY(right + 1, 20);
+    TEST_ASSERT_EQUAL(0, display.Putc('W', font.Def, COLOR_WHITE));
+    display.GotoXY(20, bottom + 1);
+    TEST_ASSERT_EQUAL(0, display.Putc('W', font.Def, COLOR_WHITE));
+    AssertPanel("edges");
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_font_6x8);
+    RUN_TEST(test_font_7x10);
+    RUN_TEST(test_font_11x18);
+    RUN_TEST(test_font_16x26_digits);
+    RUN_TEST(test_character_outside_the_font_is_refused);
+    RUN_TEST(test_glyph_at_the_edges);
+    return UNITY_END();
+}
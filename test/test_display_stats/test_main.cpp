@@ -0,0 +1,225 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Display and I2C counters: frames, windows and bytes count what reached the *
+ * panel, failed updates count nothing but stay dirty, latency covers the     *
+ * bus time and flush cycles only the CPU's share of it.                      *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "display.h"
+
+/* long enough for a full frame, or a failed one with its recovery, at 400 kHz */
+#define FRAME_CYCLES    (40 * 96000)
+
+/* one full frame window on the wire: commands and pixels, control bytes not counted */
+#define FRAME_BYTES     (6 + DISPLAY_WIDTH * DISPLAY_PAGES)
+
+static NATIVE_I2C_DEVICE_t panel;
+static I2C bus;
+static Display display(&bus);
+static uint32_t doneCalls;
+
+static void Done(void* context){
+    (*(uint32_t*)context)++;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&panel, 0, sizeof(panel));
+    panel.Saddr = DISPLAY_I2C_ADDR;
+    NATIVE_I2C_Attach(&panel);
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    display = Display(&bus);
+    display.Init();
+    display.ResetStats();
+    doneCalls = 0;
+}
+
+void tearDown(void){}
+
+/* the panel stops answering its address */
+static void Unplug(void){
+    panel.Saddr = DISPLAY_I2C_ADDR + 1;
+}
+
+static void Plug(void){
+    panel.Saddr = DISPLAY_I2C_ADDR;
+}
+
+void test_blocking_frame_counts(void){
+    display.Invalidate();
+    display.UpdateScreen();
+
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Windows);
+    TEST_ASSERT_EQUAL_UINT32(FRAME_BYTES, stats.Bytes);
+    TEST_ASSERT_EQUAL_UINT32(stats.LastLatency, stats.WorstLatency);
+    // a blocking update spins for the whole transfer
+    TEST_ASSERT_GREATER_THAN(stats.LastLatency - stats.LastLatency / 50, stats.FlushCycles);
+}
+
+void test_latency_covers_the_wire_time(void){
+    NATIVE_I2C_STATS_t before = NATIVE_I2C_GetStats();
+
+    display.Invalidate();
+    display.UpdateScreen();
+
+    // two transactions from START to STOP, the latency is no shorter
+    uint32_t busy = NATIVE_I2C_GetStats().BusyCycles - before.BusyCycles;
+    TEST_ASSERT_GREATER_OR_EQUAL(busy * 99 / 100, display.GetStats().LastLatency);
+    TEST_ASSERT_LESS_THAN(busy + busy / 10, display.GetStats().LastLatency);
+}
+
+void test_clean_screen_counts_nothing(void){
+    display.UpdateScreen();
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    NATIVE_Run(FRAME_CYCLES);
+
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Windows);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Bytes);
+    // nor any time, so it does not pull the average down
+    TEST_ASSERT_EQUAL_UINT32(0, stats.FlushCycles);
+}
+
+void test_failed_blocking_update_counts_nothing_and_stays_dirty(void){
+    display.Invalidate();
+    Unplug();
+    display.UpdateScreen();
+
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Windows);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Bytes);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.LastLatency);
+    TEST_ASSERT_GREATER_THAN(0, display.GetBusStats().Nacks);
+
+    Plug();
+    display.UpdateScreen();
+    stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(FRAME_BYTES, stats.Bytes);
+}
+
+void test_failed_flush_rect_counts_nothing(void){
+    Unplug();
+    display.FlushRect(0, 0, 16, 8);
+
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Windows);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Bytes);
+
+    Plug();
+    display.FlushRect(0, 0, 16, 8);
+    stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(6 + 16, stats.Bytes);
+}
+
+void test_async_frame_counts_on_completion(void){
+    display.Invalidate();
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+
+    // nothing has reached the panel yet
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Bytes);
+
+    NATIVE_Run(FRAME_CYCLES);
+    stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Windows);
+    TEST_ASSERT_EQUAL_UINT32(FRAME_BYTES, stats.Bytes);
+    // the interrupts take a small part of the time the frame is on the wire
+    TEST_ASSERT_GREATER_THAN(0, stats.FlushCycles);
+    TEST_ASSERT_LESS_THAN(stats.LastLatency / 10, stats.FlushCycles);
+}
+
+void test_failed_async_update_counts_nothing_and_stays_dirty(void){
+    display.Invalidate();
+    Unplug();
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync(Done, &doneCalls));
+    NATIVE_Run(FRAME_CYCLES);
+
+    TEST_ASSERT_FALSE(display.IsUpdateBusy());
+    TEST_ASSERT_EQUAL_UINT32(1, doneCalls);
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Windows);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Bytes);
+
+    Plug();
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    NATIVE_Run(FRAME_CYCLES);
+    stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(FRAME_BYTES, stats.Bytes);
+}
+
+void test_partial_async_update_counts_the_windows_sent(void){
+    uint32_t written = NATIVE_I2C_GetStats().Written;
+
+    // two windows; the panel drops off the bus once the first is on the wire
+    display.DrawPixel(0, 0, COLOR_WHITE);
+    display.DrawPixel(127, 63, COLOR_WHITE);
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+    while (NATIVE_I2C_GetStats().Written - written < 1 + 6 + 1 + 1){
+        NATIVE_Run(100);
+    }
+    Unplug();
+    NATIVE_Run(FRAME_CYCLES);
+
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.Windows);
+    TEST_ASSERT_EQUAL_UINT32(6 + 1, stats.Bytes);
+}
+
+void test_snapshot_leaves_interrupts_as_they_were(void){
+    display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, native_primask);
+
+    __disable_irq();
+    display.GetStats();
+    display.ResetStats();
+    TEST_ASSERT_EQUAL_UINT32(1, native_primask);
+    __enable_irq();
+}
+
+void test_reset_clears_display_and_bus_counters(void){
+    display.Invalidate();
+    display.UpdateScreen();
+    display.ResetStats();
+
+    DISPLAY_STATS_t stats = display.GetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Frames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Bytes);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.WorstLatency);
+    TEST_ASSERT_EQUAL_UINT32(0, display.GetBusStats().Transactions);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_blocking_frame_counts);
+    RUN_TEST(test_latency_covers_the_wire_time);
+    RUN_TEST(test_clean_screen_counts_nothing);
+    RUN_TEST(test_failed_blocking_update_counts_nothing_and_stays_dirty);
+    RUN_TEST(test_failed_flush_rect_counts_nothing);
+    RUN_TEST(test_async_frame_counts_on_completion);
+    RUN_TEST(test_failed_async_update_counts_nothing_and_stays_dirty);
+    RUN_TEST(test_partial_async_update_counts_the_windows_sent);
+    RUN_TEST(test_snapshot_leaves_interrupts_as_they_were);
+    RUN_TEST(test_reset_clears_display_and_bus_counters);
+    return UNITY_END();
+}
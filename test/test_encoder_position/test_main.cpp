@@ -0,0 +1,164 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Encoder position from a 16 bit view of the counter: random steps both ways *
+ * right through the wrap against a 64 bit truth, the 32 bit TIM2 counter     *
+ * read the same way, and the reset, snapshot and angle built on top.         *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "encoder.h"
+
+/* one control tick at 1 kHz */
+#define TICK_CYCLES     96000
+
+static TIM_HandleTypeDef Handle(TIM_TypeDef* instance){
+    TIM_HandleTypeDef handle = {0};
+    handle.Instance = instance;
+    return handle;
+}
+
+static Encoder wheel(Handle(TIM4), GPIO_PIN_6, GPIO_PIN_7, GPIOB, GPIOB, GPIO_AF2_TIM4);
+static uint32_t seed;
+static uint32_t now;
+
+static uint32_t Random(uint32_t n){
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    wheel = Encoder(Handle(TIM4), GPIO_PIN_6, GPIO_PIN_7, GPIOB, GPIOB, GPIO_AF2_TIM4);
+    wheel.Init();
+    seed = 7;
+    now = 0;
+}
+
+void tearDown(void){}
+
+/* the simulated counter moves by 'step' and the tick reads it */
+static void Tick(int64_t* counter, int32_t step){
+    *counter += step;
+    now += TICK_CYCLES;
+    wheel.Update((uint16_t)*counter, now);
+}
+
+void test_count_delta_across_the_wrap(void){
+    TEST_ASSERT_EQUAL_INT16(5, Encoder::CountDelta(2, 65533));
+    TEST_ASSERT_EQUAL_INT16(-5, Encoder::CountDelta(65533, 2));
+    TEST_ASSERT_EQUAL_INT16(0, Encoder::CountDelta(40000, 40000));
+    TEST_ASSERT_EQUAL_INT16(32767, Encoder::CountDelta(32767, 0));
+    TEST_ASSERT_EQUAL_INT16(-32767, Encoder::CountDelta(1, 32768));
+    // half a turn of the counter is where it becomes ambiguous
+    TEST_ASSERT_EQUAL_INT16(-32768, Encoder::CountDelta(32768, 0));
+}
+
+/* random steps of up to 600 counts either way, starting just below the wrap */
+void test_random_steps_match_the_truth(void){
+    int64_t counter = 65000;
+    int64_t start = counter;
+
+    wheel.Update((uint16_t)counter, now);
+    int32_t offset = wheel.Position();
+
+    for (uint32_t i = 0; i < 200000; i++){
+        int32_t step = (int32_t)Random(1201) - 600;
+        // drift one way for a while, so the position runs well past 16 bits
+        step += (i / 50000) % 2 ? -150 : 150;
+        Tick(&counter, step);
+        if (wheel.Position() != (int32_t)(counter - start) + offset){
+            char message[64];
+            snprintf(message, sizeof(message), "update %lu", (unsigned long)i);
+            TEST_FAIL_MESSAGE(message);
+        }
+        TEST_ASSERT_EQUAL_INT16(step, wheel.Delta());
+    }
+}
+
+/* the biggest step one Update can still tell the direction of */
+void test_largest_step(void){
+    int64_t counter = 65530;
+
+    wheel.Update((uint16_t)counter, now);
+    int32_t before = wheel.Position();
+    Tick(&counter, 32767);
+    TEST_ASSERT_EQUAL_INT32(before + 32767, wheel.Position());
+    Tick(&counter, -32767);
+    TEST_ASSERT_EQUAL_INT32(before, wheel.Position());
+}
+
+/* Update() reads CNT itself, and only its low 16 bits, so the 32 bit TIM2
+   counter wraps as TIM4 does */
+void test_32_bit_counter_read_as_16(void){
+    Encoder left(Handle(TIM2), GPIO_PIN_15, GPIO_PIN_3, GPIOA, GPIOB, GPIO_AF1_TIM2);
+
+    left.Init();
+    TIM2->CNT = 0x0000FFF0;
+    left.Update();
+    int32_t base = left.Position();
+    TIM2->CNT = 0x00010010;
+    left.Update();
+    TEST_ASSERT_EQUAL_INT32(base + 0x20, left.Position());
+    TIM2->CNT = 0xFFFFFFF0;
+    left.Update();
+    TEST_ASSERT_EQUAL_INT32(base, left.Position());     // low half 0xFFF0 again
+}
+
+void test_snapshot_and_reset(void){
+    int64_t counter = 0;
+
+    for (uint8_t i = 0; i < 10; i++){
+        Tick(&counter, 100);
+    }
+    Tick(&counter, -30);
+
+    ENCODER_SNAPSHOT_t snapshot = wheel.Snapshot();
+    TEST_ASSERT_EQUAL_INT32(970, snapshot.Position);
+    TEST_ASSERT_EQUAL_INT16(-30, snapshot.Delta);
+    TEST_ASSERT_EQUAL_UINT32(11, snapshot.Updates);
+
+    TIM4->CNT = 1234;
+    wheel.ResetCount();
+    TEST_ASSERT_EQUAL_UINT32(0, TIM4->CNT);
+    snapshot = wheel.Snapshot();
+    TEST_ASSERT_EQUAL_INT32(0, snapshot.Position);
+    TEST_ASSERT_EQUAL_INT16(0, snapshot.Delta);
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.Updates);
+
+    // counting carries on from the cleared counter
+    counter = 0;
+    Tick(&counter, 25);
+    TEST_ASSERT_EQUAL_INT32(25, wheel.Position());
+}
+
+void test_angle_from_position(void){
+    int64_t counter = 0;
+
+    wheel.SetCountsPerRev(1440);
+    Tick(&counter, 360);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.5707963f, wheel.GetAngle());
+
+    // past the 16 bit wrap the angle keeps growing
+    for (uint8_t i = 0; i < 100; i++){
+        Tick(&counter, 1440);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 100.25f * 6.2831853f, wheel.GetAngle());
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_count_delta_across_the_wrap);
+    RUN_TEST(test_random_steps_match_the_truth);
+    RUN_TEST(test_largest_step);
+    RUN_TEST(test_32_bit_counter_read_as_16);
+    RUN_TEST(test_snapshot_and_reset);
+    RUN_TEST(test_angle_from_position);
+    return UNITY_END();
+}
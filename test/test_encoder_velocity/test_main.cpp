@@ -0,0 +1,225 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Encoder velocity: the 32 bit rate against a double reference over the      *
+ * whole range of counts and times, the IIR rounding the same both ways, and  *
+ * the M/T estimate on a simulated wheel at speed, slowly, reversed and       *
+ * stopping.                                                                  *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include <math.h>
+#include "native.h"
+#include "encoder.h"
+
+/* one control tick at 1 kHz */
+#define TICK_CYCLES     96000
+
+static TIM_HandleTypeDef Handle(TIM_TypeDef* instance){
+    TIM_HandleTypeDef handle = {0};
+    handle.Instance = instance;
+    return handle;
+}
+
+static Encoder wheel(Handle(TIM4), GPIO_PIN_6, GPIO_PIN_7, GPIOB, GPIOB, GPIO_AF2_TIM4);
+static Encoder mirror(Handle(TIM2), GPIO_PIN_15, GPIO_PIN_3, GPIOA, GPIOB, GPIO_AF1_TIM2);
+static uint32_t seed;
+
+/* the simulated wheel: position in counts, time in cycles */
+static double position;
+static uint32_t now;
+
+static uint32_t Random(uint32_t n){
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    wheel = Encoder(Handle(TIM4), GPIO_PIN_6, GPIO_PIN_7, GPIOB, GPIOB, GPIO_AF2_TIM4);
+    wheel.Init();
+    mirror = Encoder(Handle(TIM2), GPIO_PIN_15, GPIO_PIN_3, GPIOA, GPIOB, GPIO_AF1_TIM2);
+    mirror.Init();
+    seed = 3;
+    position = 0;
+    // a first tick, so both time their next estimate from 'now'
+    now = NATIVE_Cycles();
+    wheel.Update(0, now);
+    mirror.Update(0, now);
+}
+
+void tearDown(void){}
+
+/* counts/s Q8 of 'counts' over 'cycles', to the nearest */
+static double Reference(int32_t counts, uint32_t cycles){
+    return (double)counts * SystemCoreClock * 256.0 / cycles;
+}
+
+/******************************************************************************
+ * Without captured edges every estimate is the plain count difference over   *
+ * the time since the previous Update, i.e. Rate itself.  Within half a Q8    *
+ * unit per count (the rate of one count is rounded) and, past 2^24 cycles,   *
+ * the 8 bits the prescaling drops.  Pairs whose rate does not fit counts/s   *
+ * Q8 in 32 bits are outside the range and skipped.                           *
+ ******************************************************************************/
+void test_rate_matches_reference(void){
+    static const int32_t counts[] = {1, -1, 4, 7, -13, 24, 100, -999, 3000, 32767, -32767};
+    static const uint32_t cycles[] = {96, 1000, 12345, 95997, 96000, 96001, 1000000, 9600000,
+                                      16777215, 16777216, 16777217, 200000000, 4000000000UL};
+    uint32_t checked = 0;
+
+    for (uint8_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++){
+        for (uint8_t t = 0; t < sizeof(cycles) / sizeof(cycles[0]); t++){
+            double reference = Reference(counts[c], cycles[t]);
+            if (fabs(reference) >= 2147483647.0){
+                continue;
+            }
+            position += counts[c];
+            now += cycles[t];
+            wheel.Update((uint16_t)(int32_t)position, now);
+
+            double tolerance = fabs((double)counts[c]) / 2 + 1 + fabs(reference) / 65536;
+            char message[64];
+            snprintf(message, sizeof(message), "%ld counts over %lu cycles", (long)counts[c], (unsigned long)cycles[t]);
+            TEST_ASSERT_FLOAT_WITHIN_MESSAGE(tolerance, reference, (double)wheel.RawVelocity(), message);
+            checked++;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(100, checked);
+}
+
+/* random count steps against their mirror image: the filtered velocities
+   stay exactly opposite, and a steady input is met within the rounding */
+void test_filter_is_symmetric(void){
+    for (uint8_t shift = 0; shift <= 4; shift++){
+        double counter = 0;
+
+        setUp();
+        wheel.SetVelocityFilter(shift);
+        mirror.SetVelocityFilter(shift);
+        for (uint16_t i = 0; i < 2000; i++){
+            int32_t step = (i < 1500) ? (int32_t)Random(61) - 30 : 17;
+            counter += step;
+            now += TICK_CYCLES;
+            wheel.Update((uint16_t)(int32_t)counter, now);
+            mirror.Update((uint16_t)(int32_t)-counter, now);
+            TEST_ASSERT_EQUAL_INT32(-wheel.RawVelocity(), mirror.RawVelocity());
+            TEST_ASSERT_EQUAL_INT32_MESSAGE(-wheel.Velocity(), mirror.Velocity(), "mirrored filter");
+        }
+        // 17 counts a tick is 17000 counts/s
+        int32_t half = (1 << shift) / 2;
+        TEST_ASSERT_INT32_WITHIN(half, 17000 * 256, wheel.Velocity());
+        TEST_ASSERT_INT32_WITHIN(half, -17000 * 256, mirror.Velocity());
+    }
+}
+
+/******************************************************************************
+ * The simulated wheel at 'speed' counts/s for 'ticks' control ticks: TI1     *
+ * rises every ENC_COUNTS_PER_EDGE counts, the last edge of each tick is      *
+ * captured with its exact time, then the tick reads the counter.             *
+ ******************************************************************************/
+static void Run(Encoder* encoder, double speed, uint32_t ticks){
+    double perCycle = speed / SystemCoreClock;
+
+    for (uint32_t i = 0; i < ticks; i++){
+        double next = position + perCycle * TICK_CYCLES;
+        double low = fmin(position, next), high = fmax(position, next);
+        double edge = (speed > 0) ? floor(high / ENC_COUNTS_PER_EDGE) * ENC_COUNTS_PER_EDGE
+                                  : ceil(low / ENC_COUNTS_PER_EDGE) * ENC_COUNTS_PER_EDGE;
+
+        if (speed != 0 && edge > low && edge <= high){
+            uint32_t at = now + (uint32_t)((edge - position) / perCycle);
+            encoder->Capture((uint16_t)(int32_t)edge, at);
+        }
+        position = next;
+        now += TICK_CYCLES;
+        encoder->Update((uint16_t)(int32_t)floor(position), now);
+    }
+}
+
+static void AssertSpeed(double speed, double relative){
+    double expected = speed * 256;
+    char message[48];
+
+    snprintf(message, sizeof(message), "%g counts/s", speed);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(fabs(expected) * relative + 256, expected, (double)wheel.Velocity(), message);
+}
+
+void test_slow_wheel_uses_edge_times(void){
+    static const double speeds[] = {50, 200, 555, 2345, -333, -4321};
+
+    for (uint8_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++){
+        setUp();
+        Run(&wheel, speeds[s], 400);
+        TEST_ASSERT_TRUE(wheel.IsEdgeTiming());
+        AssertSpeed(speeds[s], 0.01);
+    }
+}
+
+void test_fast_wheel_uses_counts(void){
+    static const double speeds[] = {27777, 61234, -45000};
+
+    for (uint8_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++){
+        setUp();
+        Run(&wheel, speeds[s], 200);
+        TEST_ASSERT_FALSE(wheel.IsEdgeTiming());
+        // within a count per tick
+        AssertSpeed(speeds[s], 1000.0 / fabs(speeds[s]));
+    }
+}
+
+/* edge timing goes off above ENC_MT_HIGH_COUNTS a tick and back on below
+   ENC_MT_LOW_COUNTS, not in between */
+void test_range_hysteresis(void){
+    Run(&wheel, (ENC_MT_HIGH_COUNTS + 2) * 1000.0, 5);
+    TEST_ASSERT_FALSE(wheel.IsEdgeTiming());
+    Run(&wheel, (ENC_MT_LOW_COUNTS + ENC_MT_HIGH_COUNTS) * 500.0, 5);
+    TEST_ASSERT_FALSE(wheel.IsEdgeTiming());
+    Run(&wheel, (ENC_MT_LOW_COUNTS - 2) * 1000.0, 5);
+    TEST_ASSERT_TRUE(wheel.IsEdgeTiming());
+    Run(&wheel, (ENC_MT_LOW_COUNTS + ENC_MT_HIGH_COUNTS) * 500.0, 5);
+    TEST_ASSERT_TRUE(wheel.IsEdgeTiming());
+}
+
+/* after the last edge the estimate falls, and is nothing after ENC_STOP_MS */
+void test_stop(void){
+    Run(&wheel, 300, 300);
+    AssertSpeed(300, 0.01);
+    Run(&wheel, 0, ENC_STOP_MS / 2);
+    TEST_ASSERT_LESS_THAN(300 * 256, wheel.RawVelocity());
+    Run(&wheel, 0, ENC_STOP_MS / 2 + 50);
+    TEST_ASSERT_EQUAL_INT32(0, wheel.RawVelocity());
+    TEST_ASSERT_INT32_WITHIN(ENC_VELOCITY_FILTER ? (1 << ENC_VELOCITY_FILTER) / 2 : 0, 0, wheel.Velocity());
+}
+
+/* two edges 1.5 s apart, well past the 2^24 cycles where Rate prescales */
+void test_edges_far_apart(void){
+    wheel.SetVelocityFilter(0);
+    Run(&wheel, 100, 100);
+    Run(&wheel, 0, 2000);
+    TEST_ASSERT_EQUAL_INT32(0, wheel.RawVelocity());
+
+    // one edge per 1.5 s from here, each in the last tick of a run
+    position = ceil(position / ENC_COUNTS_PER_EDGE) * ENC_COUNTS_PER_EDGE + 0.001;
+    Run(&wheel, ENC_COUNTS_PER_EDGE / 1.5, 1500);
+    Run(&wheel, ENC_COUNTS_PER_EDGE / 1.5, 1500);
+    TEST_ASSERT_TRUE(wheel.IsEdgeTiming());
+    TEST_ASSERT_FLOAT_WITHIN(2, Reference(ENC_COUNTS_PER_EDGE, 1500 * TICK_CYCLES), (double)wheel.RawVelocity());
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_rate_matches_reference);
+    RUN_TEST(test_filter_is_symmetric);
+    RUN_TEST(test_slow_wheel_uses_edge_times);
+    RUN_TEST(test_fast_wheel_uses_counts);
+    RUN_TEST(test_range_hysteresis);
+    RUN_TEST(test_stop);
+    RUN_TEST(test_edges_far_apart);
+    return UNITY_END();
+}
@@ -0,0 +1,161 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * The number formatter against the host's printf, which rounds exactly.     *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "format.h"
+
+#define RANDOM_VALUES   200000
+
+static uint32_t seed;
+
+void setUp(void){
+    seed = 2024;
+}
+
+void tearDown(void){}
+
+static uint32_t Random(void){
+    seed = seed * 1664525 + 1013904223;
+    return seed ^ (seed >> 15);
+}
+
+/* the formatter's output, terminated */
+static char result[FORMAT_MAX_CHARS + 1];
+
+static const char* Uint(uint32_t value){
+    result[FORMAT_Uint32(result, value)] = 0;
+    return result;
+}
+
+static const char* Int(int32_t value){
+    result[FORMAT_Int32(result, value)] = 0;
+    return result;
+}
+
+static const char* Fixed(int32_t value, uint8_t fracBits, uint8_t places){
+    result[FORMAT_Fixed(result, value, fracBits, places)] = 0;
+    return result;
+}
+
+static const char* Float(float value, uint8_t places){
+    result[FORMAT_Float(result, value, places)] = 0;
+    return result;
+}
+
+void test_uint32(void){
+    static const uint32_t values[] = {0, 1, 9, 10, 99, 100, 999999999, 1000000000, 4294967295u};
+    char expected[16];
+
+    for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++){
+        snprintf(expected, sizeof(expected), "%lu", (unsigned long)values[i]);
+        TEST_ASSERT_EQUAL_STRING(expected, Uint(values[i]));
+    }
+}
+
+void test_int32(void){
+    char expected[16];
+
+    TEST_ASSERT_EQUAL_STRING("0", Int(0));
+    TEST_ASSERT_EQUAL_STRING("-1", Int(-1));
+    TEST_ASSERT_EQUAL_STRING("2147483647", Int(INT32_MAX));
+    TEST_ASSERT_EQUAL_STRING("-2147483648", Int(INT32_MIN));
+    for (uint32_t i = 0; i < RANDOM_VALUES; i++){
+        int32_t value = (int32_t)Random();
+        snprintf(expected, sizeof(expected), "%ld", (long)value);
+        TEST_ASSERT_EQUAL_STRING(expected, Int(value));
+    }
+}
+
+void test_fixed_matches_printf(void){
+    char expected[48];
+
+    for (uint32_t i = 0; i < RANDOM_VALUES; i++){
+        int32_t value = (int32_t)Random();
+        uint8_t fracBits = Random() % 32;
+        uint8_t places = Random() % (FORMAT_MAX_PLACES + 1);
+
+        // exact in long double: 64 bit mantissa
+        snprintf(expected, sizeof(expected), "%.*Lf", places, (long double)value / ldexpl(1, fracBits));
+        TEST_ASSERT_EQUAL_STRING(expected, Fixed(value, fracBits, places));
+    }
+}
+
+void test_fixed_ties_round_to_even(void){
+    TEST_ASSERT_EQUAL_STRING("0.12", Fixed(0x2000, 16, 2));         // 0.125
+    TEST_ASSERT_EQUAL_STRING("0.38", Fixed(0x6000, 16, 2));         // 0.375
+    TEST_ASSERT_EQUAL_STRING("2", Fixed(5, 1, 0));                  // 2.5
+    TEST_ASSERT_EQUAL_STRING("4", Fixed(7, 1, 0));                  // 3.5
+    TEST_ASSERT_EQUAL_STRING("1.000", Fixed(65509, 16, 3));         // 0.99959 carries
+    TEST_ASSERT_EQUAL_STRING("-0.00", Fixed(-1, 16, 2));
+}
+
+void test_float_matches_printf(void){
+    char expected[48];
+
+    for (uint32_t i = 0; i < RANDOM_VALUES; i++){
+        uint32_t bits = Random();
+        float value;
+        uint8_t places = Random() % 7;
+
+        memcpy(&value, &bits, sizeof(value));
+        // exact while the fraction has no bits below 2^-32 and the whole part fits 32 bits
+        if (!(fabsf(value) >= 0.001953125f && fabsf(value) < 4294967296.0f)){
+            value = (float)((int32_t)(bits % 2000001) - 1000000) / 1000.0f;
+        }
+        snprintf(expected, sizeof(expected), "%.*f", places, value);
+        TEST_ASSERT_EQUAL_STRING(expected, Float(value, places));
+    }
+}
+
+void test_float_keeps_the_sign_of_zero(void){
+    TEST_ASSERT_EQUAL_STRING("-0", Float(-0.0f, 0));
+    TEST_ASSERT_EQUAL_STRING("-0.000", Float(-0.0f, 3));
+    TEST_ASSERT_EQUAL_STRING("0.000", Float(0.0f, 3));
+}
+
+void test_float_keeps_the_sign_of_negatives_rounding_to_zero(void){
+    TEST_ASSERT_EQUAL_STRING("-0.00", Float(-0.004f, 2));
+    TEST_ASSERT_EQUAL_STRING("-0", Float(-0.4f, 0));
+    TEST_ASSERT_EQUAL_STRING("-0.000000000", Float(-1e-12f, 9));
+    TEST_ASSERT_EQUAL_STRING("-0.01", Float(-0.006f, 2));
+}
+
+void test_float_specials(void){
+    TEST_ASSERT_EQUAL_STRING("nan", Float(NAN, 2));
+    TEST_ASSERT_EQUAL_STRING("nan", Float(-NAN, 2));
+    TEST_ASSERT_EQUAL_STRING("inf", Float(INFINITY, 2));
+    TEST_ASSERT_EQUAL_STRING("-inf", Float(-INFINITY, 2));
+    TEST_ASSERT_EQUAL_STRING("-inf", Float(-5e9f, 0));
+    TEST_ASSERT_EQUAL_STRING("4294967040", Float(4294967040.0f, 0));   // largest float below 2^32
+}
+
+void test_places_are_clamped(void){
+    TEST_ASSERT_EQUAL_STRING("0.500000000", Float(0.5f, 20));
+    TEST_ASSERT_EQUAL_STRING("-2147483648.000000000", Fixed(INT32_MIN, 0, 20));
+    TEST_ASSERT_EQUAL_UINT8(FORMAT_MAX_CHARS, strlen(result));
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_uint32);
+    RUN_TEST(test_int32);
+    RUN_TEST(test_fixed_matches_printf);
+    RUN_TEST(test_fixed_ties_round_to_even);
+    RUN_TEST(test_float_matches_printf);
+    RUN_TEST(test_float_keeps_the_sign_of_zero);
+    RUN_TEST(test_float_keeps_the_sign_of_negatives_rounding_to_zero);
+    RUN_TEST(test_float_specials);
+    RUN_TEST(test_places_are_clamped);
+    return UNITY_END();
+}
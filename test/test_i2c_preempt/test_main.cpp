@@ -0,0 +1,259 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Sensor reads cutting into display flushes on one bus: a high request       *
+ * waits at most I2C_HIGH_WAIT_US, the flush is resumed where it was cut and  *
+ * the panel (an SSD1306Model fed from the wire) ends up as if nothing had    *
+ * come between.                                                              *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "display.h"
+#include "ssd1306model.h"
+
+#define SENSOR_ADDR     0x50
+#define SENSOR_BYTES    6
+
+/* cycles per microsecond of the modelled core */
+#define CYCLES_PER_US   96
+
+static NATIVE_I2C_DEVICE_t oled;
+static NATIVE_I2C_DEVICE_t sensor;
+static SSD1306Model panel;
+static I2C bus;
+static Display display(&bus);
+static bool reference[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+static uint32_t seed;
+
+static uint32_t Random(uint32_t n){
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+}
+
+static void PanelListener(uint8_t event, uint8_t value, void* context){
+    SSD1306Model* model = (SSD1306Model*)context;
+
+    if (event == NATIVE_I2C_START){
+        model->Begin();
+    } else if (event == NATIVE_I2C_WRITE){
+        model->Byte(value);
+    }
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&oled, 0, sizeof(oled));
+    oled.Saddr = DISPLAY_I2C_ADDR;
+    oled.Listener = PanelListener;
+    oled.Context = &panel;
+    NATIVE_I2C_Attach(&oled);
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.Saddr = SENSOR_ADDR;
+    sensor.RegLen = 1;
+    for (uint16_t i = 0; i < sizeof(sensor.Memory); i++){
+        sensor.Memory[i] = (uint8_t)(i ^ 0x5A);
+    }
+    NATIVE_I2C_Attach(&sensor);
+    panel.Reset();
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    display = Display(&bus);
+    display.Init();
+    memset(reference, 0, sizeof(reference));
+    seed = 1;
+}
+
+void tearDown(void){}
+
+static void Fill(uint16_t x, uint16_t y, uint16_t w, uint16_t h, DISPLAY_COLOR_t color){
+    display.FillRectangle(x, y, w, h, color);
+    for (uint16_t r = y; r < y + h && r < DISPLAY_HEIGHT; r++){
+        for (uint16_t c = x; c < x + w && c < DISPLAY_WIDTH; c++){
+            reference[r][c] = (color == COLOR_INVERSE) ? !reference[r][c] : (color == COLOR_WHITE);
+        }
+    }
+}
+
+static void RandomScene(void){
+    static const DISPLAY_COLOR_t colors[] = {COLOR_WHITE, COLOR_BLACK, COLOR_INVERSE};
+
+    for (uint8_t i = 0; i < 6; i++){
+        Fill(Random(DISPLAY_WIDTH), Random(DISPLAY_HEIGHT), 1 + Random(80), 1 + Random(40), colors[Random(3)]);
+    }
+}
+
+static void AssertPanel(const char* what){
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            if (panel.Pixel(x, y) != reference[y][x]){
+                char message[64];
+                snprintf(message, sizeof(message), "%s: pixel %u,%u", what, x, y);
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+    }
+}
+
+static void StartRead(I2C_REQUEST_t* request, char* buffer, uint8_t reg){
+    memset(request, 0, sizeof(*request));
+    request->Saddr = SENSOR_ADDR;
+    request->Reg = reg;
+    request->RegLen = 1;
+    request->Dir = I2C_DIR_READ;
+    request->Buffer = buffer;
+    request->Length = SENSOR_BYTES;
+    request->Priority = I2C_PRIO_HIGH;
+    TEST_ASSERT_TRUE(bus.i2c_Submit(request));
+}
+
+static void CheckRead(I2C_REQUEST_t* request, char* buffer){
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, request->Status);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[request->Reg], buffer, SENSOR_BYTES);
+}
+
+/* the chunk a high request may find ahead of it, at 400 kHz and 500 us */
+void test_chunk_size(void){
+    TEST_ASSERT_EQUAL_UINT16(17, bus.i2c_GetChunkBytes());
+}
+
+/* nobody waiting: a full frame goes out without a single cut */
+void test_no_preemption_without_high_requests(void){
+    NATIVE_I2C_STATS_t before = NATIVE_I2C_GetStats();
+
+    Fill(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, COLOR_WHITE);
+    display.UpdateScreenAsync();
+    while (display.IsUpdateBusy()){
+        NATIVE_Run(10000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, bus.i2c_GetStats().Preemptions);
+    // one window: command and data transactions only
+    TEST_ASSERT_EQUAL_UINT32(2, NATIVE_I2C_GetStats().Starts - before.Starts);
+    AssertPanel("whole frame");
+}
+
+/******************************************************************************
+ * Reads submitted at random 0.2 to 2 ms intervals across a run of random     *
+ * frames: every read starts within the budget and returns the sensor's       *
+ * bytes, and every frame lands as drawn.                                     *
+ ******************************************************************************/
+void test_reads_cut_into_flushes(void){
+    I2C_REQUEST_t request;
+    char buffer[SENSOR_BYTES];
+    uint32_t reads = 0;
+
+    request.Status = I2C_REQ_DONE;
+    for (uint8_t frame = 0; frame < 30; frame++){
+        RandomScene();
+        if (frame % 5 == 0){
+            display.Invalidate();           // a full frame now and then
+        }
+        TEST_ASSERT_TRUE(display.UpdateScreenAsync());
+
+        while (display.IsUpdateBusy()){
+            NATIVE_Run((200 + Random(1800)) * CYCLES_PER_US);
+            if (request.Status != I2C_REQ_PENDING){
+                if (reads > 0){
+                    CheckRead(&request, buffer);
+                }
+                StartRead(&request, buffer, (uint8_t)Random(250));
+                reads++;
+            }
+        }
+        AssertPanel("frame");
+    }
+    while (request.Status == I2C_REQ_PENDING){
+        NATIVE_Run(1000);
+    }
+    CheckRead(&request, buffer);
+
+    I2C_STATS_t stats = bus.i2c_GetStats();
+    TEST_ASSERT_EQUAL_UINT32(reads, stats.HighRequests);
+    TEST_ASSERT_GREATER_THAN_UINT32(reads / 2, stats.Preemptions);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.HighLate);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(I2C_HIGH_WAIT_US * CYCLES_PER_US, stats.HighWaitWorst);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Nacks + stats.BusErrors + stats.Timeouts);
+}
+
+/* a blocking flush gives way the same, to reads queued from the panel's
+   side of the wire every so many bytes, i.e. in the middle of a chunk */
+static I2C_REQUEST_t wireRequest;
+static char wireBuffer[SENSOR_BYTES];
+static uint32_t wireReads;
+static uint32_t wireBytes;
+
+static void ReadingListener(uint8_t event, uint8_t value, void* context){
+    PanelListener(event, value, context);
+    if (event == NATIVE_I2C_WRITE && ++wireBytes % 50 == 0 && wireRequest.Status != I2C_REQ_PENDING){
+        StartRead(&wireRequest, wireBuffer, (uint8_t)(0x10 + wireReads));
+        wireReads++;
+    }
+}
+
+void test_blocking_flush_gives_way(void){
+    wireRequest.Status = I2C_REQ_DONE;
+    wireReads = 0;
+    wireBytes = 0;
+
+    RandomScene();
+    display.Invalidate();
+    oled.Listener = ReadingListener;
+    display.UpdateScreen();
+    oled.Listener = PanelListener;
+    while (wireRequest.Status == I2C_REQ_PENDING){
+        NATIVE_Run(1000);
+    }
+
+    AssertPanel("blocking");
+    CheckRead(&wireRequest, wireBuffer);
+    I2C_STATS_t stats = bus.i2c_GetStats();
+    TEST_ASSERT_GREATER_THAN_UINT32(10, wireReads);
+    // all but one landing in the flush's last chunk cut into it
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(wireReads - 1, stats.Preemptions);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.HighLate);
+}
+
+/* a write that is not splittable goes out whole, the read waits for it */
+void test_unsplittable_write_is_not_cut(void){
+    I2C_REQUEST_t write = {0};
+    I2C_REQUEST_t read;
+    char data[100];
+    char buffer[SENSOR_BYTES];
+
+    for (uint8_t i = 0; i < sizeof(data); i++){
+        data[i] = (char)(200 - i);
+    }
+    write.Saddr = SENSOR_ADDR;
+    write.Reg = 0x80;
+    write.RegLen = 1;
+    write.Dir = I2C_DIR_WRITE;
+    write.Buffer = data;
+    write.Length = sizeof(data);
+    TEST_ASSERT_TRUE(bus.i2c_Submit(&write));
+    NATIVE_Run(200 * CYCLES_PER_US);
+    StartRead(&read, buffer, 0x00);
+
+    while (read.Status == I2C_REQ_PENDING){
+        NATIVE_Run(1000);
+    }
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, write.Status);
+    CheckRead(&read, buffer);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, &sensor.Memory[0x80], sizeof(data));
+    TEST_ASSERT_EQUAL_UINT32(0, bus.i2c_GetStats().Preemptions);
+    TEST_ASSERT_EQUAL_UINT32(1, bus.i2c_GetStats().HighLate);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_chunk_size);
+    RUN_TEST(test_no_preemption_without_high_requests);
+    RUN_TEST(test_reads_cut_into_flushes);
+    RUN_TEST(test_blocking_flush_gives_way);
+    RUN_TEST(test_unsplittable_write_is_not_cut);
+    return UNITY_END();
+}
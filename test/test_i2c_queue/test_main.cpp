@@ -0,0 +1,354 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * The interrupt driven I2C engine against the bus model: every transfer      *
+ * shape the drivers use, what lands in the device, NACK recovery and         *
+ * requests submitted from a completion callback.                             *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "display.h"
+#include "ssd1306model.h"
+
+#define SENSOR_ADDR     0x50
+
+/* long enough for a full frame at 400 kHz */
+#define FRAME_CYCLES    (30 * 96000)
+
+static NATIVE_I2C_DEVICE_t sensor;
+static I2C bus;
+
+/* address bytes of every START, in order */
+static uint8_t starts[16];
+static uint8_t startCount;
+
+static void StartListener(uint8_t event, uint8_t value, void* context){
+    (void)context;
+    if (event == NATIVE_I2C_START && startCount < sizeof(starts)){
+        starts[startCount++] = value;
+    }
+}
+
+static void Done(void* context){
+    (*(uint32_t*)context)++;
+}
+
+static void Wait(I2C_REQUEST_t* request){
+    for (uint32_t i = 0; i < 100000 && request->Status == I2C_REQ_PENDING; i++){
+        NATIVE_Run(1000);
+    }
+}
+
+static void Idle(void){
+    for (uint32_t i = 0; i < 100000 && bus.i2c_IsBusy(); i++){
+        NATIVE_Run(1000);
+    }
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.Saddr = SENSOR_ADDR;
+    sensor.RegLen = 1;
+    sensor.Listener = StartListener;
+    for (uint16_t i = 0; i < sizeof(sensor.Memory); i++){
+        sensor.Memory[i] = (uint8_t)(i * 7 + 3);
+    }
+    NATIVE_I2C_Attach(&sensor);
+    startCount = 0;
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    bus.i2c_init();
+}
+
+void tearDown(void){}
+
+void test_write_byte_and_multi(void){
+    const char data[5] = {1, 2, 3, 4, 5};
+
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_writeByte(SENSOR_ADDR, 0x10, (char)0xA5));
+    TEST_ASSERT_EQUAL_HEX8(0xA5, sensor.Memory[0x10]);
+
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_WriteMulti(SENSOR_ADDR, 0x20, data, sizeof(data)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, &sensor.Memory[0x20], sizeof(data));
+    TEST_ASSERT_EQUAL_HEX8(0x20 * 7 + 3 + 5 * 7, sensor.Memory[0x25]);   // untouched
+}
+
+/* rows Stride apart in the source land back to back in the device */
+void test_strided_write(void){
+    char source[3 * 10];
+    uint8_t expected[3 * 4];
+
+    for (uint8_t i = 0; i < sizeof(source); i++){
+        source[i] = (char)(0x80 + i);
+    }
+    for (uint8_t r = 0; r < 3; r++){
+        for (uint8_t c = 0; c < 4; c++){
+            expected[r * 4 + c] = (uint8_t)source[r * 10 + c];
+        }
+    }
+
+    NATIVE_I2C_STATS_t before = NATIVE_I2C_GetStats();
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_WriteMultiStrided(SENSOR_ADDR, 0x40, source, 4, 3, 10));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, &sensor.Memory[0x40], sizeof(expected));
+    TEST_ASSERT_EQUAL_UINT32(1 + sizeof(expected), NATIVE_I2C_GetStats().Written - before.Written);
+    TEST_ASSERT_EQUAL_UINT32(1, NATIVE_I2C_GetStats().Starts - before.Starts);
+}
+
+/* no payload: the register byte alone sets the device's pointer */
+void test_register_only_write(void){
+    I2C_REQUEST_t request = {0};
+    request.Saddr = SENSOR_ADDR;
+    request.Reg = 0x33;
+    request.RegLen = 1;
+    request.Dir = I2C_DIR_WRITE;
+
+    NATIVE_I2C_STATS_t before = NATIVE_I2C_GetStats();
+    TEST_ASSERT_TRUE(bus.i2c_Submit(&request));
+    Wait(&request);
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, request.Status);
+    TEST_ASSERT_EQUAL_UINT16(0x33, sensor.Pointer);
+    TEST_ASSERT_EQUAL_UINT32(1, NATIVE_I2C_GetStats().Written - before.Written);
+    TEST_ASSERT_EQUAL_HEX8(0x33 * 7 + 3, sensor.Memory[0x33]);
+}
+
+/* every read length the engine handles differently: one byte, two (POS),
+   three (BTF tail), and the RX DMA from I2C_READ_DMA_MIN on */
+void test_read_lengths(void){
+    const uint16_t lengths[] = {1, 2, 3, I2C_READ_DMA_MIN, 5, 16, 64};
+
+    for (uint8_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++){
+        char buffer[64 + 1];
+        uint8_t reg = (uint8_t)(0x08 + l * 3);
+
+        memset(buffer, 0xEE, sizeof(buffer));
+        NATIVE_I2C_STATS_t before = NATIVE_I2C_GetStats();
+        TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_readMulti(SENSOR_ADDR, reg, buffer, lengths[l]));
+
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[reg], buffer, lengths[l]);
+        TEST_ASSERT_EQUAL_HEX8(0xEE, (uint8_t)buffer[lengths[l]]);
+        // the last byte was NACKed: the device gave no more than asked for
+        TEST_ASSERT_EQUAL_UINT32(lengths[l], NATIVE_I2C_GetStats().Read - before.Read);
+        TEST_ASSERT_EQUAL_UINT32(2, NATIVE_I2C_GetStats().Starts - before.Starts);
+    }
+}
+
+void test_read_16bit_register(void){
+    I2C_REQUEST_t request = {0};
+    char buffer[6];
+
+    sensor.RegLen = 2;
+    request.Saddr = SENSOR_ADDR;
+    request.Reg = 0x0123;
+    request.RegLen = 2;
+    request.Dir = I2C_DIR_READ;
+    request.Buffer = buffer;
+    request.Length = sizeof(buffer);
+    request.Priority = I2C_PRIO_HIGH;
+
+    NATIVE_I2C_STATS_t before = NATIVE_I2C_GetStats();
+    TEST_ASSERT_TRUE(bus.i2c_Submit(&request));
+    Wait(&request);
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, request.Status);
+    TEST_ASSERT_EQUAL_UINT32(2, NATIVE_I2C_GetStats().Written - before.Written);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[0x23], buffer, sizeof(buffer));
+}
+
+void test_background_read(void){
+    char buffer[12];
+    uint32_t calls = 0;
+
+    TEST_ASSERT_TRUE(bus.i2c_ReadMultiDMA(SENSOR_ADDR, 0x60, buffer, sizeof(buffer), Done, &calls));
+    TEST_ASSERT_EQUAL_UINT32(0, calls);
+    Idle();
+    TEST_ASSERT_EQUAL_UINT32(1, calls);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[0x60], buffer, sizeof(buffer));
+}
+
+/* nobody answers: the request fails, and the bus carries on */
+void test_address_nack_recovers(void){
+    char buffer[4];
+
+    TEST_ASSERT_EQUAL(I2C_REQ_ERROR, bus.i2c_readMulti(SENSOR_ADDR + 1, 0x00, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL(I2C_REQ_ERROR, bus.i2c_writeByte(SENSOR_ADDR + 1, 0x00, 1));
+    TEST_ASSERT_EQUAL_UINT32(2, bus.i2c_GetStats().Nacks);
+    TEST_ASSERT_EQUAL_UINT32(2, NATIVE_I2C_GetStats().Nacks);
+
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_readMulti(SENSOR_ADDR, 0x04, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[0x04], buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_writeByte(SENSOR_ADDR, 0x05, 0x5A));
+    TEST_ASSERT_EQUAL_HEX8(0x5A, sensor.Memory[0x05]);
+}
+
+/* a callback that submits the next request, the way a driver chains reads */
+static I2C_REQUEST_t chain[3];
+static char chainData[3][2];
+static uint8_t chainDone;
+
+static void Chain(void* context){
+    (void)context;
+    chainDone++;
+    if (chainDone < 3){
+        TEST_ASSERT_TRUE(bus.i2c_Submit(&chain[chainDone]));
+    }
+}
+
+void test_chained_submit_from_callback(void){
+    memset(chain, 0, sizeof(chain));
+    chainDone = 0;
+    for (uint8_t i = 0; i < 3; i++){
+        chain[i].Saddr = SENSOR_ADDR;
+        chain[i].Reg = (uint16_t)(0x70 + i * 2);
+        chain[i].RegLen = 1;
+        chain[i].Dir = (i == 1) ? I2C_DIR_WRITE : I2C_DIR_READ;
+        chain[i].Buffer = chainData[i];
+        chain[i].Length = 2;
+        chain[i].Priority = I2C_PRIO_HIGH;
+        chain[i].Callback = Chain;
+    }
+    chainData[1][0] = 0x11;
+    chainData[1][1] = 0x22;
+
+    TEST_ASSERT_TRUE(bus.i2c_Submit(&chain[0]));
+    Idle();
+
+    TEST_ASSERT_EQUAL_UINT8(3, chainDone);
+    for (uint8_t i = 0; i < 3; i++){
+        TEST_ASSERT_EQUAL(I2C_REQ_DONE, chain[i].Status);
+    }
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[0x70], chainData[0], 2);
+    TEST_ASSERT_EQUAL_HEX8(0x11, sensor.Memory[0x72]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, sensor.Memory[0x73]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[0x74], chainData[2], 2);
+
+    // read, write, read: W R W W R
+    const uint8_t expected[] = {SENSOR_ADDR << 1, (SENSOR_ADDR << 1) | 1, SENSOR_ADDR << 1,
+                                SENSOR_ADDR << 1, (SENSOR_ADDR << 1) | 1};
+    TEST_ASSERT_EQUAL_UINT8(sizeof(expected), startCount);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, starts, sizeof(expected));
+}
+
+/* a full queue refuses, and takes requests again once it drains */
+void test_queue_full(void){
+    static I2C_REQUEST_t requests[I2C_QUEUE_SIZE + 1];
+    static char data[I2C_QUEUE_SIZE + 1];
+    uint8_t accepted = 0;
+
+    memset(requests, 0, sizeof(requests));
+    for (uint8_t i = 0; i < I2C_QUEUE_SIZE + 1; i++){
+        data[i] = (char)i;
+        requests[i].Saddr = SENSOR_ADDR;
+        requests[i].Reg = (uint16_t)(0x90 + i);
+        requests[i].RegLen = 1;
+        requests[i].Dir = I2C_DIR_WRITE;
+        requests[i].Buffer = &data[i];
+        requests[i].Length = 1;
+        accepted += bus.i2c_Submit(&requests[i]);
+    }
+    // one on the wire, the ring holds one less than its size
+    TEST_ASSERT_EQUAL_UINT8(I2C_QUEUE_SIZE, accepted);
+    TEST_ASSERT_FALSE(bus.i2c_Submit(&requests[I2C_QUEUE_SIZE]));
+
+    Idle();
+    for (uint8_t i = 0; i < accepted; i++){
+        TEST_ASSERT_EQUAL(I2C_REQ_DONE, requests[i].Status);
+        TEST_ASSERT_EQUAL_HEX8(i, sensor.Memory[0x90 + i]);
+    }
+    TEST_ASSERT_TRUE(bus.i2c_Submit(&requests[I2C_QUEUE_SIZE]));
+    Wait(&requests[I2C_QUEUE_SIZE]);
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, requests[I2C_QUEUE_SIZE].Status);
+}
+
+/******************************************************************************
+ * The display on the queue: blocking and background flushes reach the panel, *
+ * through a shared bus and through the one a pin constructed Display owns.   *
+ ******************************************************************************/
+static NATIVE_I2C_DEVICE_t oled;
+static SSD1306Model panel;
+
+static void PanelListener(uint8_t event, uint8_t value, void* context){
+    SSD1306Model* model = (SSD1306Model*)context;
+
+    if (event == NATIVE_I2C_START){
+        model->Begin();
+    } else if (event == NATIVE_I2C_WRITE){
+        model->Byte(value);
+    }
+}
+
+static void AttachPanel(void){
+    memset(&oled, 0, sizeof(oled));
+    oled.Saddr = DISPLAY_I2C_ADDR;
+    oled.Listener = PanelListener;
+    oled.Context = &panel;
+    NATIVE_I2C_Attach(&oled);
+    panel.Reset();
+}
+
+/* the panel shows 'lit' inside the rectangle and the opposite outside */
+static void AssertPanel(uint8_t x0, uint8_t y0, uint8_t w, uint8_t h, bool lit){
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            bool inside = x >= x0 && x < x0 + w && y >= y0 && y < y0 + h;
+            TEST_ASSERT_EQUAL_MESSAGE(inside == lit, panel.Pixel(x, y), "panel pixel");
+        }
+    }
+}
+
+void test_display_async_full_and_partial(void){
+    static Display display(&bus);
+    uint32_t calls = 0;
+
+    AttachPanel();
+    display = Display(&bus);
+    display.Init();
+
+    display.Fill(COLOR_WHITE);
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync(Done, &calls));
+    NATIVE_Run(FRAME_CYCLES);
+    TEST_ASSERT_EQUAL_UINT32(1, calls);
+    AssertPanel(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, true);
+
+    // a sensor read while a partial update is on the wire
+    display.FillRectangle(40, 20, 10, 10, COLOR_BLACK);
+    TEST_ASSERT_TRUE(display.UpdateScreenAsync(Done, &calls));
+    char buffer[4];
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_readMulti(SENSOR_ADDR, 0x30, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&sensor.Memory[0x30], buffer, sizeof(buffer));
+    NATIVE_Run(FRAME_CYCLES);
+    TEST_ASSERT_EQUAL_UINT32(2, calls);
+    AssertPanel(40, 20, 10, 10, false);
+}
+
+/* the pin constructor's Display talks through its own bus */
+void test_display_owned_bus(void){
+    static Display owned(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+
+    AttachPanel();
+    TEST_ASSERT_EQUAL(1, owned.Init());
+    owned.FillRectangle(10, 10, 20, 20, COLOR_WHITE);
+    owned.UpdateScreen();
+    AssertPanel(10, 10, 20, 20, true);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_write_byte_and_multi);
+    RUN_TEST(test_strided_write);
+    RUN_TEST(test_register_only_write);
+    RUN_TEST(test_read_lengths);
+    RUN_TEST(test_read_16bit_register);
+    RUN_TEST(test_background_read);
+    RUN_TEST(test_address_nack_recovers);
+    RUN_TEST(test_chained_submit_from_callback);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_display_async_full_and_partial);
+    RUN_TEST(test_display_owned_bus);
+    return UNITY_END();
+}
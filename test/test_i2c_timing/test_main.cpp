@@ -0,0 +1,117 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * I2C_Timing for every PCLK1 / SCL pair the F411 can run, against values     *
+ * worked out by hand from RM0383 18.6, and the registers i2c_init writes.    *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "i2c.h"
+
+typedef struct {
+    uint32_t Pclk1Hz;
+    uint32_t SpeedHz;
+    I2C_TIMING_t Expected;
+} TIMING_CASE_t;
+
+/* CCR: FS bit 15, DUTY bit 14 (16:9), otherwise 2:1 in fast mode */
+static const TIMING_CASE_t cases[] = {
+    { 2000000, 100000, { 2, 0x000A,  3, 100000}},
+    { 4000000, 100000, { 4, 0x0014,  5, 100000}},
+    { 4000000, 400000, { 4, 0x8004,  2, 333333}},
+    { 8000000, 100000, { 8, 0x0028,  9, 100000}},
+    { 8000000, 400000, { 8, 0x8007,  3, 380952}},
+    {10000000, 100000, {10, 0x0032, 11, 100000}},
+    {10000000, 400000, {10, 0xC001,  4, 400000}},
+    {16000000, 100000, {16, 0x0050, 17, 100000}},
+    {16000000, 400000, {16, 0x800E,  5, 380952}},
+    {24000000, 100000, {24, 0x0078, 25, 100000}},
+    {24000000, 400000, {24, 0x8014,  8, 400000}},
+    {25000000, 100000, {25, 0x007D, 26, 100000}},
+    {25000000, 400000, {25, 0x8015,  8, 396825}},
+    {32000000, 100000, {32, 0x00A0, 33, 100000}},
+    {32000000, 400000, {32, 0x801B, 10, 395061}},
+    {36000000, 100000, {36, 0x00B4, 37, 100000}},
+    {36000000, 400000, {36, 0x801E, 11, 400000}},
+    {42000000, 100000, {42, 0x00D2, 43, 100000}},
+    {42000000, 400000, {42, 0x8023, 13, 400000}},
+    {48000000, 100000, {48, 0x00F0, 49, 100000}},
+    {48000000, 400000, {48, 0x8028, 15, 400000}},
+    {50000000, 100000, {50, 0x00FA, 51, 100000}},
+    {50000000, 400000, {50, 0xC005, 16, 400000}},
+};
+
+void setUp(void){
+    NATIVE_Reset();
+}
+
+void tearDown(void){}
+
+void test_timing_table(void){
+    for (uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++){
+        const TIMING_CASE_t* c = &cases[i];
+        I2C_TIMING_t t = I2C_Timing(c->Pclk1Hz, c->SpeedHz);
+        char what[48];
+
+        snprintf(what, sizeof(what), "PCLK1 %lu SCL %lu", (unsigned long)c->Pclk1Hz, (unsigned long)c->SpeedHz);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(c->Expected.Freq, t.Freq, what);
+        TEST_ASSERT_EQUAL_HEX16_MESSAGE(c->Expected.Ccr, t.Ccr, what);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(c->Expected.Trise, t.Trise, what);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(c->Expected.SpeedHz, t.SpeedHz, what);
+        TEST_ASSERT_TRUE_MESSAGE(t.SpeedHz <= c->SpeedHz, what);
+    }
+}
+
+/* the checked template gives what the function does */
+void test_template_matches(void){
+    constexpr I2C_TIMING_t fast = I2C_TimingFor<48000000, 400000>::Value;
+    constexpr I2C_TIMING_t standard = I2C_TimingFor<48000000, 100000>::Value;
+    constexpr I2C_TIMING_t duty = I2C_TimingFor<50000000, 400000>::Value;
+
+    TEST_ASSERT_EQUAL_HEX16(I2C_Timing(48000000, 400000).Ccr, fast.Ccr);
+    TEST_ASSERT_EQUAL_HEX16(I2C_Timing(48000000, 100000).Ccr, standard.Ccr);
+    TEST_ASSERT_EQUAL_HEX16(I2C_Timing(50000000, 400000).Ccr, duty.Ccr);
+    TEST_ASSERT_EQUAL_HEX16(NATIVE_I2C_TIMING.Ccr, fast.Ccr);
+}
+
+/* what i2c_init leaves in the peripheral, and the SCL rate the bus then runs at */
+static void CheckBus(uint32_t pclk1Hz, uint32_t speedHz){
+    I2C_TIMING_t t = I2C_Timing(pclk1Hz, speedHz);
+    I2C bus(GPIO_PIN_9, GPIO_PIN_8, 1, t);
+    NATIVE_I2C_DEVICE_t device;
+
+    NATIVE_Reset();
+    memset(&device, 0, sizeof(device));
+    device.Saddr = 0x50;
+    NATIVE_I2C_Attach(&device);
+    bus.i2c_init();
+
+    TEST_ASSERT_EQUAL_UINT32(t.Freq, I2C1->CR2 & I2C_CR2_FREQ);
+    TEST_ASSERT_EQUAL_UINT32(t.Ccr, I2C1->CCR);
+    TEST_ASSERT_EQUAL_UINT32(t.Trise, I2C1->TRISE);
+
+    // address, register, one data byte: 27 SCL clocks plus START and STOP
+    TEST_ASSERT_EQUAL(I2C_REQ_DONE, bus.i2c_writeByte(0x50, 0x01, 0x55));
+    NATIVE_Run(100000);
+    uint32_t sclHz = (uint64_t)27 * SystemCoreClock / NATIVE_I2C_GetStats().BusyCycles;
+    TEST_ASSERT_UINT32_WITHIN(t.SpeedHz / 10, t.SpeedHz, sclHz);
+}
+
+void test_bus_runs_at_the_timing(void){
+    CheckBus(48000000, 400000);
+    CheckBus(48000000, 100000);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_timing_table);
+    RUN_TEST(test_template_matches);
+    RUN_TEST(test_bus_runs_at_the_timing);
+    return UNITY_END();
+}
@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Motor PWM timer settings: the robot's, from the clock tree in config.h,    *
+ * what Init writes to TIM3 with them, and Motor_Pwm over a table and a       *
+ * sweep of timer clocks and rates up to the ends of the 16 bit registers.    *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "config.h"
+#include "native.h"
+#include "motor.h"
+
+static constexpr MOTOR_PWM_t robotPwm = Motor_PwmFor<CLOCK_TIM3_HZ, ROBOT_MOTOR_PWM_HZ>::Value;
+
+static Motor left(TIM3, 1, MOTOR_LEFT_IN1, GPIOA, 2, MOTOR_LEFT_IN2, GPIOA, GPIO_AF2_TIM3, false);
+static uint32_t seed;
+
+static uint32_t Random(uint32_t n){
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    seed = 9;
+}
+
+void tearDown(void){}
+
+/* 25 MHz HSE to a 96 MHz core, APB1 at 48 MHz and TIM3 at twice that: 20 kHz
+   is 4800 counts with no prescaler, and the host model runs at that core */
+void test_robot_settings(void){
+    TEST_ASSERT_EQUAL_UINT32(96000000, CLOCK_SYSCLK_HZ);
+    TEST_ASSERT_EQUAL_UINT32(CLOCK_SYSCLK_HZ, SystemCoreClock);
+    TEST_ASSERT_EQUAL_UINT32(96000000, CLOCK_TIM3_HZ);
+
+    TEST_ASSERT_EQUAL_UINT32(1, robotPwm.Prescaler);
+    TEST_ASSERT_EQUAL_UINT32(4800, robotPwm.Period);
+    TEST_ASSERT_EQUAL_UINT32(ROBOT_MOTOR_PWM_HZ, robotPwm.Hz);
+    TEST_ASSERT_EQUAL_UINT32(ROBOT_MOTOR_PWM_HZ, CLOCK_TIM3_HZ / (robotPwm.Prescaler * robotPwm.Period));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(MOTOR_DUTY_FULL, robotPwm.Period);
+}
+
+/* Init writes them as they are, and full duty is the whole period */
+void test_init_registers(void){
+    left.Init(robotPwm);
+    TEST_ASSERT_EQUAL_UINT32(0, TIM3->PSC);
+    TEST_ASSERT_EQUAL_UINT32(4799, TIM3->ARR);
+
+    left.Set(MOTOR_DUTY_FULL);
+    TEST_ASSERT_EQUAL_UINT32(4800, TIM3->CCR1);
+    TEST_ASSERT_EQUAL_UINT32(0, TIM3->CCR2);
+    left.Set(-MOTOR_DUTY_FULL / 4);
+    TEST_ASSERT_EQUAL_UINT32(0, TIM3->CCR1);
+    TEST_ASSERT_EQUAL_UINT32(1200, TIM3->CCR2);
+}
+
+void test_pwm_table(void){
+    static const struct {
+        uint32_t TimerHz, PwmHz, Prescaler, Period, Hz;
+    } table[] = {
+        {96000000,  20000,     1,  4800, 20000},
+        {96000000,  50000,     1,  1920, 50000},
+        {48000000,  20000,     1,  2400, 20000},
+        {100000000, 25000,     1,  4000, 25000},
+        {84000000,  30000,     1,  2800, 30000},
+        {96000000,  1465,      1, 65529,  1465},
+        {96000000,  1464,      2, 32787,  1463},    // just past one prescaler
+        {65536000,  1000,      1, 65536,  1000},    // ARR 65535 exactly
+        {96000000,  1000,      2, 48000,  1000},
+        {96000000,  1,      1465, 65529,     1},    // the slowest there is
+    };
+
+    for (uint8_t i = 0; i < sizeof(table) / sizeof(table[0]); i++){
+        MOTOR_PWM_t pwm = Motor_Pwm(table[i].TimerHz, table[i].PwmHz);
+        char message[48];
+        snprintf(message, sizeof(message), "%lu Hz from %lu", (unsigned long)table[i].PwmHz, (unsigned long)table[i].TimerHz);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(table[i].Prescaler, pwm.Prescaler, message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(table[i].Period, pwm.Period, message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(table[i].Hz, pwm.Hz, message);
+    }
+    // the checked form agrees
+    TEST_ASSERT_EQUAL_UINT32(65536, (Motor_PwmFor<65536000, 1000>::Value.Period));
+}
+
+/******************************************************************************
+ * Random timer clocks of 8-100 MHz and rates of 1 Hz to 50 kHz: the          *
+ * prescaler is the smallest that fits the counter, the period is the nearest *
+ * for it, and both fit PSC and ARR.                                          *
+ ******************************************************************************/
+void test_pwm_sweep(void){
+    for (uint32_t i = 0; i < 20000; i++){
+        uint32_t timerHz = 8000000 + Random(92000001);
+        uint32_t pwmHz = 1 + Random(MOTOR_PWM_MAX_HZ);
+        MOTOR_PWM_t pwm = Motor_Pwm(timerHz, pwmHz);
+        double counts = (double)timerHz / pwmHz;
+
+        TEST_ASSERT_TRUE(pwm.Prescaler >= 1 && pwm.Prescaler <= 65536);
+        TEST_ASSERT_TRUE(pwm.Period >= 1 && pwm.Period <= 65536);
+        // one less would not fit
+        TEST_ASSERT_TRUE(pwm.Prescaler == 1 || counts > 65536.0 * (pwm.Prescaler - 1));
+        TEST_ASSERT_FLOAT_WITHIN(0.5 + 1e-9, counts / pwm.Prescaler, (double)pwm.Period);
+        TEST_ASSERT_EQUAL_UINT32(timerHz / (pwm.Prescaler * pwm.Period), pwm.Hz);
+    }
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_robot_settings);
+    RUN_TEST(test_init_registers);
+    RUN_TEST(test_pwm_table);
+    RUN_TEST(test_pwm_sweep);
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Odometry with the E4 drive train against a double reference that follows   *
+ * the exact arc of every tick: straight runs, spins through the heading      *
+ * wrap, velocities, and long random drives at up to 3 m/s.                   *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include <math.h>
+#include "config.h"
+#include "native.h"
+#include "odometry.h"
+
+#define MM_PER_COUNT    (M_PI * ROBOT_WHEEL_DIAMETER_MM / ROBOT_COUNTS_PER_WHEEL_REV)
+#define Q16             65536.0
+#define BINARY_TURN     4294967296.0
+
+static constexpr ODOMETRY_CONFIG_t config = Odometry_Config(ROBOT_WHEEL_DIAMETER_MM, ROBOT_COUNTS_PER_WHEEL_REV,
+                                                            ROBOT_TRACK_WIDTH_MM, CONTROL_TICK_HZ);
+static Odometry odometry(config);
+static uint32_t seed;
+
+/* the reference pose, mm and rad, and right - left counts */
+static double x, y, theta;
+static int64_t difference;
+
+static uint32_t Random(uint32_t n){
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    odometry = Odometry(config);
+    seed = 11;
+    x = y = theta = 0;
+    difference = 0;
+}
+
+void tearDown(void){}
+
+/* the reference one tick on, along the arc */
+static void Follow(int16_t left, int16_t right){
+    double l = left * MM_PER_COUNT;
+    double r = right * MM_PER_COUNT;
+    double turn = (r - l) / ROBOT_TRACK_WIDTH_MM;
+
+    if (fabs(turn) < 1e-12){
+        x += l * cos(theta);
+        y += l * sin(theta);
+    } else {
+        double radius = (l + r) / 2 / turn;
+        x += radius * (sin(theta + turn) - sin(theta));
+        y -= radius * (cos(theta + turn) - cos(theta));
+    }
+    theta += turn;
+    difference += right - left;
+}
+
+/* both the reference and the odometry */
+static void Step(int16_t left, int16_t right){
+    Follow(left, right);
+    odometry.Update(left, right);
+}
+
+/* the heading error in binary angle units, either way round the wrap */
+static int32_t HeadingError(uint32_t binary){
+    double reference = fmod(theta / (2 * M_PI), 1.0);
+    if (reference < 0){
+        reference += 1.0;
+    }
+    return (int32_t)(binary - (uint32_t)(int64_t)llround(reference * BINARY_TURN));
+}
+
+/******************************************************************************
+ * Position within 'mm'; the heading within what AnglePerCountQ16, rounded to *
+ * half a Q16 unit, can add up to over the right - left counts so far, and    *
+ * the floor of the >> 16.                                                    *
+ ******************************************************************************/
+static void AssertPose(double mm, const char* what){
+    ODOMETRY_POSE_t pose = odometry.Pose();
+    int64_t binary = llabs(difference) / (2 * 65536) + 2;
+    char message[96];
+
+    snprintf(message, sizeof(message), "%s: x %.4f y %.4f", what, pose.X / Q16 - x, pose.Y / Q16 - y);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(mm, x, pose.X / Q16, message);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(mm, y, pose.Y / Q16, message);
+    TEST_ASSERT_INT32_WITHIN(binary, 0, HeadingError(pose.Theta));
+}
+
+/* the compile time scale factors round the doubles */
+void test_config(void){
+    double turnsPerCount = MM_PER_COUNT / ROBOT_TRACK_WIDTH_MM / (2 * M_PI);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.5, MM_PER_COUNT * 16777216.0, (double)config.MmPerCountQ24);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, MM_PER_COUNT * 32768.0 / 32767.0 * 16777216.0, (double)config.StepPerCountQ24);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, turnsPerCount * BINARY_TURN * Q16, (double)config.AnglePerCountQ16);
+    TEST_ASSERT_EQUAL_UINT32(CONTROL_TICK_HZ, config.RateHz);
+}
+
+/* 10 m straight along x, then 10 m back along -x after a half turn */
+void test_straight_runs(void){
+    for (uint32_t i = 0; i < 5000; i++){
+        Step(38, 38);
+    }
+    AssertPose(0.01, "out");
+    TEST_ASSERT_EQUAL_INT32(0, odometry.Pose().Y);
+
+    // half a turn on the spot: pi * 36 mm per wheel
+    int32_t counts = (int32_t)lround(M_PI * ROBOT_TRACK_WIDTH_MM / 2 / MM_PER_COUNT);
+    for (int32_t i = 0; i < counts; i++){
+        Step(-1, 1);
+    }
+    for (uint32_t i = 0; i < 5000; i++){
+        Step(38, 38);
+    }
+    AssertPose(0.05, "back");
+}
+
+/* twenty turns on the spot each way: the heading wraps and comes back to
+   where it started, and the position does not move */
+void test_spin_through_the_wrap(void){
+    for (uint32_t i = 0; i < 20000; i++){
+        Step(-23, 23);
+    }
+    AssertPose(0, "anticlockwise");
+    for (uint32_t i = 0; i < 20000; i++){
+        Step(23, -23);
+    }
+    AssertPose(0, "clockwise");
+    TEST_ASSERT_EQUAL_UINT32(0, odometry.Pose().Theta);
+}
+
+void test_velocities(void){
+    Step(40, 20);
+    ODOMETRY_POSE_t pose = odometry.Pose();
+
+    double v = 30 * MM_PER_COUNT * CONTROL_TICK_HZ;
+    double w = -20 * MM_PER_COUNT / ROBOT_TRACK_WIDTH_MM * CONTROL_TICK_HZ;
+    TEST_ASSERT_FLOAT_WITHIN(0.01, v, pose.Velocity / Q16);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, w, pose.AngularVelocity / Q16);
+    TEST_ASSERT_EQUAL_UINT32(1, pose.Updates);
+}
+
+/* from a pose given to Reset, across the scheduler's tick interface */
+void test_reset_and_on_tick(void){
+    SYNCSAMPLE_t sample = {0};
+    SCHEDULER_TICK_t tick = {0};
+
+    odometry.Reset((int32_t)(90 * Q16), (int32_t)(-90 * Q16), 0x40000000);
+    x = 90;
+    y = -90;
+    theta = M_PI / 2;
+    sample.LeftDelta = 30;
+    sample.RightDelta = 34;
+    tick.Data = &sample;
+    for (uint16_t i = 0; i < 1000; i++){
+        Odometry::OnTick(&tick, &odometry);
+        Follow(sample.LeftDelta, sample.RightDelta);
+    }
+    AssertPose(0.01, "reset");
+}
+
+/******************************************************************************
+ * Twenty drives of 60 s each: each wheel's speed walks at random within      *
+ * +/-3 m/s (+/-57 counts a tick), with accelerations a mouse can make.       *
+ * The arc is exact in the reference, the odometry steps chords along the     *
+ * mid-tick heading on the Q15 table; over 60 s of driving they must agree    *
+ * to a fifth of a millimetre (0.05 mm seen).                                 *
+ ******************************************************************************/
+void test_random_drives(void){
+    double worst = 0;
+
+    for (uint8_t run = 0; run < 20; run++){
+        int32_t left = 0, right = 0;
+
+        setUp();
+        seed = run + 1;
+        for (uint32_t i = 0; i < 60000; i++){
+            left += (int32_t)Random(3) - 1;
+            right += (int32_t)Random(3) - 1;
+            left = (left > 57) ? 57 : (left < -57) ? -57 : left;
+            right = (right > 57) ? 57 : (right < -57) ? -57 : right;
+            Step((int16_t)left, (int16_t)right);
+        }
+        // heading is exact to a count of right - left: AnglePerCount rounded
+        AssertPose(0.2, "drive");
+
+        ODOMETRY_POSE_t pose = odometry.Pose();
+        worst = fmax(worst, hypot(pose.X / Q16 - x, pose.Y / Q16 - y));
+    }
+    char message[48];
+    snprintf(message, sizeof(message), "worst %.4f mm", worst);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_config);
+    RUN_TEST(test_straight_runs);
+    RUN_TEST(test_spin_through_the_wrap);
+    RUN_TEST(test_velocities);
+    RUN_TEST(test_reset_and_on_tick);
+    RUN_TEST(test_random_drives);
+    return UNITY_END();
+}
@@ -0,0 +1,223 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Motion profile, in mm on the E4 drive train: random trapezoids and S       *
+ * curves, a reversal into a move the other way and a run of chained cells.   *
+ * Every move must arrive on its distance and at its end speed to within one  *
+ * encoder count (a count, and a count per tick), never go over its top       *
+ * speed and never change speed faster than its acceleration.                 *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include <math.h>
+#include "config.h"
+#include "native.h"
+#include "profile.h"
+
+#define COUNT_MM        (M_PI * ROBOT_WHEEL_DIAMETER_MM / ROBOT_COUNTS_PER_WHEEL_REV)
+#define Q16             65536.0
+
+/* what a run of ticks did, in mm and s */
+typedef struct {
+    uint32_t Ticks;
+    double Position;            // at the end of the last tick
+    double TopSpeed;            // fastest either way
+    double WorstStep;           // biggest change of speed in a tick, mm/s
+    double Arrival[20];         // speed on each move's last whole tick
+    uint32_t ArrivalTick[20];
+    uint32_t Moves;
+    bool Stopped;               // speed 0 before the last move ended
+} RUN_t;
+
+static Profile profile(CONTROL_TICK_HZ);
+static uint32_t seed;
+
+static double Uniform(double low, double high){
+    seed = seed * 1664525 + 1013904223;
+    return low + (high - low) * ((seed >> 8) / 16777216.0);
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    profile = Profile(CONTROL_TICK_HZ);
+    seed = 17;
+}
+
+void tearDown(void){}
+
+/******************************************************************************
+ * Ticks the profile until it is finished, queueing moves[1..] with Next as   *
+ * each one starts, and records what the setpoints did.                       *
+ ******************************************************************************/
+static RUN_t Run(const PROFILE_MOVE_t* moves, uint8_t count, uint32_t maxTicks){
+    RUN_t run = {0};
+    PROFILE_SETPOINT_t last = profile.Setpoint();
+    uint8_t queued = 1;
+
+    profile.Start(moves[0]);
+    while (run.Ticks < maxTicks){
+        if (queued < count && !profile.HasNext()){
+            profile.Next(moves[queued++]);
+        }
+        profile.Update();
+        run.Ticks++;
+
+        PROFILE_SETPOINT_t now = profile.Setpoint();
+        double speed = last.Velocity / Q16;
+        run.TopSpeed = fmax(run.TopSpeed, fabs(now.Velocity / Q16));
+        if (now.Moves != last.Moves){
+            // this tick was cut at the distance, the one before it was whole
+            if (run.Moves < 20){
+                run.Arrival[run.Moves] = speed;
+                run.ArrivalTick[run.Moves] = run.Ticks;
+            }
+            run.Moves++;
+        } else {
+            run.WorstStep = fmax(run.WorstStep, fabs(now.Velocity - last.Velocity) / Q16);
+        }
+        if (now.Velocity == 0 && run.Moves + 1 < count){
+            run.Stopped = true;
+        }
+        last = now;
+        if (profile.IsFinished() && run.Moves == count){
+            break;
+        }
+    }
+    run.Position = last.Position / Q16;
+    return run;
+}
+
+/* the ideal trapezoid's time from rest, s */
+static double TrapezoidTime(double distance, double speed, double endSpeed, double acceleration){
+    double up = speed * speed / (2 * acceleration);
+    double down = (speed * speed - endSpeed * endSpeed) / (2 * acceleration);
+
+    if (up + down <= distance){
+        return speed / acceleration + (speed - endSpeed) / acceleration + (distance - up - down) / speed;
+    }
+    double peak = sqrt(acceleration * distance + endSpeed * endSpeed / 2);
+    return peak / acceleration + (peak - endSpeed) / acceleration;
+}
+
+/* an end speed the move can reach from rest, with room to spare */
+static double EndSpeedFor(double distance, double speed, double acceleration, double jerk){
+    double reachable = sqrt(acceleration * distance);
+    if (jerk > 0){
+        reachable = fmin(reachable, cbrt(distance * distance * jerk));
+    }
+    return (Uniform(0, 1) < 0.3) ? 0 : Uniform(0, fmin(speed, reachable / 2));
+}
+
+static void AssertMove(const RUN_t* run, double distance, double speed, double endSpeed, double acceleration,
+                       uint32_t rateHz, const char* what){
+    char message[128];
+
+    snprintf(message, sizeof(message), "%s: %.1f mm at %.0f mm/s to %.0f mm/s, %.0f mm/s^2",
+             what, distance, speed, endSpeed, acceleration);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, run->Moves, message);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(COUNT_MM, distance, run->Position, message);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(COUNT_MM * rateHz, endSpeed, run->Arrival[0], message);
+    TEST_ASSERT_TRUE_MESSAGE(run->TopSpeed <= speed * 1.0005 + 0.01, message);
+    TEST_ASSERT_TRUE_MESSAGE(run->WorstStep <= acceleration / rateHz * 1.001 + 0.01, message);
+}
+
+void test_trapezoids(void){
+    static const uint32_t rates[] = {1000, 2000};
+
+    for (uint8_t r = 0; r < 2; r++){
+        for (uint16_t i = 0; i < 300; i++){
+            double distance = Uniform(5, 3000);
+            double speed = Uniform(100, 3000);
+            double acceleration = Uniform(1000, 20000);
+            double endSpeed = EndSpeedFor(distance, speed, acceleration, 0);
+            PROFILE_MOVE_t move = Profile_Move(distance, speed, endSpeed, acceleration);
+
+            profile = Profile(rates[r]);
+            RUN_t run = Run(&move, 1, 200000);
+            AssertMove(&run, distance, speed, endSpeed, acceleration, rates[r], "trapezoid");
+
+            // braking starts within a tick of the last moment, so no later than
+            // the ideal profile by more than a few ticks
+            double ideal = TrapezoidTime(distance, speed, endSpeed, acceleration);
+            TEST_ASSERT_FLOAT_WITHIN(0.003, ideal, (double)run.ArrivalTick[0] / rates[r]);
+        }
+    }
+}
+
+void test_s_curves(void){
+    static const uint32_t rates[] = {1000, 2000};
+
+    for (uint8_t r = 0; r < 2; r++){
+        for (uint16_t i = 0; i < 300; i++){
+            double distance = Uniform(5, 3000);
+            double speed = Uniform(100, 3000);
+            double acceleration = Uniform(1000, 20000);
+            double jerk = Uniform(20000, 500000);
+            double endSpeed = EndSpeedFor(distance, speed, acceleration, jerk);
+            PROFILE_MOVE_t move = Profile_Move(distance, speed, endSpeed, acceleration, jerk);
+
+            profile = Profile(rates[r]);
+            RUN_t run = Run(&move, 1, 200000);
+            AssertMove(&run, distance, speed, endSpeed, acceleration, rates[r], "S curve");
+        }
+    }
+}
+
+/* forward at 300 mm/s into a move back the other way: the speed runs
+   through 0 at the acceleration, and the robot ends 100 mm from the start */
+void test_reversal(void){
+    static const PROFILE_MOVE_t trapezoid[] = {Profile_Move(200, 600, 300, 5000),
+                                               Profile_Move(-300, 600, 0, 5000)};
+    static const PROFILE_MOVE_t sCurve[] = {Profile_Move(200, 600, 300, 5000, 100000),
+                                            Profile_Move(-300, 600, 0, 5000, 100000)};
+    const PROFILE_MOVE_t* runs[] = {trapezoid, sCurve};
+
+    for (uint8_t i = 0; i < 2; i++){
+        setUp();
+        RUN_t run = Run(runs[i], 2, 100000);
+        TEST_ASSERT_EQUAL_UINT32(2, run.Moves);
+        TEST_ASSERT_FLOAT_WITHIN(COUNT_MM * CONTROL_TICK_HZ, 300, run.Arrival[0]);
+        TEST_ASSERT_FLOAT_WITHIN(COUNT_MM * CONTROL_TICK_HZ, 0, run.Arrival[1]);
+        TEST_ASSERT_FLOAT_WITHIN(COUNT_MM, -100, run.Position);
+        TEST_ASSERT_TRUE(run.TopSpeed <= 600 * 1.0005);
+        TEST_ASSERT_TRUE(run.WorstStep <= 5000.0 / CONTROL_TICK_HZ * 1.001 + 0.01);
+    }
+}
+
+/* 16 cells of 180 mm at 500 mm/s through every joint, stopping at the end:
+   2880 mm without a stop or a jolt between them */
+void test_chained_cells(void){
+    PROFILE_MOVE_t cells[16];
+
+    for (uint8_t jerk = 0; jerk < 2; jerk++){
+        for (uint8_t i = 0; i < 16; i++){
+            cells[i] = Profile_Move(180, 800, (i < 15) ? 500 : 0, 4000, jerk ? 80000 : 0);
+        }
+        setUp();
+        RUN_t run = Run(cells, 16, 100000);
+
+        TEST_ASSERT_EQUAL_UINT32(16, run.Moves);
+        TEST_ASSERT_FLOAT_WITHIN(COUNT_MM, 2880, run.Position);
+        TEST_ASSERT_FALSE(run.Stopped);
+        for (uint8_t i = 0; i < 15; i++){
+            TEST_ASSERT_FLOAT_WITHIN(COUNT_MM * CONTROL_TICK_HZ, 500, run.Arrival[i]);
+        }
+        TEST_ASSERT_FLOAT_WITHIN(COUNT_MM * CONTROL_TICK_HZ, 0, run.Arrival[15]);
+        TEST_ASSERT_TRUE(run.TopSpeed <= 800 * 1.0005);
+        TEST_ASSERT_TRUE(run.WorstStep <= 4000.0 / CONTROL_TICK_HZ * 1.001 + 0.01);
+    }
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_trapezoids);
+    RUN_TEST(test_s_curves);
+    RUN_TEST(test_reversal);
+    RUN_TEST(test_chained_cells);
+    return UNITY_END();
+}
@@ -0,0 +1,256 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Scheduler on a made up clock: stage order by phase, the table's limits,    *
+ * cycles per stage, latency and jitter, overruns right at the deadline and   *
+ * missed ticks, all of it across the wrap of the 32 bit cycle counter.       *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include "native.h"
+#include "scheduler.h"
+
+#define RATE_HZ         1000
+#define PERIOD          96000       // cycles at the model's 96 MHz
+#define DEADLINE        48000       // SCHED_DEADLINE_PERCENT of it
+
+/* a stage: what it costs and what it saw */
+typedef struct {
+    uint8_t Id;
+    uint32_t Cost;              // cycles, added to the clock
+    SCHEDULER_TICK_t Last;
+} STAGE_t;
+
+static Scheduler scheduler(RATE_HZ);
+static uint32_t clockNow;
+static uint8_t order[SCHED_MAX_STAGES * 2];
+static uint8_t orderLength;
+static uint32_t seed;
+
+static uint32_t Random(uint32_t n){
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+}
+
+static uint32_t Clock(void){
+    return clockNow;
+}
+
+static void Stage(const SCHEDULER_TICK_t* tick, void* context){
+    STAGE_t* stage = (STAGE_t*)context;
+
+    stage->Last = *tick;
+    if (orderLength < sizeof(order)){
+        order[orderLength++] = stage->Id;
+    }
+    clockNow += stage->Cost;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    scheduler = Scheduler(RATE_HZ);
+    scheduler.Init();
+    scheduler.SetClock(Clock);
+    clockNow = 0;
+    orderLength = 0;
+    seed = 5;
+}
+
+void tearDown(void){}
+
+/* the tick due at 'due' starts 'latency' later */
+static void TickAt(uint32_t due, uint32_t latency){
+    clockNow = due + latency;
+    scheduler.Tick(due);
+}
+
+void test_period_and_deadline(void){
+    TEST_ASSERT_EQUAL_UINT32(PERIOD, scheduler.GetPeriod());
+
+    STAGE_t stage = {0, DEADLINE, {0}};
+    scheduler.Add(SCHED_PHASE_CONTROL, Stage, &stage, "deadline");
+    TickAt(0, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.Stats().Overruns);
+    TickAt(PERIOD, 1);
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.Stats().Overruns);
+}
+
+/* phases in order, stages of a phase in the order they were added */
+void test_stage_order(void){
+    static STAGE_t stages[6] = {{0}, {1}, {2}, {3}, {4}, {5}};
+    static const uint8_t phases[6] = {SCHED_PHASE_OUTPUT, SCHED_PHASE_STATE, SCHED_PHASE_CONTROL,
+                                      SCHED_PHASE_STATE, SCHED_PHASE_SAMPLE, SCHED_PHASE_OUTPUT};
+    static const uint8_t expected[6] = {4, 1, 3, 2, 0, 5};
+    static const char* names[6] = {"a", "b", "c", "d", "e", "f"};
+
+    for (uint8_t i = 0; i < 6; i++){
+        TEST_ASSERT_TRUE(scheduler.Add(phases[i], Stage, &stages[i], names[i]));
+    }
+    TEST_ASSERT_EQUAL_UINT8(6, scheduler.StageCount());
+    TickAt(0, 0);
+    TEST_ASSERT_EQUAL_UINT8(6, orderLength);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, order, 6);
+
+    // the statistics are listed the same way
+    for (uint8_t i = 0; i < 6; i++){
+        SCHEDULER_STAGE_STATS_t stats;
+        TEST_ASSERT_TRUE(scheduler.StageStats(i, &stats));
+        TEST_ASSERT_EQUAL_STRING(names[expected[i]], stats.Name);
+        TEST_ASSERT_EQUAL_UINT8(phases[expected[i]], stats.Phase);
+    }
+    SCHEDULER_STAGE_STATS_t stats;
+    TEST_ASSERT_FALSE(scheduler.StageStats(6, &stats));
+}
+
+void test_add_limits(void){
+    static STAGE_t stage = {0};
+
+    TEST_ASSERT_FALSE(scheduler.Add(SCHED_PHASES, Stage, &stage, "phase"));
+    TEST_ASSERT_FALSE(scheduler.Add(SCHED_PHASE_STATE, 0, &stage, "null"));
+    for (uint8_t i = 0; i < SCHED_MAX_STAGES; i++){
+        TEST_ASSERT_TRUE(scheduler.Add(i % SCHED_PHASES, Stage, &stage, "stage"));
+    }
+    TEST_ASSERT_FALSE(scheduler.Add(SCHED_PHASE_SAMPLE, Stage, &stage, "full"));
+    TEST_ASSERT_EQUAL_UINT8(SCHED_MAX_STAGES, scheduler.StageCount());
+}
+
+/* what the stages are told, and the cycles each one is charged */
+void test_tick_and_cycles(void){
+    static STAGE_t a = {0, 1200, {0}};
+    static STAGE_t b = {1, 300, {0}};
+    SYNCSAMPLE_t sample = {0};
+
+    scheduler.Add(SCHED_PHASE_STATE, Stage, &a, "a");
+    scheduler.Add(SCHED_PHASE_OUTPUT, Stage, &b, "b");
+
+    // driven the way SyncSampler does it
+    sample.Time = 5000;
+    clockNow = 5250;
+    Scheduler::OnSample(&sample, &scheduler);
+    TEST_ASSERT_EQUAL_UINT32(0, a.Last.Count);
+    TEST_ASSERT_EQUAL_UINT32(5000, a.Last.Due);
+    TEST_ASSERT_EQUAL_UINT32(5250, a.Last.Start);
+    TEST_ASSERT_EQUAL_PTR(&sample, a.Last.Data);
+    TEST_ASSERT_EQUAL_UINT32(5250, b.Last.Start);    // the tick's, not the stage's
+
+    a.Cost = 2000;
+    sample.Time += PERIOD;
+    clockNow = sample.Time + 100;
+    Scheduler::OnSample(&sample, &scheduler);
+    TEST_ASSERT_EQUAL_UINT32(1, b.Last.Count);
+    a.Cost = 700;
+    sample.Time += PERIOD;
+    clockNow = sample.Time + 100;
+    Scheduler::OnSample(&sample, &scheduler);
+
+    SCHEDULER_STAGE_STATS_t stats;
+    scheduler.StageStats(0, &stats);
+    TEST_ASSERT_EQUAL_UINT32(700, stats.Cycles);
+    TEST_ASSERT_EQUAL_UINT32(2000, stats.CyclesWorst);
+    scheduler.StageStats(1, &stats);
+    TEST_ASSERT_EQUAL_UINT32(300, stats.Cycles);
+    TEST_ASSERT_EQUAL_UINT32(300, stats.CyclesWorst);
+
+    SCHEDULER_STATS_t total = scheduler.Stats();
+    TEST_ASSERT_EQUAL_UINT32(3, total.Ticks);
+    TEST_ASSERT_EQUAL_UINT32(1000, total.Cycles);
+    TEST_ASSERT_EQUAL_UINT32(2300, total.CyclesWorst);
+    TEST_ASSERT_EQUAL_UINT32(0, total.Missed + total.Overruns);
+}
+
+/******************************************************************************
+ * Random latencies on ticks running through the wrap of the cycle counter:   *
+ * best, worst and jitter are what was put in, and nothing is counted as      *
+ * missed or late for the wrap.                                               *
+ ******************************************************************************/
+void test_latency_and_jitter_across_the_wrap(void){
+    static STAGE_t stage = {0, 5000, {0}};
+    uint32_t due = 0xFFFFFFFF - 50 * PERIOD;
+    uint32_t best = 0xFFFFFFFF, worst = 0;
+
+    scheduler.Add(SCHED_PHASE_CONTROL, Stage, &stage, "control");
+    for (uint16_t i = 0; i < 100; i++){
+        uint32_t latency = 120 + Random(900);
+        best = (latency < best) ? latency : best;
+        worst = (latency > worst) ? latency : worst;
+        // the tick interrupt itself wanders by a few cycles
+        TickAt(due + Random(7), latency);
+        TEST_ASSERT_EQUAL_UINT32(latency, scheduler.Stats().Latency);
+        due += PERIOD;
+    }
+
+    SCHEDULER_STATS_t stats = scheduler.Stats();
+    TEST_ASSERT_EQUAL_UINT32(100, stats.Ticks);
+    TEST_ASSERT_EQUAL_UINT32(best, stats.LatencyBest);
+    TEST_ASSERT_EQUAL_UINT32(worst, stats.LatencyWorst);
+    TEST_ASSERT_EQUAL_UINT32(worst - best, scheduler.Jitter());
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Missed);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Overruns);
+    TEST_ASSERT_EQUAL_UINT32(5000, stats.CyclesWorst);
+}
+
+/* a tick that ends past the deadline is an overrun, also where the end
+   has wrapped and the due time has not */
+void test_overruns(void){
+    static STAGE_t stage = {0, 0, {0}};
+    uint32_t due = 0xFFFFFFFF - 2 * PERIOD + 1;
+
+    scheduler.Add(SCHED_PHASE_CONTROL, Stage, &stage, "control");
+    stage.Cost = DEADLINE - 400;
+    TickAt(due, 400);                       // done right on the deadline
+    stage.Cost = DEADLINE - 399;
+    TickAt(due += PERIOD, 400);             // one cycle over, and ends past the wrap
+    stage.Cost = 10;
+    TickAt(due += PERIOD, DEADLINE);        // started late enough to be late
+    stage.Cost = 10;
+    TickAt(due += PERIOD, 100);
+
+    SCHEDULER_STATS_t stats = scheduler.Stats();
+    TEST_ASSERT_EQUAL_UINT32(4, stats.Ticks);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.Overruns);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Missed);
+}
+
+/* ticks left out count as missed, however the due times wander, and a
+   tick a period after a cleared one counts none */
+void test_missed_ticks(void){
+    uint32_t due = 0xFFFFFFFF - 3 * PERIOD;
+    uint32_t missed = 0;
+
+    for (uint16_t i = 0; i < 60; i++){
+        uint32_t skip = (i % 7 == 3) ? 1 + Random(4) : 0;
+        missed += skip;
+        due += skip * PERIOD;
+        TickAt(due + Random(2000) - 1000, 200);
+        due += PERIOD;
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(5, missed);
+    TEST_ASSERT_EQUAL_UINT32(missed, scheduler.Stats().Missed);
+    TEST_ASSERT_EQUAL_UINT32(60, scheduler.Stats().Ticks);
+
+    scheduler.ClearStats();
+    SCHEDULER_STATS_t stats = scheduler.Stats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.Ticks + stats.Missed + stats.Overruns + stats.LatencyWorst);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.Jitter());
+    // the first tick after a clear has nothing to count from
+    TickAt(due + 10 * PERIOD, 200);
+    TickAt(due + 11 * PERIOD, 200);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.Stats().Missed);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_period_and_deadline);
+    RUN_TEST(test_stage_order);
+    RUN_TEST(test_add_limits);
+    RUN_TEST(test_tick_and_cycles);
+    RUN_TEST(test_latency_and_jitter_across_the_wrap);
+    RUN_TEST(test_overruns);
+    RUN_TEST(test_missed_ticks);
+    return UNITY_END();
+}
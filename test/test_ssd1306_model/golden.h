@@ -0,0 +1,669 @@
+#pragma once
+/* Golden panels for test_ssd1306_model as P1 PBM, '1' dark, '0' lit.
+   Written by the suite built with -D GOLDEN_UPDATE, not by hand. */
+
+static const char GOLDEN_TEXT[] =
+    "P1\n"
+    "128 64\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111000001111011111111011101100011100011000011100011011101100011\n"
+    "0111011000110000011111111111111111111111111111111111111111111110\n"
+    "0111011111110011111111001001110111011101011101011101001001011101\n"
+    "0111010111010111111111111111111111111111111111111111111111111110\n"
+    "0111011111101011111111010101110111011111011101011101010101011101\n"
+    "0111010111110111111111111111111111111111111111111111111111111110\n"
+    "0111000011011011111111010101110111011111000011011101010101011101\n"
+    "0111011000110000111111111111111111111111111111111111111111111110\n"
+    "0111011111000001111111010101110111011111010111011101010101011101\n"
+    "0111011111010111111111111111111111111111111111111111111111111110\n"
+    "0111011111111011111111011101110111011101011011011101011101011101\n"
+    "0111010111010111111111111111111111111111111111111111111111111110\n"
+    "0111000001111011111111011101100011100011011101100011011101100011\n"
+    "1000111000110000011111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111110001111111111111111111111111111011111111111011111000111100\n"
+    "0111111011111111111111111111111111111111111111111111111111111110\n"
+    "0111101110111111111111111111111111111011111111110011110111011011\n"
+    "1011110011111111111111111111111111111111111111111111111111111110\n"
+    "0111101111110100111100011110001111001011111111101011110111011111\n"
+    "1011101011111111111111111111111111111111111111111111111111111110\n"
+    "0111110011110011011011101101110110110011111111111011111111011110\n"
+    "0111101011111111111111111111111111111111111111111111111111111110\n"
+    "0111111101110111011000001100000110111011111111111011111110111111\n"
+    "1011011011111111111111111111111111111111111111111111111111111110\n"
+    "0111111110110111011011111101111110111011111111111011111101111111\n"
+    "1011000001111111111111111111111111111111111111111111111111111110\n"
+    "0111101110110011011011101101110110110011111111111011111011111011\n"
+    "1011111011111111111111111111111111111111111111111111111111111110\n"
+    "0111110001110100111100011110001111001011111111111011110000011100\n"
+    "0111111011111111111111111111111111111111111111111111111111111110\n"
+    "0111111111110111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111110111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111100111111100001111111111111111000000011111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111000111111000000111111111111111000000011111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111000111110001100011111111111111001111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111110000111110011110011111111111111001111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111110000111110011110011111111111111001111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111110100111111111110011111111111111001000111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111100100111111111100111111111111111000000011111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111100100111111111001111111111111111001110001111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111000011111001100111111110011111111111111111111111001111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111000011111000000001111100111111111111111111111111001111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111000000001111001111111111111111111001111001111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111100111110011111111111111111111000110001111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111100111110000000011111100111111100000011111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111100111110000000011111100111111110000111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111011111111100011100011111111111111\n"
+    "1111111000111100010000010000010000010000011111111111111111111110\n"
+    "0111111111111111111111111111110011111111011101011101111111111111\n"
+    "1111110111011011110111110111111111010111111111111111111111111110\n"
+    "0111111111111111111111111111101011111111011101111101111111111111\n"
+    "1111110110010111110000110000111110110000111111111111111111111110\n"
+    "0111111111111111111111000001011011111111100011100011111111111111\n"
+    "1111110101010000111111011111011100111111011111111111111111111110\n"
+    "0111111111111111111111111111000001111111011101011111111111111111\n"
+    "1111110011010111011111011111011111011111011111111111111111111110\n"
+    "0111111111111111111111111111111011110011011101011111111111111111\n"
+    "1111110111010111010111010111010111010111011111111111111111111110\n"
+    "0111111111111111111111111111111011110011100011000001111111111111\n"
+    "1111111000111000111000111000111000111000111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111110\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111100011011101\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111011101011011\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111011101010111\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111011101001111\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111011101010111\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111011101011011\n"
+    "0111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111100011011101\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000111111111111\n"
+    ;
+
+static const char GOLDEN_DIGITS[] =
+    "P1\n"
+    "128 64\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000111111100000000000011110000000011111110000000001111\n"
+    "1111000000000000011110000001111111111100000000011111110000000000\n"
+    "0000000000001111111110000000011111110000001111111111100000011111\n"
+    "1111100000000000111110000001111111111100000001111111111000000000\n"
+    "0000000000011111011111000011111111110000001111000111110000011100\n"
+    "0111110000000000111110000001111111111100000011111000111000000000\n"
+    "0000000000111110001111100011111111110000000000000011110000000000\n"
+    "0011111000000001111110000001111000000000000111110000000000000000\n"
+    "0000000000111100000111100000000111110000000000000011111000000000\n"
+    "0011111000000011111110000001111000000000000111100000000000000000\n"
+    "0000000001111100000111110000000111110000000000000011111000000000\n"
+    "0011111000000111111110000001111000000000001111100000000000000000\n"
+    "0000000001111100000111110000000111110000000000000011111000000000\n"
+    "0011110000000111111110000001111000000000001111000000000000000000\n"
+    "0000000001111000000011110000000111110000000000000011110000000000\n"
+    "0011110000001111011110000001111000000000001111000000000000000000\n"
+    "0000000001111000000011110000000111110000000000000011110000000000\n"
+    "1111100000011110011110000001111111100000001111011111100000000000\n"
+    "0000000001111000000011110000000111110000000000000111110000001111\n"
+    "1111000000011110011110000001111111111000001111111111110000000000\n"
+    "0000000001111000000011110000000111110000000000001111100000001111\n"
+    "1111100000111100011110000000000011111100011111110011111000000000\n"
+    "0000000001111000000011110000000111110000000000011111000000000000\n"
+    "0111110001111000011110000000000001111100011111100001111100000000\n"
+    "0000000001111000000011110000000111110000000000111110000000000000\n"
+    "0011111001111000011110000000000000111110001111000000111100000000\n"
+    "0000000001111000000011110000000111110000000001111100000000000000\n"
+    "0001111011111111111111110000000000111110001111000000111100000000\n"
+    "0000000001111100000111110000000111110000000001111000000000000000\n"
+    "0001111011111111111111110000000000011110001111000000111100000000\n"
+    "0000000001111100000111110000000111110000000011110000000000000000\n"
+    "0001111000000000011110000000000000111110001111000000111100000000\n"
+    "0000000000111100000111100000000111110000000111100000000000000000\n"
+    "0001111000000000011110000000000000111110001111100000111100000000\n"
+    "0000000000111110001111100000000111110000001111100000000000000000\n"
+    "0011111000000000011110000000000000111100000111100001111100000000\n"
+    "0000000000011111011111000000000111110000001111000000000000011100\n"
+    "0111110000000000011110000001110001111100000111110011111000000000\n"
+    "0000000000001111111110000011111111111111001111111111111000011111\n"
+    "1111100000000000011110000001111111111000000011111111110000000000\n"
+    "0000000000000111111100000011111111111111001111111111111000011111\n"
+    "1110000000000000011110000001111111100000000000111111000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000111111111111110000011111111000000001111111000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000111111111111110000111111111100000011111111100000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000111111111111110001111100111110000111100111110000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "1111111111111111111100001110000111100001110000111100000111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111000011100000111100001110000111110000111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111000011100000111100001100000111110000011111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111110000111110000111100001100000111110000011111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111110001111110000011000011100000111110000011111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111100001111111000000000111100000111110000011111111\n"
+    "1111111111111110000000000011111111111111111111111111111111111111\n"
+    "1111111111111111000011111111100000001111110000111110000011111111\n"
+    "1111111111111110000000000011111111111111111111111111111111111111\n"
+    "1111111111111111000011111111000000000111110000011100000011111111\n"
+    "1111111111111110000000000011111111111111111111111111111111111111\n"
+    "1111111111111110000111111110000100000011111000000000000011111111\n"
+    "1111111111111110000111111111111111111111111111111111111111111111\n"
+    "1111111111111110000111111100000111000001111110000001000011111111\n"
+    "1111111111111110000111111111111111111111111111111111111111111111\n"
+    "1111111111111100001111111100001111100000111111111110000011111111\n"
+    "1111111111111110000111111111111111111111111111111111111111111111\n"
+    "1111111111111100001111111000001111100000111111111110000111111111\n"
+    "1111111111111110000111111111111111111111111111111111111111111111\n"
+    "1111111111111000011111111000001111110000111111111110000111111111\n"
+    "1111111111111110000111111111111111111111111111111111111111111111\n"
+    "1111111111110000011111111000001111110000111111111100000111111111\n"
+    "1111111111111110000000011111111111111111111111111111111111111111\n"
+    "1111111111110000011111111100001111100000111111111100001111111111\n"
+    "1111111111111110000000000111111111111111111111111111111111111111\n"
+    "1111111111110000111111111100000011000001110001110000011111111111\n"
+    "1111111111111111111100000011111111111111111111111111111111111111\n"
+    "1111111111100000111111111110000000000011110000000000111111111100\n"
+    "0000000000011111111110000011111111111111111111111111111111111111\n"
+    "1111111111100000111111111111100000001111111000000001111111111100\n"
+    "0000000000011111111111000001111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111000001111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111100001111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111000001111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111000001111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111000011111111000001111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111110001110000011111111000001111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111110000000000111111111000001111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111110000000011111111111000001111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    ;
+
+static const char GOLDEN_FLUSH_RECT[] =
+    "P1\n"
+    "128 64\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110111011100111011101111011101111011\n"
+    "1011110111011110111011110111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111011101111011101110111011110111011\n"
+    "1011110111011101110111101111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111100110011101110111011101110111011\n"
+    "1011101110111011110111011111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110111011101110111011101101110111011\n"
+    "1011101110111011101110110011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111001100110111011011101110111011011\n"
+    "1011101101110111011101101111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110110011011011101101110110111011011\n"
+    "1011011101110110111011011011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111001101101100110110111011011011101\n"
+    "1011011101101101110110110111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110010010010011011011011011011101101\n"
+    "1011011011011011101101101111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111100100101101101101101101101101101\n"
+    "1011011011011010010010010011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111001010010010110110110101101101\n"
+    "1010110110110101101101001011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111110000100101001011010110101101\n"
+    "1010110101101011010010100111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111100001010010101101010110101\n"
+    "0110101101010110101001010011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111000000101010101101010101\n"
+    "0110101010101001010100001111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111110000000001010101010101\n"
+    "0101010101010100000000111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111100000100001010101001\n"
+    "0101010010101000000011111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111000000100101001010\n"
+    "0100101001000000001111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111110000000000010010\n"
+    "0100010010000000111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111100000010000100\n"
+    "0001000000000011111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111100000110111000100010001\n"
+    "1100010001001111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111110100010010\n"
+    "0010010001111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111000010010\n"
+    "0000010010111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111100001110111111011010001\n"
+    "1000010000111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111011100000\n"
+    "0100101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111011101100\n"
+    "0001101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111011101110\n"
+    "0001101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110000011100010001\n"
+    "1100101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111000000\n"
+    "0000001111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111100000000\n"
+    "0000000011111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111110000000000\n"
+    "0000000000111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111000000000000\n"
+    "0000000000001111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111100000000001000\n"
+    "0010000100000011111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111110000000100100010\n"
+    "0100100000000000111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    ;
+
+static const char GOLDEN_FLUSH_RECT_2[] =
+    "P1\n"
+    "128 64\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110111011100111011101111011101111011\n"
+    "1011110111011110111011110111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111011101111011101110111011110111011\n"
+    "1011110111011101110111101111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111100110011101110111011101110111011\n"
+    "1011101110111011110111011111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110111011101110111011101101110111011\n"
+    "1011101110111011101110110011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111001100110111011011101110111011011\n"
+    "1011101101110111011101101111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110110011011011101101110110111011011\n"
+    "1011011101110110111011011011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111001101101100110110111011011011101\n"
+    "1011011101101101110110110111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111110010010010011011011011011011101101\n"
+    "1011011011011011101101101111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111100100101101101101101101101101101\n"
+    "1011011011011010010010010011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111001010010010110110110101101101\n"
+    "1010110110110101101101001011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111110000100101001011010110101101\n"
+    "1010110101101011010010100111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111100001010010101101010110101\n"
+    "0110101101010110101001010011111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111000000101010101101010101\n"
+    "0110101010101001010100001111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111110000000001010101010101\n"
+    "0101010101010100000000111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111100000100001010101001\n"
+    "0101010010101000000011111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111000000100101001010\n"
+    "0100101001000000001111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111110000000000010010\n"
+    "0100010010000000111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111100000010000100\n"
+    "0001000000000011111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111100000110111000100010001\n"
+    "1100010001001111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111110100010010\n"
+    "0010010001111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111000010010\n"
+    "0000010010111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111100001110111111011010001\n"
+    "1000010000111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111011100000\n"
+    "0100101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111011101100\n"
+    "0001101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110111111011101110\n"
+    "0001101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111101111110000011100010001\n"
+    "1100101110111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111000000\n"
+    "0000001111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111100000000\n"
+    "0000000011111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111110000000000\n"
+    "0000000000111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111000000000000\n"
+    "0000000000001111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111100000000001000\n"
+    "0010000100000011111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111110000000100100010\n"
+    "0100100000000000111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111110011111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111110100111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111011001111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111100110011111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111110011001100111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111101110011001111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    "1111111111111111111111111111111111111111111111111111111111111111\n"
+    ;
+
+static const char GOLDEN_INVERTED[] =
+    "P1\n"
+    "128 64\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000111111111111111111111111111111111111111111111111111000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000001111110000111000110001100000110000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000001111110000111000110001100000110000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000111100110001100000110000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000111100110000110001100000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000111100110000110001100000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000110110110000110001100000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000110110110000011011000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000110110110000011011000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000110010110000011011000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000110011110000011011000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000110011110000001110000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000011000000110011110000001110000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000001111110000110001110000001110000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000001111110000110001110000000100000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000100000000000000000000000000000000000000000000000001000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000111111111111111111111111111111111111111111111111111000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000111111001111111111111110111110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000111111101111111111111110111110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000100111101111001111000110110110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000011011101111110110111010101110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000111011101111000110111110011110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000011011101110110110111010101110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000100111000111000011000110110110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000001111111111111111111111111111110000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    "0000000000000000000000000000000000000000000000000000000000000000\n"
+    ;
+
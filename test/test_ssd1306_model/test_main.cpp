@@ -0,0 +1,222 @@
+/******************************************************************************
+ * Project: stm32 - E4                                                        *
+ * -------------------------------------------------------------------------- *
+ * Copyright 2024 - James Clarke                                              *
+ * Display drawing, Putc and FlushRect end to end: the bytes go out on the    *
+ * modelled bus into an SSD1306Model and the panel it shows is compared, as   *
+ * a PBM, with the golden images in golden.h.  A second model fed from the    *
+ * I2C trace hook must show the same panel.                                   *
+ *                                                                            *
+ * After a deliberate change to what is drawn, build with -D GOLDEN_UPDATE:   *
+ * the suite then writes a new golden.h to stderr instead of comparing.       *
+ * -------------------------------------------------------------------------- *
+ * Licence:                                                                   *
+ *     Use of this source code is governed by an MIT-style                    *
+ *     license that can be found in the LICENSE file or at                    *
+ *     https://opensource.org/licenses/MIT.                                   *
+ ******************************************************************************/
+#include <unity.h>
+#include <stdio.h>
+#include "native.h"
+#include "display.h"
+#include "ssd1306model.h"
+#include "golden.h"
+
+/* "P1\n128 64\n" and 64 rows of two 64 pixel lines */
+#define PBM_SIZE    (10 + DISPLAY_HEIGHT * (DISPLAY_WIDTH + 2))
+
+typedef struct {
+    char Text[PBM_SIZE + 1];
+    uint16_t Length;
+} PBM_t;
+
+static NATIVE_I2C_DEVICE_t device;
+static SSD1306Model panel;          // fed byte by byte from the wire
+static SSD1306Model traced;         // fed a request at a time from the trace hook
+static I2C bus;
+static Display display(&bus);
+
+static FontDef_t font6x8 = Font6x8Packed.Def();
+static FontDef_t font7x10 = Font7x10Packed.Def();
+static FontDef_t font11x18 = Font11x18Packed.Def();
+static FontDef_t font16x26 = Font16x26Digits.Def();
+
+static void PanelListener(uint8_t event, uint8_t value, void* context){
+    SSD1306Model* model = (SSD1306Model*)context;
+
+    if (event == NATIVE_I2C_START){
+        model->Begin();
+    } else if (event == NATIVE_I2C_WRITE){
+        model->Byte(value);
+    }
+}
+
+static void TraceHook(const I2C_TRACE_t* entry, const I2C_REQUEST_t* request, void* context){
+    SSD1306Model* model = (SSD1306Model*)context;
+
+    if (entry->Status == I2C_REQ_DONE && entry->Saddr == DISPLAY_I2C_ADDR && entry->Dir == I2C_DIR_WRITE){
+        model->Write(request->Reg, (const uint8_t*)request->Buffer, request->Length, request->Rows, request->Stride);
+    }
+}
+
+static void Put(char c, void* context){
+    PBM_t* pbm = (PBM_t*)context;
+
+    if (pbm->Length < PBM_SIZE){
+        pbm->Text[pbm->Length] = c;
+    }
+    pbm->Length++;
+}
+
+static void Render(SSD1306Model* model, PBM_t* pbm){
+    pbm->Length = 0;
+    model->WritePBM(Put, pbm);
+    TEST_ASSERT_EQUAL_UINT16(PBM_SIZE, pbm->Length);
+    pbm->Text[PBM_SIZE] = 0;
+}
+
+void setUp(void){
+    NATIVE_Reset();
+    memset(&device, 0, sizeof(device));
+    device.Saddr = DISPLAY_I2C_ADDR;
+    device.Listener = PanelListener;
+    device.Context = &panel;
+    NATIVE_I2C_Attach(&device);
+    panel.Reset();
+    traced.Reset();
+
+    bus = I2C(GPIO_PIN_9, GPIO_PIN_8, 1, NATIVE_I2C_TIMING);
+    bus.i2c_SetTraceHook(TraceHook, &traced);
+    display = Display(&bus);
+    display.Init();
+}
+
+void tearDown(void){}
+
+/* the panel against its golden image, line by line so a failure names the row */
+static void AssertGolden(const char* name, const char* golden){
+    static PBM_t pbm, trace;
+
+    Render(&panel, &pbm);
+    Render(&traced, &trace);
+#ifdef GOLDEN_UPDATE
+    (void)golden;
+    fprintf(stderr, "static const char %s[] =\n", name);
+    for (const char* line = pbm.Text; *line; ){
+        const char* end = strchr(line, '\n');
+        fprintf(stderr, "    \"%.*s\\n\"\n", (int)(end - line), line);
+        line = end + 1;
+    }
+    fprintf(stderr, "    ;\n\n");
+#else
+    const char* a = pbm.Text;
+    const char* b = golden;
+    for (uint16_t line = 1; *a || *b; line++){
+        const char* endA = strchr(a, '\n');
+        const char* endB = strchr(b, '\n');
+        if (!endA || !endB || endA - a != endB - b || memcmp(a, b, endA - a)){
+            char message[96];
+            snprintf(message, sizeof(message), "%s: PBM line %u differs", name, line);
+            TEST_FAIL_MESSAGE(message);
+        }
+        a = endA + 1;
+        b = endB + 1;
+    }
+#endif
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(pbm.Text, trace.Text, "trace hook model");
+}
+
+/* text in every font inside a frame, one blocking update */
+void test_golden_text(void){
+    display.DrawRectangle(0, 0, 127, 63, COLOR_WHITE);
+    display.GotoXY(4, 3);
+    display.Print("E4 MICROMOUSE", font6x8, COLOR_WHITE);
+    display.GotoXY(4, 13);
+    display.Print("Speed 1234", font7x10, COLOR_WHITE);
+    display.GotoXY(4, 25);
+    display.Print("-42.5", font11x18, COLOR_WHITE);
+    display.GotoXY(4, 44);
+    display.PrintFixed(-1234, 8, 2, 8, ' ', true, font6x8, COLOR_WHITE);
+    display.GotoXY(70, 44);
+    display.PrintUint(65535, 6, '0', true, font6x8, COLOR_WHITE);
+    // flush against the right and bottom edges
+    display.GotoXY(DISPLAY_WIDTH - 12, DISPLAY_HEIGHT - 8);
+    display.Print("OK", font6x8, COLOR_WHITE);
+    display.UpdateScreen();
+
+    AssertGolden("GOLDEN_TEXT", GOLDEN_TEXT);
+}
+
+/* the big digits at row offsets off the page grid, written black on white
+   and XORed over a half-filled panel */
+void test_golden_digits(void){
+    display.FillRectangle(0, 0, DISPLAY_WIDTH, 32, COLOR_WHITE);
+    display.GotoXY(8, 3);
+    display.Print("0123456", font16x26, COLOR_BLACK);
+    display.GotoXY(8, 29);
+    display.Print("789", font16x26, COLOR_INVERSE);
+    display.GotoXY(60, 37);
+    display.Print("-5.", font16x26, COLOR_WHITE);
+    display.UpdateScreen();
+
+    AssertGolden("GOLDEN_DIGITS", GOLDEN_DIGITS);
+}
+
+/* only the flushed rectangle reaches the panel, rounded out to whole pages */
+void test_golden_flush_rect(void){
+    display.UpdateScreen();
+    for (uint16_t i = 0; i < DISPLAY_WIDTH; i += 6){
+        display.DrawLine(i, 0, DISPLAY_WIDTH - 1 - i, DISPLAY_HEIGHT - 1, COLOR_WHITE);
+    }
+    display.GotoXY(40, 26);
+    display.Print("FLUSH", font7x10, COLOR_INVERSE);
+
+    display.FlushRect(30, 12, 60, 26);
+    AssertGolden("GOLDEN_FLUSH_RECT", GOLDEN_FLUSH_RECT);
+
+    // a second rectangle adds to it, the rest still waits for UpdateScreen
+    display.FlushRect(100, 50, 20, 6);
+    AssertGolden("GOLDEN_FLUSH_RECT_2", GOLDEN_FLUSH_RECT_2);
+}
+
+/* the buffer inverted by ToggleInvert, drawn on after it, then the
+   controller's own inverse mode on top */
+void test_golden_inverted(void){
+    display.DrawRectangle(10, 10, 50, 30, COLOR_WHITE);
+    display.ToggleInvert();
+    display.GotoXY(16, 20);
+    display.Print("INV", font11x18, COLOR_WHITE);
+    display.GotoXY(70, 50);
+    display.Print("black", font6x8, COLOR_BLACK);
+    display.UpdateScreen();
+    AssertGolden("GOLDEN_INVERTED", GOLDEN_INVERTED);
+
+    // the controller's inverse flips every pixel of it
+    static bool shown[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            shown[y][x] = panel.Pixel(x, y);
+        }
+    }
+    display.InvertDisplay(1);
+    TEST_ASSERT_TRUE(panel.IsInverted());
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++){
+        for (uint8_t x = 0; x < DISPLAY_WIDTH; x++){
+            TEST_ASSERT_EQUAL_MESSAGE(!shown[y][x], panel.Pixel(x, y), "controller inverse");
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+#ifdef GOLDEN_UPDATE
+    fprintf(stderr, "#pragma once\n"
+                    "/* Golden panels for test_ssd1306_model as P1 PBM, '1' dark, '0' lit.\n"
+                    "   Written by the suite built with -D GOLDEN_UPDATE, not by hand. */\n\n");
+#endif
+    RUN_TEST(test_golden_text);
+    RUN_TEST(test_golden_digits);
+    RUN_TEST(test_golden_flush_rect);
+    RUN_TEST(test_golden_inverted);
+    return UNITY_END();
+}